@@ -1,11 +1,17 @@
 #include <Arduino.h>
 
 #include "bot_behaviors.h"
+#include "bot_cli.h"
 #include "bot_comms.h"
 #include "bot_config.h"
+#include "bot_encoder.h"
+#include "bot_imu.h"
 #include "bot_led.h"
 #include "bot_lidar.h"
 #include "bot_motor.h"
+#include "bot_odometry.h"
+#include "bot_pairing.h"
+#include "bot_radio.h"
 #include "bot_state.h"
 
 void setup()
@@ -14,22 +20,34 @@ void setup()
   bot::setup_led();
   randomSeed(esp_random());
   bot::setup_motor();
+#ifdef BOT_HAS_IMU
+  bot::setup_imu();
+#endif
+#ifdef BOT_HAS_ENCODERS
+  bot::setup_encoders();
+  bot::reset_pose();
+#endif
   bot::setup_lidar();
   bot::setup_espnow();
 
-  Serial.println("USB commands:");
-  Serial.println("  1 = manual drive (teleop)");
-  Serial.println("  4 = basic wander mode");
-  Serial.println("  x = stop");
-  Serial.println("  Lf200 / Rb150 / Ls = direct motor control (uppercase L/R)");
-  Serial.println("  lp = print last LD06 packet (lowercase l)");
-  Serial.println("  ls = print latest LD06 sector summary (lowercase l)");
+  bot::print_cli_help();
 }
 
 void loop()
 {
   bot::handle_usb_serial();
+  bot::update_remote_commands();
   bot::update_lidar();
+  bot::update_radio();
+  bot::update_pairing();
+#ifdef BOT_HAS_IMU
+  bot::update_imu();
+  bot::update_turn();
+#endif
+#ifdef BOT_HAS_ENCODERS
+  bot::update_encoders();
+  bot::update_odometry();
+#endif
 
   if (bot::g_dodging && millis() >= bot::g_dodge_end_ms)
   {
@@ -43,6 +61,8 @@ void loop()
 
   if (!bot::g_dodging && !bot::g_unsticking && bot::maybe_start_unstuck())
   {
+    bot::update_speed_control();
+    bot::update_motion_profile();
     bot::maybe_report_lidar();
     bot::update_led();
     delay(10);
@@ -54,10 +74,14 @@ void loop()
     switch (bot::mode)
     {
       // Basic wander mode: forward drive with LiDAR obstacle avoidance.
-      // Modes 2, 3, and 5 are not included in this release.
+      // Modes 2 and 3 are not included in this release.
       case '4': bot::basic_wander(); break;
 
+      // Dynamic-window planner: scores sampled wheel-speed arcs every tick.
+      case '5': bot::planner_wander(); break;
+
       case '1':
+        bot::update_drive_command();
         if (bot::direction != 'x' && millis() - bot::last_cmd_time > bot::kTeleopTimeoutMs)
         {
           bot::direction = 'x';
@@ -72,6 +96,8 @@ void loop()
     }
   }
 
+  bot::update_speed_control();
+  bot::update_motion_profile();
   bot::maybe_report_lidar();
   bot::update_led();
   delay(10);
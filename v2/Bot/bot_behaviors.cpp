@@ -1,8 +1,11 @@
 #include "bot_behaviors.h"
 
+#include "bot_fixed.h"
+#include "bot_imu.h"
 #include "bot_lidar.h"
 #include "bot_led.h"
 #include "bot_motor.h"
+#include "bot_planner.h"
 #include "bot_state.h"
 
 namespace bot {
@@ -26,18 +29,37 @@ bool is_near(uint16_t distance_mm, uint16_t threshold_mm)
   return distance_mm > 0 && distance_mm <= threshold_mm;
 }
 
+// Spins in place and returns when the spin should end. With the IMU the spin
+// finishes on a measured angle and the returned deadline is only a timeout.
+unsigned long start_spin(bool left,
+                         int speed,
+                         unsigned long min_ms,
+                         unsigned long max_ms,
+                         bool unstuck)
+{
+  direction = left ? 'q' : 'e';
+#ifdef BOT_HAS_IMU
+  (void)min_ms;
+  (void)max_ms;
+  const int degrees = unstuck ? random(kTurnUnstuckMinDeg, kTurnUnstuckMaxDeg)
+                              : random(kTurnSpinMinDeg, kTurnSpinMaxDeg);
+  return turn_to(left ? degrees : -degrees, speed, kTurnTimeoutMs);
+#else
+  (void)unstuck;
+  drive(left ? -speed : speed, left ? speed : -speed);
+  return millis() + random(min_ms, max_ms);
+#endif
+}
+
 bool start_wander_escape(char dir, unsigned long min_ms, unsigned long max_ms)
 {
   switch (dir)
   {
     case 'q':
-      drive(-kBasicWander.spin_speed, kBasicWander.spin_speed);
-      direction = 'q';
-      break;
     case 'e':
-      drive(kBasicWander.spin_speed, -kBasicWander.spin_speed);
-      direction = 'e';
-      break;
+      wander_deadline_ms = start_spin(dir == 'q', kBasicWander.spin_speed, min_ms, max_ms, false);
+      wander_next_action = kDoForward;
+      return true;
     case 'a':
       drive(0, kBasicWander.turn_fast);
       direction = 'a';
@@ -76,22 +98,13 @@ void start_unstuck_escape()
   {
     drive(-kReverseSpeed, -kReverseSpeed);
     direction = 's';
-    delay(hard_contact ? (kUnstuckReverseMs + 180UL) : kUnstuckReverseMs);
+    hold_drive(hard_contact ? (kUnstuckReverseMs + 180UL) : kUnstuckReverseMs);
   }
 
   if (front_blocked)
   {
-    if (turn_left)
-    {
-      drive(-kSpinSpeed, kSpinSpeed);
-      direction = 'q';
-    }
-    else
-    {
-      drive(kSpinSpeed, -kSpinSpeed);
-      direction = 'e';
-    }
-    g_unstuck_end_ms = millis() + random(kUnstuckSpinMinMs, kUnstuckSpinMaxMs);
+    g_unstuck_end_ms =
+        start_spin(turn_left, kSpinSpeed, kUnstuckSpinMinMs, kUnstuckSpinMaxMs, true);
   }
   else
   {
@@ -116,6 +129,39 @@ void start_unstuck_escape()
 
 } // namespace
 
+char direction_for(int left_speed, int right_speed)
+{
+  if (left_speed > 0 && right_speed > 0)
+  {
+    if (abs(left_speed - right_speed) <= 20)
+    {
+      return 'w';
+    }
+    return left_speed < right_speed ? 'a' : 'd';
+  }
+  if (left_speed < 0 && right_speed < 0)
+  {
+    return 's';
+  }
+  if (left_speed < 0 && right_speed > 0)
+  {
+    return 'q';
+  }
+  if (left_speed > 0 && right_speed < 0)
+  {
+    return 'e';
+  }
+  if (right_speed > 0)
+  {
+    return 'a';
+  }
+  if (left_speed > 0)
+  {
+    return 'd';
+  }
+  return 'x';
+}
+
 void reset_stuck_tracker()
 {
   stuck_tracker.armed = false;
@@ -145,18 +191,12 @@ void wander_avoidance(const WanderConfig &cfg, bool emergency)
     {
       const bool hard_contact = front_mm > 0 && front_mm <= kContactEmergencyMm;
       drive(-cfg.reverse_speed, -cfg.reverse_speed);
-      delay(hard_contact ? (kAvoidReverseMs + 180UL) : (kAvoidReverseMs + 80UL));
-      if (go_left)
-      {
-        drive(-cfg.spin_speed, cfg.spin_speed);
-        direction = 'q';
-      }
-      else
-      {
-        drive(cfg.spin_speed, -cfg.spin_speed);
-        direction = 'e';
-      }
-      wander_deadline_ms = millis() + random(kAvoidSpinMinMs + 120UL, kAvoidSpinMaxMs + 180UL);
+      hold_drive(hard_contact ? (kAvoidReverseMs + 180UL) : (kAvoidReverseMs + 80UL));
+      wander_deadline_ms = start_spin(go_left,
+                                      cfg.spin_speed,
+                                      kAvoidSpinMinMs + 120UL,
+                                      kAvoidSpinMaxMs + 180UL,
+                                      false);
     }
     else
     {
@@ -268,6 +308,49 @@ void basic_wander()
   wander(kBasicWander);
 }
 
+// Dynamic-window mode: samples (left, right) pairs around the current command
+// and follows the best-scoring arc. Contact and blocked cases fall back to the
+// basic wander escapes.
+void planner_wander()
+{
+  if (!lidar_is_fresh())
+  {
+    wander(kBasicWander);
+    return;
+  }
+
+  if (is_near(front_reaction_distance_mm(), kContactEmergencyMm))
+  {
+    wander_avoidance(kBasicWander, true);
+    return;
+  }
+
+  const unsigned long now = millis();
+  if (now < wander_deadline_ms || now - planner_state.last_plan_ms < kPlannerIntervalMs)
+  {
+    return;
+  }
+  planner_state.last_plan_ms = now;
+
+  int left_speed = 0;
+  int right_speed = 0;
+  // The dynamic window is centred on what the wheels are doing now, not on
+  // the last target, so it respects the motion-profile ramp.
+  if (!plan_dynamic_window(motion_profile.current_left,
+                           motion_profile.current_right,
+                           left_speed,
+                           right_speed))
+  {
+    wander_avoidance(kBasicWander, true);
+    return;
+  }
+
+  drive(left_speed, right_speed);
+  direction = direction_for(left_speed, right_speed);
+  planner_state.cmd_left = left_speed;
+  planner_state.cmd_right = right_speed;
+}
+
 void wander(const WanderConfig &cfg)
 {
   if (lidar_is_fresh())
@@ -311,13 +394,11 @@ void wander(const WanderConfig &cfg)
       switch (random(4))
       {
         case 0:
-          drive(-cfg.spin_speed, cfg.spin_speed);
-          direction = 'q';
-          break;
         case 1:
-          drive(cfg.spin_speed, -cfg.spin_speed);
-          direction = 'e';
-          break;
+          wander_deadline_ms =
+              start_spin(random(2) == 0, cfg.spin_speed, kWanderTurnMinMs, kWanderTurnMaxMs, false);
+          wander_next_action = kDoForward;
+          return;
         case 2:
           drive(cfg.turn_slow, cfg.turn_fast);
           direction = 'a';
@@ -403,7 +484,7 @@ bool maybe_start_unstuck()
     return false;
   }
 
-  if (mode != '4')
+  if (mode != '4' && mode != '5')
   {
     reset_stuck_tracker();
     return false;
@@ -475,6 +556,79 @@ bool maybe_start_unstuck()
   return false;
 }
 
+#ifdef BOT_HAS_IMU
+unsigned long turn_to(int delta_deg, int speed, unsigned long timeout_ms)
+{
+  const bool left = delta_deg > 0;
+  drive(left ? -speed : speed, left ? speed : -speed);
+  direction = left ? 'q' : 'e';
+
+  turn_state.active = true;
+  turn_state.target_bam = (static_cast<int32_t>(delta_deg) * fixed::kBamPerTurn) / 360;
+  turn_state.turned_bam = 0;
+  turn_state.last_heading_bam = get_heading_bam();
+  turn_state.deadline_ms = millis() + timeout_ms;
+  return turn_state.deadline_ms;
+}
+
+void update_turn()
+{
+  if (!turn_state.active)
+  {
+    return;
+  }
+
+  const int16_t heading = get_heading_bam();
+  turn_state.turned_bam += static_cast<int16_t>(heading - turn_state.last_heading_bam);
+  turn_state.last_heading_bam = heading;
+
+  // Stop short by the angle the wheels will coast through at the current rate.
+  const int32_t remaining = turn_state.target_bam > 0
+                                ? turn_state.target_bam - turn_state.turned_bam
+                                : turn_state.turned_bam - turn_state.target_bam;
+  const int32_t lead_bam = static_cast<int32_t>(
+      fabsf(get_yaw_rate_dps()) * (kTurnLeadMs * fixed::kBamPerTurn / 360000.0f));
+  const bool reached = remaining <= fixed::deg_to_bam(kTurnToleranceDeg) + lead_bam;
+  const unsigned long now = millis();
+  if (!reached && now < turn_state.deadline_ms)
+  {
+    return;
+  }
+
+  turn_state.active = false;
+  if (reached)
+  {
+    ++turn_state.completed;
+  }
+  else
+  {
+    ++turn_state.timeouts;
+  }
+
+  // End whichever escape this turn was timing so the next action starts now.
+  if (wander_deadline_ms == turn_state.deadline_ms)
+  {
+    wander_deadline_ms = now;
+  }
+  if (g_unsticking && g_unstuck_end_ms == turn_state.deadline_ms)
+  {
+    g_unstuck_end_ms = now;
+  }
+
+  if (mode == 'x')
+  {
+    direction = 'x';
+    stop_drive();
+    Serial.printf("Turn %s: target=%ld turned=%ld deg (done=%lu timeouts=%lu)\n",
+                  reached ? "done" : "timeout",
+                  static_cast<long>(turn_state.target_bam * 360L / fixed::kBamPerTurn),
+                  static_cast<long>(turn_state.turned_bam * 360L / fixed::kBamPerTurn),
+                  static_cast<unsigned long>(turn_state.completed),
+                  static_cast<unsigned long>(turn_state.timeouts));
+  }
+}
+#endif
+
 void activate_mode(char new_mode)
 {
   mode = new_mode;
@@ -483,6 +637,8 @@ void activate_mode(char new_mode)
   g_unsticking = false;
   reset_wander_state();
   reset_stuck_tracker();
+  reset_planner_state();
+  turn_state.active = false;
   stop_drive();
   Serial.printf("Mode -> %c\n", mode);
 }
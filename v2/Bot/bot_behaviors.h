@@ -9,8 +9,18 @@ void reset_stuck_tracker();
 void wander_avoidance(const WanderConfig &cfg, bool emergency);
 void wander(const WanderConfig &cfg);
 void basic_wander();
+void planner_wander();
 void try_active_dodge(const WanderConfig &cfg);
 bool maybe_start_unstuck();
 void activate_mode(char new_mode);
+// The drive key closest to these wheel speeds, for motion telemetry.
+char direction_for(int left_speed, int right_speed);
+
+#ifdef BOT_HAS_IMU
+// Spins in place by delta_deg (CCW positive), measured with the gyro.
+// Returns the timeout deadline; update_turn() ends the turn on target.
+unsigned long turn_to(int delta_deg, int speed, unsigned long timeout_ms);
+void update_turn();
+#endif
 
 } // namespace bot
@@ -0,0 +1,249 @@
+#include "bot_cli.h"
+
+#include <Arduino.h>
+#include <string.h>
+
+#include "bot_behaviors.h"
+#include "bot_cli_parse.h"
+#include "bot_config.h"
+#include "bot_lidar.h"
+#include "bot_motor.h"
+#include "bot_pairing.h"
+#include "bot_planner.h"
+#include "bot_radio.h"
+#include "bot_state.h"
+#include "bot_telemetry.h"
+
+namespace bot {
+namespace {
+
+enum CliArg : uint8_t
+{
+  kNoArg,
+  kOptionalArg,
+  kRequiredArg,
+};
+
+struct CliCommand
+{
+  const char *name;
+  CliArg arg;
+  void (*run)(const CliLine &line);
+  const char *help;
+};
+
+struct CliState
+{
+  CliLineBuffer input;
+  uint32_t lines = 0;
+  uint32_t errors = 0;
+};
+
+CliState cli;
+
+void cmd_packets(const CliLine &)
+{
+  lidar_reader.print_packet_summary(Serial);
+}
+
+void cmd_lidar(const CliLine &)
+{
+  print_lidar_status();
+}
+
+void cmd_planner(const CliLine &)
+{
+  print_planner_status();
+}
+
+void cmd_telemetry(const CliLine &)
+{
+  print_telemetry_status();
+}
+
+void cmd_radio(const CliLine &)
+{
+  print_radio_status();
+}
+
+void cmd_motor_status(const CliLine &)
+{
+  print_motor_status();
+}
+
+void cmd_decay(const CliLine &line)
+{
+  set_decay_mode(line.name[1] == 'c' ? kFastDecay : kSlowDecay);
+  print_motor_status();
+}
+
+void cmd_pwm_mode(const CliLine &line)
+{
+  if (line.value < 0 || !set_pwm_mode(static_cast<uint8_t>(min(line.value, 255L))))
+  {
+    Serial.println("Unknown PWM mode");
+  }
+  print_motor_status();
+}
+
+void cmd_pwm_bench(const CliLine &line)
+{
+  run_pwm_bench(line.has_value ? constrain(line.value, 0L, 255L) : 150);
+}
+
+#ifdef BOT_HAS_IMU
+void cmd_turn(const CliLine &line)
+{
+  if (mode == 'x')
+  {
+    turn_to(constrain(line.value, -720L, 720L), kSpinSpeed, kTurnTimeoutMs);
+  }
+  else
+  {
+    Serial.println("Turn test only in stopped mode (x)");
+  }
+}
+#endif
+
+void cmd_heap(const CliLine &)
+{
+  Serial.printf("Heap free=%lu min_free=%lu largest_block=%lu\n",
+                static_cast<unsigned long>(ESP.getFreeHeap()),
+                static_cast<unsigned long>(ESP.getMinFreeHeap()),
+                static_cast<unsigned long>(ESP.getMaxAllocHeap()));
+}
+
+void cmd_info(const CliLine &)
+{
+  Serial.printf("Uptime %lu s mode=%c dir=%c last_rx=%lu ms ago\n",
+                millis() / 1000UL,
+                static_cast<char>(mode),
+                static_cast<char>(direction),
+                millis() - last_command_rx_ms);
+  print_pairing_status();
+  Serial.printf("CLI lines=%lu errors=%lu\n",
+                static_cast<unsigned long>(cli.lines),
+                static_cast<unsigned long>(cli.errors));
+}
+
+void cmd_unpair(const CliLine &)
+{
+  forget_controller();
+}
+
+void cmd_motor(const CliLine &line)
+{
+  apply_motor_cmd(line.name[0],
+                  line.name[1],
+                  line.has_value ? static_cast<uint8_t>(constrain(line.value, 0L, 255L)) : 0);
+}
+
+void cmd_help(const CliLine &line);
+
+const CliCommand kCommands[] = {
+    {"lp", kNoArg, cmd_packets, "LiDAR packet summary"},
+    {"ls", kNoArg, cmd_lidar, "LiDAR status"},
+    {"ld", kNoArg, cmd_planner, "planner timing"},
+    {"lk", kNoArg, cmd_telemetry, "telemetry and link statistics"},
+    {"lr", kNoArg, cmd_radio, "radio TX queue"},
+    {"lm", kNoArg, cmd_motor_status, "motor output and drive commands"},
+    {"lc", kNoArg, cmd_decay, "fast decay"},
+    {"lb", kNoArg, cmd_decay, "slow decay"},
+    {"lf", kRequiredArg, cmd_pwm_mode, "<n>  PWM mode"},
+    {"lw", kOptionalArg, cmd_pwm_bench, "[pwm]  PWM bench, stopped only"},
+#ifdef BOT_HAS_IMU
+    {"lt", kRequiredArg, cmd_turn, "<deg>  turn test, stopped only"},
+#endif
+    {"lh", kNoArg, cmd_heap, "heap free / minimum free / largest block"},
+    {"li", kNoArg, cmd_info, "uptime, mode, pairing, CLI counters"},
+    {"lu", kNoArg, cmd_unpair, "forget the paired controller"},
+    {"l?", kNoArg, cmd_help, "this list"},
+    {"Lf", kOptionalArg, cmd_motor, "[pwm]  left forward"},
+    {"Lb", kOptionalArg, cmd_motor, "[pwm]  left backward"},
+    {"Ls", kNoArg, cmd_motor, "left stop"},
+    {"Rf", kOptionalArg, cmd_motor, "[pwm]  right forward"},
+    {"Rb", kOptionalArg, cmd_motor, "[pwm]  right backward"},
+    {"Rs", kNoArg, cmd_motor, "right stop"},
+};
+
+void cmd_help(const CliLine &)
+{
+  print_cli_help();
+}
+
+void run_line(bool too_long)
+{
+  ++cli.lines;
+
+  CliLine line;
+  if (too_long || !tokenize_cli_line(cli.input.line, cli.input.len, line))
+  {
+    ++cli.errors;
+    Serial.println(too_long ? "Line too long" : "Bad command line");
+    return;
+  }
+
+  for (const CliCommand &command : kCommands)
+  {
+    if (strcmp(command.name, line.name) != 0)
+    {
+      continue;
+    }
+    if ((command.arg == kNoArg && line.has_value) ||
+        (command.arg == kRequiredArg && !line.has_value))
+    {
+      ++cli.errors;
+      Serial.printf("Usage: %s %s\n", command.name, command.help);
+      return;
+    }
+    command.run(line);
+    return;
+  }
+
+  ++cli.errors;
+  Serial.println("Unknown command, send l? for the list");
+}
+
+} // namespace
+
+void print_cli_help()
+{
+  Serial.println("USB keys: 1 manual drive, 4 basic wander, 5 planner, x stop");
+  Serial.println("  w a s d q e drive in manual mode");
+  Serial.println("USB commands (one per line):");
+  for (const CliCommand &command : kCommands)
+  {
+    Serial.printf("  %-3s %s\n", command.name, command.help);
+  }
+}
+
+void handle_usb_serial()
+{
+  while (Serial.available())
+  {
+    const char k = static_cast<char>(Serial.read());
+    const CliInput input = feed_cli_byte(cli.input, k);
+    if (input == kCliLine || input == kCliLineTooLong)
+    {
+      run_line(input == kCliLineTooLong);
+      continue;
+    }
+    if (input != kCliKey)
+    {
+      continue;
+    }
+
+    if (k == '1' || k == '4' || k == '5' || k == 'x')
+    {
+      activate_mode(k);
+    }
+    else if (mode == '1')
+    {
+      direction = k;
+      last_cmd_time = millis();
+      control_motor(k);
+    }
+  }
+}
+
+} // namespace bot
@@ -0,0 +1,12 @@
+#pragma once
+
+namespace bot {
+
+// Reads USB serial without blocking. Single keys (1 4 5 x, and w a s d q e in
+// manual mode) act at once; a line starting with L, R or l is a command from
+// the table in bot_cli.cpp (send l? for the list). Uses no heap.
+void handle_usb_serial();
+// Prints the keys and the command table; also the l? command.
+void print_cli_help();
+
+} // namespace bot
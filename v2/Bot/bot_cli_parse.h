@@ -0,0 +1,150 @@
+#pragma once
+
+// Line assembly and tokenizer for bot_cli.cpp. Header-only with no Arduino
+// dependencies so it can be compiled on a host.
+
+#include <stdint.h>
+
+namespace bot {
+
+constexpr uint8_t kCliLineMaxChars = 16;
+constexpr uint8_t kCliNameMaxChars = 3;
+constexpr long kCliValueLimit = 99999;
+
+// A line starts with L, R or l and ends at '\n'; '\r' is ignored. Any other
+// byte outside a line is a single key.
+struct CliLineBuffer
+{
+  char line[kCliLineMaxChars];
+  uint8_t len = 0;
+  bool overflow = false;  // line longer than the buffer, rejected at '\n'
+  bool complete = false;  // line handed out, cleared by the next byte
+};
+
+enum CliInput : uint8_t
+{
+  kCliNothing,      // byte taken into a line, or ignored
+  kCliKey,          // byte is a single key
+  kCliLine,         // buffer holds a complete line until the next byte
+  kCliLineTooLong,  // line ended but did not fit; its head is in the buffer
+};
+
+inline CliInput feed_cli_byte(CliLineBuffer &buffer, char k)
+{
+  if (buffer.complete)
+  {
+    buffer.len = 0;
+    buffer.overflow = false;
+    buffer.complete = false;
+  }
+
+  if (k == '\r')
+  {
+    return kCliNothing;
+  }
+  if (k == '\n')
+  {
+    if (buffer.len == 0)
+    {
+      return kCliNothing;
+    }
+    buffer.complete = true;
+    return buffer.overflow ? kCliLineTooLong : kCliLine;
+  }
+
+  if (buffer.len > 0)
+  {
+    if (buffer.len < kCliLineMaxChars)
+    {
+      buffer.line[buffer.len++] = k;
+    }
+    else
+    {
+      buffer.overflow = true;
+    }
+    return kCliNothing;
+  }
+  if (k == 'L' || k == 'R' || k == 'l')
+  {
+    buffer.line[buffer.len++] = k;
+    return kCliNothing;
+  }
+  return kCliKey;
+}
+
+// A tokenized line: "lt -90" is name "lt", value -90. "Lf200" is name "Lf",
+// value 200.
+struct CliLine
+{
+  char name[kCliNameMaxChars + 1];
+  bool has_value;
+  long value;  // within +-kCliValueLimit
+};
+
+inline bool is_cli_name_char(char c)
+{
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '?';
+}
+
+inline bool is_cli_digit(char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+inline uint8_t skip_cli_spaces(const char *text, uint8_t pos, uint8_t len)
+{
+  while (pos < len && (text[pos] == ' ' || text[pos] == '\t'))
+  {
+    ++pos;
+  }
+  return pos;
+}
+
+// Splits a line into a name and an optional integer. Returns false on
+// anything else, including trailing characters.
+inline bool tokenize_cli_line(const char *text, uint8_t len, CliLine &out)
+{
+  uint8_t pos = 0;
+  uint8_t name_len = 0;
+  while (pos < len && is_cli_name_char(text[pos]))
+  {
+    if (name_len == kCliNameMaxChars)
+    {
+      return false;
+    }
+    out.name[name_len++] = text[pos++];
+  }
+  out.name[name_len] = '\0';
+  if (name_len == 0)
+  {
+    return false;
+  }
+
+  pos = skip_cli_spaces(text, pos, len);
+  out.has_value = false;
+  out.value = 0;
+  const bool negative = pos < len && text[pos] == '-';
+  if (pos < len && (text[pos] == '-' || text[pos] == '+'))
+  {
+    ++pos;
+    if (pos == len || !is_cli_digit(text[pos]))
+    {
+      return false;
+    }
+  }
+  while (pos < len && is_cli_digit(text[pos]))
+  {
+    out.has_value = true;
+    const long value = out.value * 10 + (text[pos] - '0');
+    out.value = value < kCliValueLimit ? value : kCliValueLimit;
+    ++pos;
+  }
+  if (negative)
+  {
+    out.value = -out.value;
+  }
+
+  return skip_cli_spaces(text, pos, len) == len;
+}
+
+} // namespace bot
@@ -6,46 +6,111 @@
 
 #include "bot_behaviors.h"
 #include "bot_led.h"
-#include "bot_lidar.h"
 #include "bot_motor.h"
+#include "bot_pairing.h"
+#include "bot_radio.h"
 #include "bot_state.h"
 
 namespace bot {
+namespace {
+
+portMUX_TYPE drive_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Runs on the WiFi task: only records the command for update_drive_command().
+void receive_drive_command(const uint8_t *data)
+{
+  DriveCommand command;
+  memcpy(&command, data, sizeof(command));
+  const unsigned long now = millis();
+
+  portENTER_CRITICAL(&drive_mux);
+  // Once the stream has gone quiet, any seq starts a new one, so a restarted
+  // host is not ignored until its counter catches up.
+  const bool newer = !drive_command.have_seq ||
+                     now - drive_command.received_ms > kTeleopTimeoutMs ||
+                     static_cast<int16_t>(command.seq - drive_command.last_seq) > 0;
+  if (newer)
+  {
+    drive_command.pending = true;
+    drive_command.have_seq = true;
+    drive_command.last_seq = command.seq;
+    drive_command.left = constrain(command.left, -255, 255);
+    drive_command.right = constrain(command.right, -255, 255);
+    drive_command.received_ms = now;
+    drive_command.ttl_ms = (command.ttl_ms == 0 || command.ttl_ms > kTeleopTimeoutMs)
+                               ? kTeleopTimeoutMs
+                               : command.ttl_ms;
+    ++drive_command.accepted;
+  }
+  else
+  {
+    ++drive_command.stale;
+  }
+  portEXIT_CRITICAL(&drive_mux);
+}
+
+// Runs on the WiFi task: queues a key or L/R packet for
+// update_remote_commands().
+void queue_remote_command(const uint8_t *data, uint8_t len)
+{
+  portENTER_CRITICAL(&drive_mux);
+  if (remote_commands.count < kRemoteCommandSlots)
+  {
+    const uint8_t tail = (remote_commands.head + remote_commands.count) % kRemoteCommandSlots;
+    RemoteCommand &slot = remote_commands.slots[tail];
+    slot.len = len;
+    memcpy(slot.data, data, len);
+    ++remote_commands.count;
+  }
+  else
+  {
+    ++remote_commands.dropped;
+  }
+  portEXIT_CRITICAL(&drive_mux);
+}
+
+} // namespace
 
 void on_data_recv(const esp_now_recv_info *info, const uint8_t *data, int len)
 {
-  if (len < 1)
+  if (len < 1 || info == nullptr || info->src_addr == nullptr)
   {
     return;
   }
 
-  if (info != nullptr && info->src_addr != nullptr)
+  // Beacons and pair accepts stop here, as does anything not from the
+  // paired controller.
+  if (!pairing_on_recv(info->src_addr, data, len))
   {
-    if (!controller_peer_known ||
-        memcmp(controller_peer_addr, info->src_addr, sizeof(controller_peer_addr)) != 0)
-    {
-      if (controller_peer_known && esp_now_is_peer_exist(controller_peer_addr))
-      {
-        esp_now_del_peer(controller_peer_addr);
-      }
-
-      esp_now_peer_info_t controller_peer = {};
-      memcpy(controller_peer.peer_addr, info->src_addr, sizeof(controller_peer.peer_addr));
-      controller_peer.channel = 0;
-      controller_peer.encrypt = false;
-
-      if (esp_now_add_peer(&controller_peer) == ESP_OK)
-      {
-        memcpy(controller_peer_addr, info->src_addr, sizeof(controller_peer_addr));
-        controller_peer_known = true;
-      }
-    }
+    return;
+  }
+
+  if (len == static_cast<int>(sizeof(LinkPing)) &&
+      data[0] == kTelemetryMagic && data[2] == kTelemetryTypePing)
+  {
+    // Echoed ahead of any queued telemetry so the controller measures the
+    // command path, not the scan backlog.
+    LinkPing pong;
+    memcpy(&pong, data, sizeof(pong));
+    pong.version = kTelemetryVersion;
+    pong.type = kTelemetryTypePong;
+    pong.rssi = (info != nullptr && info->rx_ctrl != nullptr) ? info->rx_ctrl->rssi : 0;
+    radio_send(reinterpret_cast<const uint8_t *>(&pong), sizeof(pong), kTxControl);
+    return;
+  }
+
+  if (len == static_cast<int>(sizeof(DriveCommand)) && data[0] == kTelemetryMagic &&
+      data[1] == kDriveCommandVersion && data[2] == kTelemetryTypeDrive)
+  {
+    receive_drive_command(data);
+    last_command_rx_ms = millis();
+    return;
   }
 
   if (len == 3 && (data[0] == 'L' || data[0] == 'R'))
   {
-    apply_motor_cmd(static_cast<char>(data[0]), static_cast<char>(data[1]), data[2]);
-    last_cmd_time = millis();
+    queue_remote_command(data, 3);
+    last_command_rx_ms = millis();
     return;
   }
 
@@ -60,19 +125,95 @@ void on_data_recv(const esp_now_recv_info *info, const uint8_t *data, int len)
     return;
   }
   trigger_activity();
+  last_command_rx_ms = millis();
+  queue_remote_command(data, 1);
+}
 
-  if (cmd == '1' || cmd == '4' || cmd == 'x')
+void update_remote_commands()
+{
+  for (;;)
   {
-    activate_mode(cmd);
+    RemoteCommand command;
+    portENTER_CRITICAL(&drive_mux);
+    const bool have = remote_commands.count > 0;
+    if (have)
+    {
+      command = remote_commands.slots[remote_commands.head];
+      remote_commands.head = (remote_commands.head + 1) % kRemoteCommandSlots;
+      --remote_commands.count;
+    }
+    portEXIT_CRITICAL(&drive_mux);
+    if (!have)
+    {
+      return;
+    }
+
+    const char cmd = static_cast<char>(command.data[0]);
+    if (command.len == 3)
+    {
+      apply_motor_cmd(cmd, static_cast<char>(command.data[1]), command.data[2]);
+      last_cmd_time = millis();
+    }
+    else if (cmd == '1' || cmd == '4' || cmd == '5' || cmd == 'x')
+    {
+      activate_mode(cmd);
+    }
+    else if (mode == '1')
+    {
+      direction = cmd;
+      last_cmd_time = millis();
+      control_motor(cmd);
+    }
+  }
+}
+
+void update_drive_command()
+{
+  const unsigned long now = millis();
+  bool apply = false;
+  bool expire = false;
+  int left = 0;
+  int right = 0;
+
+  portENTER_CRITICAL(&drive_mux);
+  const bool live = now - drive_command.received_ms <= drive_command.ttl_ms;
+  if (drive_command.pending && live)
+  {
+    apply = true;
+    left = drive_command.left;
+    right = drive_command.right;
+    drive_command.active = true;
+  }
+  else if (drive_command.active && !live)
+  {
+    expire = true;
+    drive_command.active = false;
+    ++drive_command.expired;
   }
-  else if (mode == '1')
+  drive_command.pending = false;
+  portEXIT_CRITICAL(&drive_mux);
+
+  if (apply)
+  {
+    drive(left, right);
+    direction = direction_for(left, right);
+    last_cmd_time = now;
+    trigger_activity();
+  }
+  else if (expire)
   {
-    direction = cmd;
-    last_cmd_time = millis();
-    control_motor(cmd);
+    stop_drive();
+    direction = 'x';
+    Serial.println("Drive command expired -> stopped");
   }
 }
 
+void on_data_sent(const wifi_tx_info_t *info, esp_now_send_status_t status)
+{
+  (void)info;
+  radio_on_sent(status == ESP_NOW_SEND_SUCCESS);
+}
+
 void setup_espnow()
 {
   WiFi.mode(WIFI_STA);
@@ -88,64 +229,8 @@ void setup_espnow()
   }
 
   esp_now_register_recv_cb(on_data_recv);
-}
-
-void handle_usb_serial()
-{
-  static String serial_buf;
-
-  while (Serial.available())
-  {
-    const char k = static_cast<char>(Serial.read());
-    if (k == '\r')
-    {
-      continue;
-    }
-
-    if (k == '\n')
-    {
-      if (serial_buf == "lp")
-      {
-        lidar_reader.print_packet_summary(Serial);
-      }
-      else if (serial_buf == "ls")
-      {
-        print_lidar_status();
-      }
-      else if (serial_buf.length() >= 2)
-      {
-        apply_motor_cmd(serial_buf[0],
-                        serial_buf[1],
-                        serial_buf.length() > 2
-                            ? static_cast<uint8_t>(
-                                  constrain(serial_buf.substring(2).toInt(), 0, 255))
-                            : 0);
-      }
-      serial_buf = "";
-      continue;
-    }
-
-    if (serial_buf.length() > 0)
-    {
-      serial_buf += k;
-      continue;
-    }
-
-    if (k == '1' || k == '4' || k == 'x')
-    {
-      activate_mode(k);
-    }
-    else if (k == 'L' || k == 'R' || k == 'l')
-    {
-      serial_buf = k;
-    }
-    else if (mode == '1')
-    {
-      direction = k;
-      last_cmd_time = millis();
-      control_motor(k);
-    }
-  }
+  esp_now_register_send_cb(on_data_sent);
+  setup_pairing();
 }
 
 } // namespace bot
@@ -5,7 +5,11 @@
 namespace bot {
 
 void on_data_recv(const esp_now_recv_info *info, const uint8_t *data, int len);
+// Applies the newest drive command through drive(), or stops the wheels once
+// its ttl runs out. Call every loop in manual mode.
+void update_drive_command();
+// Runs the key and L/R packets queued by on_data_recv(). Call every loop.
+void update_remote_commands();
 void setup_espnow();
-void handle_usb_serial();
 
 } // namespace bot
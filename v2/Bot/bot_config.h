@@ -24,15 +24,115 @@ constexpr unsigned long kLidarFreshMs = 700;
 constexpr unsigned long kTelemetryIntervalMs = 120;
 
 constexpr uint8_t kTelemetryMagic = 0xA5;
-constexpr uint8_t kTelemetryVersion = 1;
+// v1: 48 raw (x, y, intensity) points per chunk, at most 96 per scan.
+// v2: polar points on a fixed angle grid, delta-coded (see bot_scan_codec.h).
+// Only scan chunks differ between versions; the other packets are unchanged.
+constexpr uint8_t kTelemetryVersion = 2;
 constexpr uint8_t kTelemetryTypeScanChunk = 1;
 constexpr uint8_t kTelemetryTypeMotion = 2;
-constexpr uint8_t kTelemetryPointsPerChunk = 48;
-constexpr uint8_t kTelemetryMaxPoints = 96;
+constexpr uint8_t kTelemetryTypePose = 3;
+constexpr uint8_t kTelemetryTypeAttitude = 4;
+constexpr uint8_t kTelemetryTypePing = 5;           // controller -> bot
+constexpr uint8_t kTelemetryTypePong = 6;           // bot -> controller, same body
+constexpr uint8_t kTelemetryTypeDrive = 7;          // controller -> bot, both wheels
+constexpr uint8_t kDriveCommandVersion = 1;         // DriveCommand layout, in the version byte
+constexpr uint8_t kTelemetryTypeBeacon = 8;         // controller -> broadcast
+constexpr uint8_t kTelemetryTypePairRequest = 9;    // bot -> controller
+constexpr uint8_t kTelemetryTypePairAccept = 10;    // controller -> bot
+constexpr uint8_t kPairingVersion = 1;              // pairing packet layout, in the version byte
+constexpr size_t kTelemetryMaxPacketBytes = 250;    // ESP-NOW payload limit
+constexpr uint16_t kTelemetryAngleBins = 450;       // 0.8 degree grid
+constexpr uint8_t kTelemetryDistQuantumMm = 8;
+constexpr uint16_t kTelemetryEdgeMm = 120;          // no interpolation across larger jumps
+constexpr uint8_t kTelemetryTargetChunks = 2;       // scan byte budget on a clean link
+constexpr uint8_t kTelemetryMaxBinStride = 5;
+constexpr uint16_t kTelemetrySectorBins = 30;       // stride is chosen per 24 degree sector
+constexpr int32_t kTelemetryNearMm = 1500;          // closer returns weigh up to 3x
+constexpr uint32_t kTelemetryAirtimeBudgetUs = 6000;  // per scan, from measured send time
+constexpr uint16_t kTelemetryMinScanBytes = 120;
+// Coarse sectors sample a different phase of their stride each frame, so
+// the controller can merge successive frames back towards full resolution.
+constexpr bool kTelemetryRotatePhase = true;
+constexpr uint8_t kTelemetryMaxChunks = 4;
 
-constexpr uint8_t kLedcBits = 14;
-constexpr uint32_t kLedcMax = (1UL << kLedcBits) - 1;
-constexpr uint32_t kLedcFreqHz = 30;
+// Pairing. The bot stores its controller in NVS and only takes commands from
+// it. An unpaired bot, or one whose controller has been silent for
+// kControllerLostMs, pairs with the next controller that beacons "open".
+constexpr unsigned long kControllerLostMs = 5000;
+constexpr uint8_t kPeerCacheSize = 2;               // paired controller and one candidate
+
+// Bot TX queue. One frame is on the air at a time.
+constexpr uint8_t kTxQueueSlots = 8;                // a full scan plus the state packets
+constexpr uint8_t kTxMaxRetries = 1;                // per frame, after a missing ACK
+constexpr unsigned long kTxCallbackTimeoutMs = 20;  // then the frame counts as lost
+constexpr unsigned long kTxCallbackLostMs = 100;    // then stop waiting for its late callback
+
+// While the controller is sending commands, scans go out every
+// kTelemetryBackoffFactor-th interval in at most one frame.
+constexpr unsigned long kCommandActiveMs = 600;     // a bit over the 500 ms keepalive
+constexpr uint8_t kTelemetryBackoffFactor = 3;
+
+// Queued frames go out by class first, then oldest first.
+enum TxPriority
+{
+  kTxControl,   // pongs; ahead of any queued telemetry
+  kTxState,     // motion, pose, attitude
+  kTxBulk,      // scan chunks
+  kTxPriorityCount,
+};
+
+// Runtime-selectable LEDC settings for the motor PWM (USB: lf<n>).
+// The min-duty columns are the per-motor breakaway duty in per mille of full
+// scale; non-zero speeds are mapped onto [min, full] so low PWM commands still
+// turn the wheels. Higher frequencies need more duty to overcome TT motor
+// inductance, so the table is per mode. Measure with the `lw` bench.
+struct PwmMode
+{
+  uint32_t freq_hz;
+  uint8_t bits;
+  uint16_t left_min_permille;
+  uint16_t right_min_permille;
+};
+
+constexpr PwmMode kPwmModes[] = {
+    {30, 14, 0, 0},         // legacy: audible, lumpy torque
+    {1000, 12, 160, 180},   // low switching loss, still audible
+    {20000, 10, 260, 280},  // inaudible, fast enough for a wheel-speed loop
+};
+constexpr uint8_t kPwmModeCount = sizeof(kPwmModes) / sizeof(kPwmModes[0]);
+constexpr uint8_t kDefaultPwmMode = 2;
+
+// TB6612FNG current decay while the PWM is off:
+//   slow decay - PWMx is chopped, the bridge short-brakes between pulses
+//   fast decay - PWMx held high, the active INx is chopped, the bridge coasts
+enum DecayMode
+{
+  kSlowDecay,
+  kFastDecay,
+};
+
+constexpr DecayMode kDefaultDecayMode = kSlowDecay;
+
+// Motion profile: drive() only sets per-wheel targets and the loop tick ramps
+// the applied PWM toward them. Slowing down (including the first half of a
+// reversal) uses the faster decel limit. stop_drive() bypasses the ramp.
+constexpr int kMotorAccelPwmPerS = 1500;
+constexpr int kMotorDecelPwmPerS = 3000;
+constexpr unsigned long kMotionProfileTickMs = 10;
+
+// Feed-forward PWM -> wheel speed maps, one per motor (measure with `lw`).
+// drive_mmps() inverts these to get the open-loop PWM for a speed target; the
+// encoder PID only has to trim the remaining error.
+struct SpeedMapPoint
+{
+  uint8_t pwm;
+  uint16_t mmps;
+};
+
+constexpr SpeedMapPoint kLeftSpeedMap[] = {
+    {0, 0}, {40, 60}, {100, 170}, {150, 260}, {200, 345}, {255, 420}};
+constexpr SpeedMapPoint kRightSpeedMap[] = {
+    {0, 0}, {40, 55}, {100, 160}, {150, 250}, {200, 335}, {255, 410}};
 
 // Flip either side to -1 if that motor spins backward with positive speed.
 constexpr int kLeftMotorPolarity = 1;
@@ -45,7 +145,8 @@ constexpr int kTurnSlow = 60;
 constexpr int kSpinSpeed = 180;
 constexpr int kReverseSpeed = 130;
 
-constexpr unsigned long kTeleopTimeoutMs = 800;
+constexpr unsigned long kTeleopTimeoutMs = 800;  // also caps a drive command's ttl
+constexpr uint8_t kRemoteCommandSlots = 8;       // keys and L/R packets awaiting loop()
 constexpr unsigned long kWanderFwdMinMs = 700;
 constexpr unsigned long kWanderFwdMaxMs = 2800;
 constexpr unsigned long kWanderTurnMinMs = 350;
@@ -91,6 +192,24 @@ constexpr uint16_t kDodgeTriggerMm = 500;
 constexpr uint16_t kDodgeApproachMm = 180;
 constexpr unsigned long kDodgeDurationMs = 450;
 
+// Dynamic-window planner (mode 5).
+// Wheel speeds are estimated open-loop from PWM: kWheelMaxSpeedMmps is the
+// measured free-running speed of a TT motor at PWM 255 on the 6V AA pack.
+constexpr int kWheelbaseMm = 130;
+constexpr int kWheelMaxSpeedMmps = 420;
+constexpr unsigned long kPlannerIntervalMs = 100;
+constexpr uint8_t kPlannerBins = 72;             // 5 degree occupancy histogram
+constexpr uint8_t kPlannerSamplesPerWheel = 7;   // 7x7 candidate (left, right) pairs
+constexpr int kPlannerWindowPwm = 90;            // reachable PWM change per planner tick
+constexpr int kPlannerMaxPwm = 230;
+constexpr uint8_t kPlannerSimSteps = 8;
+constexpr uint16_t kPlannerStepMs = 120;         // ~1 s look-ahead
+constexpr int kPlannerRobotRadiusMm = 120;
+constexpr int kPlannerClearCapMm = 600;
+constexpr int32_t kPlannerWeightClear = 4;
+constexpr int32_t kPlannerWeightHeading = 3;
+constexpr int32_t kPlannerWeightSpeed = 2;
+
 struct WanderConfig
 {
   int drive_speed;
@@ -105,17 +224,32 @@ struct WanderConfig
 };
 
 // Basic wander config.
-// Additional wander profiles (modes 2, 3, 5) are not included in this release.
+// Additional wander profiles (modes 2, 3) are not included in this release.
 constexpr WanderConfig kBasicWander = {220, 240, 90, 230, 180, true, 280, 500, 700};
 
 // ── Optional: IMU ──────────────────────────────────────────────────────────
 // Uncomment to enable IMU-assisted heading and tilt compensation.
-// Useful for SLAM and smoother navigation.
+// Useful for SLAM and smoother navigation. Driver: MPU-6050 (x forward,
+// y left, z up), read in bursts from its hardware FIFO.
+// GPIO 4 is PWMA, so SCL lives on GPIO 21 (UART0 TX, free with USB CDC).
 //
 // #define BOT_HAS_IMU
-// constexpr int kImuSdaPin  = 3;
-// constexpr int kImuSclPin  = 4;
-// constexpr float kImuAlpha = 0.98f;  // complementary filter weight (gyro vs accel)
+// constexpr int kImuSdaPin  = 20;
+// constexpr int kImuSclPin  = 21;
+// constexpr uint16_t kImuMahonyKpQ8 = 256;         // 1.0: gravity correction gain
+// constexpr uint16_t kImuMahonyKiQ8 = 5;           // ~0.02: slow gyro bias trim
+// constexpr uint8_t kImuAddress = 0x68;
+// constexpr uint32_t kImuI2cHz = 400000;
+// constexpr uint16_t kImuSampleHz = 200;             // FIFO sample rate
+// constexpr uint16_t kImuCalibrationSamples = 200;   // gyro bias, bot must be still at boot
+// Escape spins turn by a measured angle instead of a random duration.
+// constexpr int kTurnSpinMinDeg = 60;
+// constexpr int kTurnSpinMaxDeg = 140;
+// constexpr int kTurnUnstuckMinDeg = 90;
+// constexpr int kTurnUnstuckMaxDeg = 160;
+// constexpr int kTurnToleranceDeg = 4;
+// constexpr unsigned long kTurnLeadMs = 60;       // stop early by rate * lead to absorb coast
+// constexpr unsigned long kTurnTimeoutMs = 2500;  // fallback if a wheel slips or stalls
 
 // ── Optional: Motor Encoders + PID ─────────────────────────────────────────
 // Uncomment to enable closed-loop speed control via motor encoders.
@@ -124,11 +258,19 @@ constexpr WanderConfig kBasicWander = {220, 240, 90, 230, 180, true, 280, 500, 7
 // #define BOT_HAS_ENCODERS
 // constexpr int kLeftEncoderPin   = 9;
 // constexpr int kRightEncoderPin  = 11;
-// constexpr int kEncoderPpr       = 20;   // pulses per revolution
+// constexpr int kLeftEncoderBPin  = -1;   // quadrature B channels; -1 = single-channel
+// constexpr int kRightEncoderBPin = -1;   // ISR counting (always the case on the C3: no PCNT)
+// constexpr int kEncoderPpr       = 20;   // pulses per revolution, per channel
 // constexpr float kWheelDiameterM = 0.065f;
-// constexpr float kPidKp = 1.2f;
-// constexpr float kPidKi = 0.3f;
-// constexpr float kPidKd = 0.05f;
+// constexpr unsigned long kSpeedSampleMs = 20;   // PID + speed estimate rate
+// constexpr uint8_t kSpeedWindowSamples = 5;     // rolling window = 100 ms
+// constexpr float kPidKp = 0.35f;                // PWM per mm/s of error
+// constexpr float kPidKi = 1.2f;                 // PWM per mm of accumulated error
+// constexpr float kPidKd = 0.01f;                // PWM per mm/s^2
+// constexpr float kPidIntegralLimitPwm = 80.0f;  // anti-windup clamp
+// constexpr int kDriveSpeedMmps = 280;           // closed-loop forward()/backward()
+// constexpr unsigned long kOdometryIntervalMs = 20;
+// constexpr float kOdomSlipVarPerM = 0.0004f;    // wheel travel variance, m^2 per m
 
 enum WanderAction
 {
@@ -155,6 +297,61 @@ struct LidarState
   uint32_t packets_seen = 0;
 };
 
+enum MotorSide
+{
+  kLeftMotor,
+  kRightMotor,
+};
+
+struct MotionProfile
+{
+  int target_left = 0;
+  int target_right = 0;
+  int current_left = 0;
+  int current_right = 0;
+  unsigned long last_update_ms = 0;
+};
+
+struct SpeedTargets
+{
+  bool active = false;
+  int left_mmps = 0;
+  int right_mmps = 0;
+};
+
+// Nearest return per kPlannerBins sector of the last scan; dist 0 = none.
+struct PlannerSectors
+{
+  int16_t x_mm[kPlannerBins]{};
+  int16_t y_mm[kPlannerBins]{};
+  uint16_t dist_mm[kPlannerBins]{};
+};
+
+struct PlannerState
+{
+  unsigned long last_plan_ms = 0;
+  int cmd_left = 0;
+  int cmd_right = 0;
+  PlannerSectors sectors;
+  uint32_t plans = 0;
+  uint32_t blocked_plans = 0;
+  uint32_t last_plan_us = 0;
+  uint32_t max_plan_us = 0;
+};
+
+// Gyro-measured turn in progress (BOT_HAS_IMU). Angles in binary angle units,
+// unwrapped so turns past 180 degrees work.
+struct TurnState
+{
+  bool active = false;
+  int32_t target_bam = 0;
+  int32_t turned_bam = 0;
+  int16_t last_heading_bam = 0;
+  unsigned long deadline_ms = 0;
+  uint32_t completed = 0;
+  uint32_t timeouts = 0;
+};
+
 struct StuckTracker
 {
   bool armed = false;
@@ -166,7 +363,9 @@ struct StuckTracker
   uint16_t right_mm = 0;
 };
 
-struct __attribute__((packed)) TelemetryHeader
+// v2 scan chunk header. The coded point stream follows it. Each chunk decodes
+// on its own: the cursor starts at start_bin and the predictor starts at zero.
+struct __attribute__((packed)) ScanChunkHeader
 {
   uint8_t magic;
   uint8_t version;
@@ -174,15 +373,88 @@ struct __attribute__((packed)) TelemetryHeader
   uint16_t frame_id;
   uint8_t chunk_index;
   uint8_t chunk_count;
-  uint8_t point_count;
-  uint8_t total_points;
+  uint8_t bin_stride;   // angle grid step, in kTelemetryAngleBins units
+  uint16_t start_bin;   // fine bin index
+  uint16_t point_count;
+};
+
+struct TelemetryStats
+{
+  uint32_t frames = 0;
+  uint32_t chunks = 0;
+  uint32_t bytes = 0;
+  uint16_t last_points = 0;
+  uint16_t last_bytes = 0;
+  uint16_t last_budget = 0;
+  uint8_t last_coarse_sectors = 0;
+  uint32_t backoff_skips = 0;  // scans not sent while commands were active
+};
+
+// ESP-NOW delivery and TX queue counters, updated from the send callback.
+struct LinkStats
+{
+  volatile uint32_t sent = 0;
+  volatile uint32_t delivered = 0;
+  volatile uint32_t failed = 0;
+  volatile uint32_t success_q8 = 256;  // EWMA, 256 = every send acknowledged
+  volatile uint32_t us_per_kb = 0;     // EWMA of time on air per 1024 bytes
+  volatile uint32_t queued = 0;
+  volatile uint32_t superseded = 0;    // replaced by newer data before sending
+  volatile uint32_t overflow = 0;      // dropped, queue full
+  volatile uint32_t retries = 0;
+  volatile uint32_t no_mem = 0;        // ESP_ERR_ESPNOW_NO_MEM, sent again later
+  volatile uint32_t timeouts = 0;      // no send callback
+  volatile uint32_t late_callbacks = 0;  // callback after the timeout, ignored
+  volatile uint8_t max_depth = 0;
+};
+
+// Newest drive command from the controller. Written by the receive callback
+// under a lock and applied from loop(), so both wheels change together.
+struct DriveCommandState
+{
+  bool pending = false;  // received, not yet applied
+  bool active = false;   // applied, ttl still running
+  bool have_seq = false;
+  uint16_t last_seq = 0;
+  int16_t left = 0;
+  int16_t right = 0;
+  unsigned long received_ms = 0;
+  unsigned long ttl_ms = 0;
+  uint32_t accepted = 0;
+  uint32_t stale = 0;    // seq not newer than the last one accepted
+  uint32_t expired = 0;  // ttl ran out before the next command
 };
 
-struct __attribute__((packed)) TelemetryPoint
+// Key and L/R motor packets from the controller. The receive callback
+// queues them under a lock; loop() runs them, so only the loop task ever
+// touches the motors and the ramp state.
+struct RemoteCommand
 {
-  int16_t x_mm;
-  int16_t y_mm;
-  uint8_t intensity;
+  uint8_t len;      // 1 for a key, 3 for L/R, f/b/s, pwm
+  uint8_t data[3];
+};
+
+struct RemoteCommandQueue
+{
+  RemoteCommand slots[kRemoteCommandSlots]{};
+  uint8_t head = 0;
+  uint8_t count = 0;
+  uint32_t dropped = 0;  // queue full
+};
+
+// Pairing handshake. Set by the receive callback under a lock and acted on
+// from loop(), which is the only place the ESP-NOW peer list changes.
+struct PairingState
+{
+  bool paired = false;           // commands from controller_peer_addr are taken
+  bool accepted = false;         // the controller confirmed us since boot
+  bool request_pending = false;  // send a pair request to candidate
+  bool accept_pending = false;   // candidate accepted us as accepted_bot
+  uint8_t candidate[6]{};
+  uint8_t accepted_bot = 0;
+  uint8_t bot_id = 0;            // our index in the controller's fleet
+  unsigned long last_controller_rx_ms = 0;
+  uint32_t requests = 0;
 };
 
 struct __attribute__((packed)) MotionTelemetry
@@ -195,4 +467,78 @@ struct __attribute__((packed)) MotionTelemetry
   uint8_t flags;
 };
 
+// Wheel odometry, sent with the motion packet when encoders are fitted.
+// Standard deviations are the square roots of the covariance diagonal.
+struct __attribute__((packed)) PoseTelemetry
+{
+  uint8_t magic;
+  uint8_t version;
+  uint8_t type;
+  int32_t x_mm;
+  int32_t y_mm;
+  int16_t theta_mrad;
+  uint16_t sigma_x_mm;
+  uint16_t sigma_y_mm;
+  uint16_t sigma_theta_mrad;
+};
+
+// Fused IMU attitude, sent with the motion packet when the IMU is fitted.
+struct __attribute__((packed)) AttitudeTelemetry
+{
+  uint8_t magic;
+  uint8_t version;
+  uint8_t type;
+  int16_t quat_q14[4];  // w x y z, 16384 = 1.0
+  int16_t yaw_cdeg;
+  int16_t yaw_rate_cdps;
+};
+
+// Round-trip probe. The bot echoes it back with the type and rssi filled in.
+struct __attribute__((packed)) LinkPing
+{
+  uint8_t magic;
+  uint8_t version;
+  uint8_t type;
+  uint16_t seq;
+  uint32_t sent_us;  // controller clock
+  int8_t rssi;       // pong: dBm the ping arrived at
+};
+
+// Both wheel speeds in one packet. Applied only if seq is newer than the last
+// one accepted; the wheels stop if nothing newer arrives within ttl_ms.
+struct __attribute__((packed)) DriveCommand
+{
+  uint8_t magic;
+  uint8_t version;  // kDriveCommandVersion
+  uint8_t type;
+  uint16_t seq;
+  int16_t left;     // PWM, -255..255
+  int16_t right;
+  uint16_t ttl_ms;  // 0 or above kTeleopTimeoutMs means kTeleopTimeoutMs
+};
+
+// Broadcast by the controller once a second.
+struct __attribute__((packed)) PairBeacon
+{
+  uint8_t magic;
+  uint8_t version;  // kPairingVersion
+  uint8_t type;
+  uint8_t open;     // 1 while the controller takes new bots
+};
+
+struct __attribute__((packed)) PairRequest
+{
+  uint8_t magic;
+  uint8_t version;
+  uint8_t type;
+};
+
+struct __attribute__((packed)) PairAccept
+{
+  uint8_t magic;
+  uint8_t version;
+  uint8_t type;
+  uint8_t bot;  // index in the controller's fleet, tags our telemetry on USB
+};
+
 } // namespace bot
@@ -0,0 +1,250 @@
+#pragma once
+
+// Dynamic-window planner for the planner wander mode: samples (left, right)
+// PWM pairs around the current command, forward-simulates each as a constant
+// arc against the nearest return per sector, and scores clearance, heading
+// toward the most open direction, and speed. Integer maths only (bot_fixed.h).
+//
+// Kept apart from bot_planner.cpp, and free of anything but bot_config.h and
+// the LiDAR types, so v2/host can replay scans through it.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bot_config.h"
+#include "bot_fixed.h"
+#include "lidar_data.h"
+
+namespace bot {
+namespace dwa {
+
+// Obstacles farther than this cannot be reached within the look-ahead horizon.
+constexpr int32_t kPlannerReachMm =
+    (static_cast<int32_t>(kWheelMaxSpeedMmps) * kPlannerSimSteps * kPlannerStepMs) / 1000 +
+    kPlannerRobotRadiusMm + kPlannerClearCapMm;
+constexpr int32_t kRobotRadiusSq =
+    static_cast<int32_t>(kPlannerRobotRadiusMm) * kPlannerRobotRadiusMm;
+// Positions are simulated in 1/16 mm so short steps do not truncate to zero.
+constexpr int kPosShift = 4;
+
+struct Obstacle
+{
+  int16_t x_mm;
+  int16_t y_mm;
+};
+
+inline int32_t pwm_to_mmps(int pwm)
+{
+  return static_cast<int32_t>(pwm) * kWheelMaxSpeedMmps / 255;
+}
+
+inline int16_t bin_bearing_deg(uint8_t bin)
+{
+  const int16_t center_deg =
+      static_cast<int16_t>((static_cast<int32_t>(bin) * 360 + 180) / kPlannerBins);
+  return center_deg > 180 ? center_deg - 360 : center_deg;
+}
+
+// Keeps the nearest return per sector.
+inline void build_sectors(const lidar::ScanFrame &scan, PlannerSectors &sectors)
+{
+  memset(sectors.dist_mm, 0, sizeof(sectors.dist_mm));
+
+  for (uint16_t i = 0; i < scan.point_count; ++i)
+  {
+    const lidar::ScanPoint &point = scan.points[i];
+    if (!point.valid || point.distance_mm < kLidarIgnoreNearMm)
+    {
+      continue;
+    }
+
+    uint16_t bin = static_cast<uint16_t>(point.angle_deg * (kPlannerBins / 360.0f));
+    if (bin >= kPlannerBins)
+    {
+      bin = kPlannerBins - 1;
+    }
+
+    const uint16_t current = sectors.dist_mm[bin];
+    if (current == 0 || point.distance_mm < current)
+    {
+      sectors.dist_mm[bin] = point.distance_mm;
+      sectors.x_mm[bin] = point.x_mm;
+      sectors.y_mm[bin] = point.y_mm;
+    }
+  }
+}
+
+// Most open direction in the forward half, biased toward straight ahead.
+inline uint16_t choose_goal_bam(const PlannerSectors &sectors)
+{
+  int32_t best_score = INT32_MIN;
+  int16_t best_bearing = 0;
+
+  for (uint8_t bin = 0; bin < kPlannerBins; ++bin)
+  {
+    const int16_t bearing = bin_bearing_deg(bin);
+    if (bearing < -90 || bearing > 90)
+    {
+      continue;
+    }
+
+    const uint16_t dist = sectors.dist_mm[bin];
+    const int32_t clear = (dist == 0 || dist > 3000) ? 3000 : dist;
+    const int32_t score = clear - abs(bearing) * 8;
+    if (score > best_score)
+    {
+      best_score = score;
+      best_bearing = bearing;
+    }
+  }
+
+  return fixed::deg_to_bam(best_bearing);
+}
+
+inline uint8_t collect_obstacles(const PlannerSectors &sectors, Obstacle *obstacles)
+{
+  uint8_t count = 0;
+  for (uint8_t bin = 0; bin < kPlannerBins; ++bin)
+  {
+    const uint16_t dist = sectors.dist_mm[bin];
+    // Points already inside the footprint belong to the contact/stuck logic;
+    // including them would make every candidate collide.
+    if (dist == 0 || dist <= kPlannerRobotRadiusMm || dist > kPlannerReachMm)
+    {
+      continue;
+    }
+    obstacles[count].x_mm = sectors.x_mm[bin];
+    obstacles[count].y_mm = sectors.y_mm[bin];
+    ++count;
+  }
+  return count;
+}
+
+// Forward-simulates a constant (left, right) arc. Returns the clearance in mm
+// (capped), or -1 if the footprint hits an obstacle within the horizon.
+inline int32_t simulate_arc(int32_t left_mmps,
+                            int32_t right_mmps,
+                            const Obstacle *obstacles,
+                            uint8_t obstacle_count,
+                            uint16_t &final_heading)
+{
+  const int32_t step_mm_q = ((left_mmps + right_mmps) * kPlannerStepMs << kPosShift) / 2000;
+  const int32_t step_bam = static_cast<int32_t>(
+      static_cast<int64_t>(right_mmps - left_mmps) * kPlannerStepMs * fixed::kBamPerRad /
+      (1000L * kWheelbaseMm));
+
+  int32_t x_q = 0;
+  int32_t y_q = 0;
+  int32_t heading = 0;
+  int32_t min_dist_sq = INT32_MAX;
+
+  for (uint8_t step = 0; step < kPlannerSimSteps; ++step)
+  {
+    // Midpoint heading keeps the chord close to the true arc.
+    const uint16_t mid = static_cast<uint16_t>(heading + step_bam / 2);
+    x_q += (step_mm_q * fixed::cos_q14(mid)) >> 14;
+    y_q += (step_mm_q * fixed::sin_q14(mid)) >> 14;
+    heading += step_bam;
+
+    const int32_t x_mm = x_q >> kPosShift;
+    const int32_t y_mm = y_q >> kPosShift;
+    for (uint8_t i = 0; i < obstacle_count; ++i)
+    {
+      const int32_t dx = obstacles[i].x_mm - x_mm;
+      const int32_t dy = obstacles[i].y_mm - y_mm;
+      const int32_t dist_sq = dx * dx + dy * dy;
+      if (dist_sq < kRobotRadiusSq)
+      {
+        return -1;
+      }
+      if (dist_sq < min_dist_sq)
+      {
+        min_dist_sq = dist_sq;
+      }
+    }
+  }
+
+  final_heading = static_cast<uint16_t>(heading);
+  if (min_dist_sq == INT32_MAX)
+  {
+    return kPlannerClearCapMm;
+  }
+
+  const int32_t clearance =
+      static_cast<int32_t>(fixed::isqrt32(static_cast<uint32_t>(min_dist_sq))) -
+      kPlannerRobotRadiusMm;
+  return clearance > kPlannerClearCapMm ? kPlannerClearCapMm : clearance;
+}
+
+// Best arc within reach of (current_left, current_right). Returns false if
+// every candidate collides or the best one is standing still.
+inline bool plan_dynamic_window(const PlannerSectors &sectors,
+                                int current_left,
+                                int current_right,
+                                int &left_pwm,
+                                int &right_pwm)
+{
+  Obstacle obstacles[kPlannerBins];
+  const uint8_t obstacle_count = collect_obstacles(sectors, obstacles);
+  const uint16_t goal_bam = choose_goal_bam(sectors);
+  constexpr int kHalfSamples = kPlannerSamplesPerWheel / 2;
+
+  int32_t best_score = INT32_MIN;
+  int best_left = 0;
+  int best_right = 0;
+
+  for (uint8_t li = 0; li < kPlannerSamplesPerWheel; ++li)
+  {
+    const int left = max(-kPlannerMaxPwm,
+                         min(kPlannerMaxPwm,
+                             current_left + (li - kHalfSamples) * kPlannerWindowPwm / kHalfSamples));
+    for (uint8_t ri = 0; ri < kPlannerSamplesPerWheel; ++ri)
+    {
+      const int right = max(-kPlannerMaxPwm,
+                            min(kPlannerMaxPwm,
+                                current_right + (ri - kHalfSamples) * kPlannerWindowPwm / kHalfSamples));
+      // Reversing is left to the emergency escapes; the planner only moves
+      // forward or spins in place.
+      if (left + right < 0)
+      {
+        continue;
+      }
+
+      const int32_t left_mmps = pwm_to_mmps(left);
+      const int32_t right_mmps = pwm_to_mmps(right);
+      uint16_t final_heading = 0;
+      const int32_t clearance =
+          simulate_arc(left_mmps, right_mmps, obstacles, obstacle_count, final_heading);
+      if (clearance < 0)
+      {
+        continue;
+      }
+
+      const int32_t heading_fit =
+          (fixed::cos_q14(static_cast<uint16_t>(final_heading - goal_bam)) * kPlannerClearCapMm) >> 14;
+      const int32_t speed_fit =
+          ((left_mmps + right_mmps) / 2) * kPlannerClearCapMm / kWheelMaxSpeedMmps;
+      const int32_t score = kPlannerWeightClear * clearance +
+                            kPlannerWeightHeading * heading_fit +
+                            kPlannerWeightSpeed * speed_fit;
+      if (score > best_score)
+      {
+        best_score = score;
+        best_left = left;
+        best_right = right;
+      }
+    }
+  }
+
+  if (best_score == INT32_MIN || (best_left == 0 && best_right == 0))
+  {
+    return false;
+  }
+
+  left_pwm = best_left;
+  right_pwm = best_right;
+  return true;
+}
+
+} // namespace dwa
+} // namespace bot
@@ -3,62 +3,332 @@
 #ifdef BOT_HAS_ENCODERS
 
 #include <math.h>
+#include <soc/soc_caps.h>
 #include "bot_config.h"
+#include "bot_motor.h"
+#include "bot_pid.h"
+#include "bot_state.h"
+
+#if SOC_PCNT_SUPPORTED
+#include <driver/pulse_cnt.h>
+#endif
 
 namespace bot {
 namespace {
 
+// Quadrature decoding in the pulse-counter peripheral needs both encoder
+// channels wired and a chip that has PCNT (the ESP32-C3 does not). Otherwise,
+// or if the PCNT driver cannot be set up, fall back to counting rising edges
+// on channel A in an ISR.
+#if SOC_PCNT_SUPPORTED
+constexpr bool kUsePcnt = kLeftEncoderBPin >= 0 && kRightEncoderBPin >= 0;
+#else
+constexpr bool kUsePcnt = false;
+#endif
+
+// Set by setup_encoders() for the backend that actually came up.
+bool  pcnt_active   = false;
+int   counts_per_rev = kEncoderPpr;
+float mm_per_tick    = kWheelDiameterM * 1000.0f * (float)M_PI / kEncoderPpr;
+
 volatile long left_ticks  = 0;
 volatile long right_ticks = 0;
 
 void IRAM_ATTR left_isr()  { left_ticks++;  }
 void IRAM_ATTR right_isr() { right_ticks++; }
 
-float left_integral  = 0.0f;
-float right_integral = 0.0f;
-int   last_left_err  = 0;
-int   last_right_err = 0;
+#if SOC_PCNT_SUPPORTED
+// The hardware counter is 16-bit; with accum_count the driver folds each
+// limit crossing into a software accumulator so the count never wraps.
+constexpr int kPcntLimit = 10000;
+constexpr uint32_t kPcntGlitchNs = 1000;
+
+struct QuadratureUnit
+{
+  pcnt_unit_handle_t unit = nullptr;
+  pcnt_channel_handle_t a_channel = nullptr;
+  pcnt_channel_handle_t b_channel = nullptr;
+  bool enabled = false;
+};
+
+QuadratureUnit left_quad;
+QuadratureUnit right_quad;
+
+void release_quadrature_unit(QuadratureUnit &quad)
+{
+  if (quad.enabled)
+  {
+    pcnt_unit_stop(quad.unit);
+    pcnt_unit_disable(quad.unit);
+  }
+  if (quad.a_channel != nullptr)
+  {
+    pcnt_del_channel(quad.a_channel);
+  }
+  if (quad.b_channel != nullptr)
+  {
+    pcnt_del_channel(quad.b_channel);
+  }
+  if (quad.unit != nullptr)
+  {
+    pcnt_del_unit(quad.unit);
+  }
+  quad = QuadratureUnit{};
+}
+
+// Returns false, with everything it created released, on any driver error.
+bool setup_quadrature_unit(QuadratureUnit &quad, int a_pin, int b_pin)
+{
+  pcnt_unit_config_t unit_config = {};
+  unit_config.low_limit = -kPcntLimit;
+  unit_config.high_limit = kPcntLimit;
+  unit_config.flags.accum_count = 1;
+  if (pcnt_new_unit(&unit_config, &quad.unit) != ESP_OK)
+  {
+    quad.unit = nullptr;
+    return false;
+  }
+
+  pcnt_glitch_filter_config_t filter_config = {};
+  filter_config.max_glitch_ns = kPcntGlitchNs;
+  pcnt_unit_set_glitch_filter(quad.unit, &filter_config);
+
+  // x4 decoding: each channel counts both edges, with the other channel's
+  // level selecting the direction.
+  pcnt_chan_config_t a_config = {};
+  a_config.edge_gpio_num = a_pin;
+  a_config.level_gpio_num = b_pin;
+  pcnt_chan_config_t b_config = {};
+  b_config.edge_gpio_num = b_pin;
+  b_config.level_gpio_num = a_pin;
+  if (pcnt_new_channel(quad.unit, &a_config, &quad.a_channel) != ESP_OK)
+  {
+    quad.a_channel = nullptr;
+    release_quadrature_unit(quad);
+    return false;
+  }
+  if (pcnt_new_channel(quad.unit, &b_config, &quad.b_channel) != ESP_OK)
+  {
+    quad.b_channel = nullptr;
+    release_quadrature_unit(quad);
+    return false;
+  }
+
+  const bool actions_ok =
+      pcnt_channel_set_edge_action(quad.a_channel,
+                                   PCNT_CHANNEL_EDGE_ACTION_DECREASE,
+                                   PCNT_CHANNEL_EDGE_ACTION_INCREASE) == ESP_OK &&
+      pcnt_channel_set_level_action(quad.a_channel,
+                                    PCNT_CHANNEL_LEVEL_ACTION_KEEP,
+                                    PCNT_CHANNEL_LEVEL_ACTION_INVERSE) == ESP_OK &&
+      pcnt_channel_set_edge_action(quad.b_channel,
+                                   PCNT_CHANNEL_EDGE_ACTION_INCREASE,
+                                   PCNT_CHANNEL_EDGE_ACTION_DECREASE) == ESP_OK &&
+      pcnt_channel_set_level_action(quad.b_channel,
+                                    PCNT_CHANNEL_LEVEL_ACTION_KEEP,
+                                    PCNT_CHANNEL_LEVEL_ACTION_INVERSE) == ESP_OK;
+
+  // accum_count only extends across limits that are also watch points.
+  if (!actions_ok ||
+      pcnt_unit_add_watch_point(quad.unit, kPcntLimit) != ESP_OK ||
+      pcnt_unit_add_watch_point(quad.unit, -kPcntLimit) != ESP_OK ||
+      pcnt_unit_enable(quad.unit) != ESP_OK)
+  {
+    release_quadrature_unit(quad);
+    return false;
+  }
+  quad.enabled = true;
+  if (pcnt_unit_clear_count(quad.unit) != ESP_OK || pcnt_unit_start(quad.unit) != ESP_OK)
+  {
+    release_quadrature_unit(quad);
+    return false;
+  }
+  return true;
+}
+
+long read_unit(pcnt_unit_handle_t unit)
+{
+  int count = 0;
+  pcnt_unit_get_count(unit, &count);
+  return count;
+}
+#endif
+
+constexpr float kSampleDtS = kSpeedSampleMs / 1000.0f;
+
+// Tick counts sampled at a fixed rate; speed is taken across the whole ring so
+// a 20-PPR encoder still resolves low speeds.
+long          left_history[kSpeedWindowSamples + 1]{};
+long          right_history[kSpeedWindowSamples + 1]{};
+uint8_t       history_head   = 0;
+uint8_t       history_count  = 0;
+unsigned long last_sample_ms = 0;
+bool          sample_ready   = false;
+
+float left_speed_mmps  = 0.0f;
+float right_speed_mmps = 0.0f;
+
+constexpr pid::Gains kPidGains{kPidKp, kPidKi, kPidKd, kPidIntegralLimitPwm, kSampleDtS};
+pid::WheelPid left_pid;
+pid::WheelPid right_pid;
+
+// Quadrature counts are already signed. The single-channel ISR cannot see
+// direction, so take it from the PWM the wheel is actually being driven with.
+float signed_speed(long delta_ticks, uint8_t samples, int applied_pwm)
+{
+  const float mmps = (delta_ticks * mm_per_tick) / (samples * kSampleDtS);
+  if (pcnt_active)
+  {
+    return mmps;
+  }
+  return applied_pwm < 0 ? -fabsf(mmps) : fabsf(mmps);
+}
 
 } // namespace
 
 void setup_encoders()
 {
+#if SOC_PCNT_SUPPORTED
+  if (kUsePcnt)
+  {
+    pinMode(kLeftEncoderPin,   INPUT_PULLUP);
+    pinMode(kLeftEncoderBPin,  INPUT_PULLUP);
+    pinMode(kRightEncoderPin,  INPUT_PULLUP);
+    pinMode(kRightEncoderBPin, INPUT_PULLUP);
+    if (setup_quadrature_unit(left_quad, kLeftEncoderPin, kLeftEncoderBPin) &&
+        setup_quadrature_unit(right_quad, kRightEncoderPin, kRightEncoderBPin))
+    {
+      pcnt_active = true;
+      counts_per_rev = kEncoderPpr * 4;
+      mm_per_tick = kWheelDiameterM * 1000.0f * (float)M_PI / counts_per_rev;
+      Serial.println("Encoders: PCNT quadrature");
+      return;
+    }
+    // Both wheels must count the same way, so drop a unit that did come up.
+    release_quadrature_unit(left_quad);
+    release_quadrature_unit(right_quad);
+    Serial.println("Encoders: PCNT setup failed, using channel A only");
+  }
+#endif
+
   pinMode(kLeftEncoderPin,  INPUT_PULLUP);
   pinMode(kRightEncoderPin, INPUT_PULLUP);
   attachInterrupt(digitalPinToInterrupt(kLeftEncoderPin),  left_isr,  RISING);
   attachInterrupt(digitalPinToInterrupt(kRightEncoderPin), right_isr, RISING);
+  Serial.println("Encoders: single-channel ISR");
 }
 
 void reset_odometry()
 {
+#if SOC_PCNT_SUPPORTED
+  if (pcnt_active)
+  {
+    pcnt_unit_clear_count(left_quad.unit);
+    pcnt_unit_clear_count(right_quad.unit);
+  }
+#endif
   left_ticks  = 0;
   right_ticks = 0;
+  history_count = 0;
+  left_speed_mmps = 0.0f;
+  right_speed_mmps = 0.0f;
+}
+
+long get_left_ticks()
+{
+#if SOC_PCNT_SUPPORTED
+  if (pcnt_active)
+  {
+    return read_unit(left_quad.unit);
+  }
+#endif
+  return left_ticks;
+}
+
+long get_right_ticks()
+{
+#if SOC_PCNT_SUPPORTED
+  if (pcnt_active)
+  {
+    return read_unit(right_quad.unit);
+  }
+#endif
+  return right_ticks;
+}
+
+void update_encoders()
+{
+  const unsigned long now = millis();
+  if (now - last_sample_ms < kSpeedSampleMs)
+  {
+    return;
+  }
+  last_sample_ms = now;
+
+  history_head = (history_head + 1) % (kSpeedWindowSamples + 1);
+  left_history[history_head] = get_left_ticks();
+  right_history[history_head] = get_right_ticks();
+  if (history_count < kSpeedWindowSamples)
+  {
+    ++history_count;
+  }
+
+  const uint8_t oldest =
+      (history_head + kSpeedWindowSamples + 1 - history_count) % (kSpeedWindowSamples + 1);
+  left_speed_mmps = signed_speed(left_history[history_head] - left_history[oldest],
+                                 history_count,
+                                 motion_profile.current_left);
+  right_speed_mmps = signed_speed(right_history[history_head] - right_history[oldest],
+                                  history_count,
+                                  motion_profile.current_right);
+  sample_ready = true;
+}
+
+float get_meters_per_tick()
+{
+  return mm_per_tick / 1000.0f;
+}
+
+bool get_ticks_signed()
+{
+  return pcnt_active;
 }
 
 float get_left_speed_mps()
 {
-  // TODO: compute speed from tick rate over a rolling time window
-  return 0.0f;
+  return left_speed_mmps / 1000.0f;
 }
 
 float get_right_speed_mps()
 {
-  // TODO: compute speed from tick rate over a rolling time window
-  return 0.0f;
+  return right_speed_mmps / 1000.0f;
 }
 
 float get_distance_m()
 {
   const float circumference = kWheelDiameterM * (float)M_PI;
-  const long  avg_ticks     = (left_ticks + right_ticks) / 2;
-  return (avg_ticks / (float)kEncoderPpr) * circumference;
+  const long  avg_ticks     = (get_left_ticks() + get_right_ticks()) / 2;
+  return (avg_ticks / (float)counts_per_rev) * circumference;
+}
+
+void reset_pid()
+{
+  pid::reset(left_pid, left_speed_mmps);
+  pid::reset(right_pid, right_speed_mmps);
 }
 
-void update_pid(int target_left_pwm, int target_right_pwm)
+void update_pid(int target_left_mmps, int target_right_mmps)
 {
-  // TODO: read current speed, compute PID error, and call drive() with corrected values
-  (void)target_left_pwm;
-  (void)target_right_pwm;
+  if (!sample_ready)
+  {
+    return;
+  }
+  sample_ready = false;
+
+  set_pwm_targets(pid::step(left_pid, kPidGains, target_left_mmps, left_speed_mmps,
+                            mmps_to_pwm(kLeftMotor, target_left_mmps)),
+                  pid::step(right_pid, kPidGains, target_right_mmps, right_speed_mmps,
+                            mmps_to_pwm(kRightMotor, target_right_mmps)));
 }
 
 } // namespace bot
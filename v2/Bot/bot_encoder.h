@@ -3,9 +3,11 @@
 // Optional: Motor encoder support
 //
 // Not required for the basic build — the bot runs fine without encoders.
-// Enable by defining BOT_HAS_ENCODERS in bot_config.h and filling in the implementation.
-// Encoders enable closed-loop PID speed control and wheel odometry, both of which
-// are needed for accurate SLAM.
+// Enable by defining BOT_HAS_ENCODERS in bot_config.h.
+// Encoders enable closed-loop PID speed control (drive_mmps) and wheel odometry,
+// both of which are needed for accurate SLAM.
+
+#include "bot_config.h"  // defines BOT_HAS_ENCODERS
 
 #ifdef BOT_HAS_ENCODERS
 
@@ -15,11 +17,17 @@ namespace bot {
 
 void  setup_encoders();
 void  reset_odometry();
-float get_left_speed_mps();               // left wheel speed in m/s
-float get_right_speed_mps();              // right wheel speed in m/s
+long  get_left_ticks();                   // raw encoder pulse counts
+long  get_right_ticks();
+float get_meters_per_tick();              // follows the active counting backend
+bool  get_ticks_signed();                 // true for quadrature, false for the single-channel ISR
+void  update_encoders();                  // call every loop; samples at kSpeedSampleMs
+float get_left_speed_mps();               // left wheel speed in m/s, rolling window
+float get_right_speed_mps();              // right wheel speed in m/s, rolling window
 float get_distance_m();                   // average forward distance traveled
-void  update_pid(int target_left_pwm,
-                 int target_right_pwm);   // closed-loop speed correction
+void  reset_pid();
+void  update_pid(int target_left_mmps,
+                 int target_right_mmps);  // closed-loop speed correction, once per sample
 
 } // namespace bot
 
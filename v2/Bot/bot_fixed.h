@@ -0,0 +1,130 @@
+#pragma once
+
+// Fixed-point helpers for code that runs every tick on the ESP32-C3.
+//
+// The C3 has no FPU, so hot loops (planner, fusion) work in integers:
+//   angles  - binary angle units, 65536 = one full turn (wraps for free in uint16_t)
+//   ratios  - Q14, 16384 = 1.0
+//
+// Header-only with no Arduino dependencies so it can be compiled on a host.
+
+#include <stdint.h>
+
+namespace bot {
+namespace fixed {
+
+constexpr int32_t kQ14One = 1 << 14;
+constexpr int32_t kBamPerTurn = 65536;
+// 65536 / (2 * pi), for converting radians-per-unit rates into binary angle units.
+constexpr int32_t kBamPerRad = 10430;
+
+// sin() over one quadrant in Q14, 64 segments plus the end point.
+constexpr int16_t kSinQuarterQ14[65] = {
+        0,   402,   804,  1205,  1606,  2006,  2404,  2801,
+     3196,  3590,  3981,  4370,  4756,  5139,  5520,  5897,
+     6270,  6639,  7005,  7366,  7723,  8076,  8423,  8765,
+     9102,  9434,  9760, 10080, 10394, 10702, 11003, 11297,
+    11585, 11866, 12140, 12406, 12665, 12916, 13160, 13395,
+    13623, 13842, 14053, 14256, 14449, 14635, 14811, 14978,
+    15137, 15286, 15426, 15557, 15679, 15791, 15893, 15986,
+    16069, 16143, 16207, 16261, 16305, 16340, 16364, 16379,
+    16384,
+};
+
+inline constexpr uint16_t deg_to_bam(int32_t deg)
+{
+  return static_cast<uint16_t>((deg * kBamPerTurn) / 360);
+}
+
+inline constexpr int32_t bam_to_deg(int16_t bam)
+{
+  return (static_cast<int32_t>(bam) * 360) / kBamPerTurn;
+}
+
+inline int16_t sin_q14(uint16_t angle)
+{
+  const uint16_t quadrant = angle >> 14;
+  uint16_t within = angle & 0x3FFF;
+  if (quadrant & 1)
+  {
+    within = 0x4000 - within;
+  }
+
+  // 256 binary angle units per table segment; interpolate linearly.
+  const uint16_t index = within >> 8;
+  const int32_t frac = within & 0xFF;
+  int32_t value = kSinQuarterQ14[index];
+  if (index < 64)
+  {
+    value += ((kSinQuarterQ14[index + 1] - value) * frac) >> 8;
+  }
+
+  return static_cast<int16_t>((quadrant & 2) ? -value : value);
+}
+
+inline int16_t cos_q14(uint16_t angle)
+{
+  return sin_q14(static_cast<uint16_t>(angle + 0x4000));
+}
+
+// atan2 in binary angle units, signed (-32768..32767 = -pi..pi).
+// Polynomial octant fit, max error about 0.1 degree.
+inline int16_t atan2_bam(int32_t y, int32_t x)
+{
+  if (x == 0 && y == 0)
+  {
+    return 0;
+  }
+
+  const uint32_t ax = x < 0 ? 0U - static_cast<uint32_t>(x) : static_cast<uint32_t>(x);
+  const uint32_t ay = y < 0 ? 0U - static_cast<uint32_t>(y) : static_cast<uint32_t>(y);
+  const bool steep = ay > ax;
+  // Ratio of the smaller to the larger component in Q14, always 0..1.
+  const int32_t z = static_cast<int32_t>(
+      (static_cast<uint64_t>(steep ? ax : ay) << 14) / (steep ? ay : ax));
+
+  // atan(z) ~ pi/4 z + z (1 - z) (0.2447 + 0.0663 z), scaled to binary angle units.
+  const int32_t z_one_minus_z = (z * (kQ14One - z)) >> 14;
+  int32_t angle = ((8192 * z) >> 14) + ((z_one_minus_z * (2552 + ((692 * z) >> 14))) >> 14);
+
+  if (steep)
+  {
+    angle = 16384 - angle;
+  }
+  if (x < 0)
+  {
+    angle = 32768 - angle;
+  }
+  if (y < 0)
+  {
+    angle = -angle;
+  }
+  return static_cast<int16_t>(angle);
+}
+
+inline uint32_t isqrt32(uint32_t value)
+{
+  uint32_t result = 0;
+  uint32_t bit = 1UL << 30;
+  while (bit > value)
+  {
+    bit >>= 2;
+  }
+  while (bit != 0)
+  {
+    if (value >= result + bit)
+    {
+      value -= result + bit;
+      result = (result >> 1) + bit;
+    }
+    else
+    {
+      result >>= 1;
+    }
+    bit >>= 2;
+  }
+  return result;
+}
+
+} // namespace fixed
+} // namespace bot
@@ -0,0 +1,184 @@
+#pragma once
+
+// Mahony attitude filter in fixed point, for the ESP32-C3 (no FPU).
+//
+//   quaternion  - Q30, w x y z, body frame x forward, y left, z up
+//   gyro input  - Q16 rad/s, bias already removed
+//   accel input - raw counts, any scale (only the direction is used)
+//   gains       - Q8, kp in rad/s per unit of gravity error, ki in rad/s^2
+//
+// Gravity only corrects pitch and roll; yaw is the integrated gyro.
+// Header-only with no Arduino dependencies so it can be compiled on a host.
+
+#include <stdint.h>
+
+#include "bot_fixed.h"
+
+namespace bot {
+namespace fusion {
+
+constexpr int32_t kQ30One = 1L << 30;
+
+struct Mahony
+{
+  int32_t q[4] = {kQ30One, 0, 0, 0};
+  int32_t integral_q16[3]{};
+  uint16_t kp_q8 = 256;
+  uint16_t ki_q8 = 0;
+  bool initialised = false;
+};
+
+inline int32_t mul_q30(int32_t a, int32_t b)
+{
+  return static_cast<int32_t>((static_cast<int64_t>(a) * b) >> 30);
+}
+
+inline void reset(Mahony &filter)
+{
+  filter.q[0] = kQ30One;
+  filter.q[1] = 0;
+  filter.q[2] = 0;
+  filter.q[3] = 0;
+  filter.integral_q16[0] = 0;
+  filter.integral_q16[1] = 0;
+  filter.integral_q16[2] = 0;
+  filter.initialised = false;
+}
+
+// Levels the quaternion to the measured gravity with zero yaw.
+inline void init_from_accel(Mahony &filter, const int16_t accel[3])
+{
+  const int32_t ax = accel[0];
+  const int32_t ay = accel[1];
+  const int32_t az = accel[2];
+
+  const uint16_t roll = static_cast<uint16_t>(fixed::atan2_bam(ay, az));
+  const uint16_t pitch = static_cast<uint16_t>(fixed::atan2_bam(
+      -ax, static_cast<int32_t>(fixed::isqrt32(static_cast<uint32_t>(ay * ay) +
+                                               static_cast<uint32_t>(az * az)))));
+
+  const int32_t cr = fixed::cos_q14(roll / 2);
+  const int32_t sr = fixed::sin_q14(roll / 2);
+  const int32_t cp = fixed::cos_q14(pitch / 2);
+  const int32_t sp = fixed::sin_q14(pitch / 2);
+
+  // Q14 * Q14 = Q28, shifted up to Q30.
+  filter.q[0] = (cr * cp) << 2;
+  filter.q[1] = (sr * cp) << 2;
+  filter.q[2] = (cr * sp) << 2;
+  filter.q[3] = -((sr * sp) << 2);
+  filter.initialised = true;
+}
+
+inline void update(Mahony &filter,
+                   const int16_t accel[3],
+                   const int32_t gyro_q16[3],
+                   uint32_t dt_us)
+{
+  if (!filter.initialised)
+  {
+    init_from_accel(filter, accel);
+  }
+
+  int32_t *q = filter.q;
+  int64_t gx = gyro_q16[0];
+  int64_t gy = gyro_q16[1];
+  int64_t gz = gyro_q16[2];
+
+  const uint32_t accel_norm = fixed::isqrt32(
+      static_cast<uint32_t>(accel[0] * accel[0]) +
+      static_cast<uint32_t>(accel[1] * accel[1]) +
+      static_cast<uint32_t>(accel[2] * accel[2]));
+  if (accel_norm > 0)
+  {
+    const int32_t ax = (static_cast<int32_t>(accel[0]) << 14) / static_cast<int32_t>(accel_norm);
+    const int32_t ay = (static_cast<int32_t>(accel[1]) << 14) / static_cast<int32_t>(accel_norm);
+    const int32_t az = (static_cast<int32_t>(accel[2]) << 14) / static_cast<int32_t>(accel_norm);
+
+    // Gravity direction predicted by the current estimate, Q14.
+    const int32_t vx = static_cast<int32_t>(
+        (static_cast<int64_t>(q[1]) * q[3] - static_cast<int64_t>(q[0]) * q[2]) >> 45);
+    const int32_t vy = static_cast<int32_t>(
+        (static_cast<int64_t>(q[0]) * q[1] + static_cast<int64_t>(q[2]) * q[3]) >> 45);
+    const int32_t vz = static_cast<int32_t>(
+        (static_cast<int64_t>(q[0]) * q[0] - static_cast<int64_t>(q[1]) * q[1] -
+         static_cast<int64_t>(q[2]) * q[2] + static_cast<int64_t>(q[3]) * q[3]) >> 46);
+
+    // Rotation error between measured and predicted gravity, Q14.
+    const int32_t ex = (ay * vz - az * vy) >> 14;
+    const int32_t ey = (az * vx - ax * vz) >> 14;
+    const int32_t ez = (ax * vy - ay * vx) >> 14;
+
+    if (filter.ki_q8 > 0)
+    {
+      // ki (Q8) * e (Q14) = Q22; down to Q16 and scaled by dt.
+      constexpr int64_t kDiv = 1000000LL << 6;
+      filter.integral_q16[0] += static_cast<int32_t>(static_cast<int64_t>(filter.ki_q8) * ex * dt_us / kDiv);
+      filter.integral_q16[1] += static_cast<int32_t>(static_cast<int64_t>(filter.ki_q8) * ey * dt_us / kDiv);
+      filter.integral_q16[2] += static_cast<int32_t>(static_cast<int64_t>(filter.ki_q8) * ez * dt_us / kDiv);
+      gx += filter.integral_q16[0];
+      gy += filter.integral_q16[1];
+      gz += filter.integral_q16[2];
+    }
+
+    gx += (static_cast<int32_t>(filter.kp_q8) * ex) >> 6;
+    gy += (static_cast<int32_t>(filter.kp_q8) * ey) >> 6;
+    gz += (static_cast<int32_t>(filter.kp_q8) * ez) >> 6;
+  }
+
+  // Half-angle step, Q16 rad/s * us -> Q30 rad: * 2^14 / 2 / 1e6.
+  const int32_t hx = static_cast<int32_t>(gx * dt_us * 8192 / 1000000);
+  const int32_t hy = static_cast<int32_t>(gy * dt_us * 8192 / 1000000);
+  const int32_t hz = static_cast<int32_t>(gz * dt_us * 8192 / 1000000);
+
+  const int32_t q0 = q[0];
+  const int32_t q1 = q[1];
+  const int32_t q2 = q[2];
+  const int32_t q3 = q[3];
+  q[0] = q0 - mul_q30(q1, hx) - mul_q30(q2, hy) - mul_q30(q3, hz);
+  q[1] = q1 + mul_q30(q0, hx) + mul_q30(q2, hz) - mul_q30(q3, hy);
+  q[2] = q2 + mul_q30(q0, hy) - mul_q30(q1, hz) + mul_q30(q3, hx);
+  q[3] = q3 + mul_q30(q0, hz) + mul_q30(q1, hy) - mul_q30(q2, hx);
+
+  // The norm drifts by ~dt^2 per step, so one Newton step of 1/sqrt is enough.
+  const int64_t norm_sq = (static_cast<int64_t>(q[0]) * q[0] + static_cast<int64_t>(q[1]) * q[1] +
+                           static_cast<int64_t>(q[2]) * q[2] + static_cast<int64_t>(q[3]) * q[3]) >> 30;
+  const int32_t scale = static_cast<int32_t>(((3LL << 30) - norm_sq) / 2);
+  for (uint8_t i = 0; i < 4; ++i)
+  {
+    q[i] = mul_q30(q[i], scale);
+  }
+}
+
+// Euler angles in signed binary angle units (ZYX order).
+inline int16_t yaw_bam(const Mahony &filter)
+{
+  const int32_t *q = filter.q;
+  return fixed::atan2_bam(mul_q30(q[0], q[3]) + mul_q30(q[1], q[2]),
+                          kQ30One / 2 - mul_q30(q[2], q[2]) - mul_q30(q[3], q[3]));
+}
+
+inline int16_t pitch_bam(const Mahony &filter)
+{
+  const int32_t *q = filter.q;
+  const int32_t s = 2 * (mul_q30(q[0], q[2]) - mul_q30(q[3], q[1]));
+  const int32_t s_q15 = s >> 15;
+  const int32_t c_sq = (1L << 30) - s_q15 * s_q15;
+  const int32_t c_q15 = static_cast<int32_t>(fixed::isqrt32(c_sq > 0 ? static_cast<uint32_t>(c_sq) : 0U));
+  return fixed::atan2_bam(s_q15, c_q15);
+}
+
+inline int16_t roll_bam(const Mahony &filter)
+{
+  const int32_t *q = filter.q;
+  return fixed::atan2_bam(mul_q30(q[0], q[1]) + mul_q30(q[2], q[3]),
+                          kQ30One / 2 - mul_q30(q[1], q[1]) - mul_q30(q[2], q[2]));
+}
+
+inline int16_t quat_q14(const Mahony &filter, uint8_t index)
+{
+  return static_cast<int16_t>(filter.q[index] >> 16);
+}
+
+} // namespace fusion
+} // namespace bot
@@ -2,33 +2,273 @@
 
 #ifdef BOT_HAS_IMU
 
-// Include your IMU library here, e.g.:
-// #include <Adafruit_MPU6050.h>
-// #include <Adafruit_Sensor.h>
+#include <Wire.h>
+
+#include "bot_config.h"
+#include "bot_fusion.h"
 
 namespace bot {
+namespace {
+
+// MPU-6050 registers.
+constexpr uint8_t kRegSmplrtDiv = 0x19;
+constexpr uint8_t kRegConfig = 0x1A;
+constexpr uint8_t kRegGyroConfig = 0x1B;
+constexpr uint8_t kRegAccelConfig = 0x1C;
+constexpr uint8_t kRegFifoEn = 0x23;
+constexpr uint8_t kRegIntStatus = 0x3A;
+constexpr uint8_t kRegUserCtrl = 0x6A;
+constexpr uint8_t kRegPwrMgmt1 = 0x6B;
+constexpr uint8_t kRegFifoCountH = 0x72;
+constexpr uint8_t kRegFifoRw = 0x74;
+constexpr uint8_t kRegWhoAmI = 0x75;
+
+constexpr uint8_t kFifoEnAccelGyro = 0x78;   // XG, YG, ZG, ACCEL
+constexpr uint8_t kUserCtrlFifoEn = 0x40;
+constexpr uint8_t kUserCtrlFifoReset = 0x04;
+constexpr uint8_t kIntStatusFifoOverflow = 0x10;
+constexpr uint8_t kDlpf44Hz = 0x03;          // gyro output rate 1 kHz
+constexpr uint8_t kGyro500Dps = 0x08;
+constexpr uint8_t kAccel4G = 0x08;
+constexpr float kGyroLsbPerDps = 65.5f;
+// Raw gyro counts to Q16 rad/s, as a Q8 multiplier: 65536 * (pi / 180) / 65.5 * 256.
+constexpr int32_t kGyroRawToRadQ16Q8 = 4470;
+
+// One FIFO record: accel xyz then gyro xyz, big-endian int16.
+constexpr size_t kSampleBytes = 12;
+// Whole records per burst; the Arduino Wire buffer is 128 bytes.
+constexpr size_t kSamplesPerBurst = 10;
+constexpr uint32_t kSampleDtUs = 1000000UL / kImuSampleHz;
+
+bool imu_ready = false;
+int16_t gyro_bias_raw[3]{};
+fusion::Mahony attitude;
+int16_t yaw_rate_raw = 0;
+uint32_t sample_count = 0;
+uint32_t fifo_overflows = 0;
+
+bool write_register(uint8_t reg, uint8_t value)
+{
+  Wire.beginTransmission(kImuAddress);
+  Wire.write(reg);
+  Wire.write(value);
+  return Wire.endTransmission() == 0;
+}
 
-void setup_imu()
+bool read_registers(uint8_t reg, uint8_t *buffer, size_t len)
 {
-  // TODO: initialize IMU over I2C using kImuSdaPin / kImuSclPin from bot_config.h
+  Wire.beginTransmission(kImuAddress);
+  Wire.write(reg);
+  if (Wire.endTransmission(false) != 0)
+  {
+    return false;
+  }
+  if (Wire.requestFrom(kImuAddress, len) != len)
+  {
+    return false;
+  }
+  for (size_t i = 0; i < len; ++i)
+  {
+    buffer[i] = static_cast<uint8_t>(Wire.read());
+  }
+  return true;
+}
+
+int16_t read_be_i16(const uint8_t *data)
+{
+  return static_cast<int16_t>((static_cast<uint16_t>(data[0]) << 8) | data[1]);
+}
+
+void reset_fifo()
+{
+  write_register(kRegUserCtrl, kUserCtrlFifoReset);
+  write_register(kRegUserCtrl, kUserCtrlFifoEn);
+}
+
+uint16_t fifo_count()
+{
+  uint8_t raw[2];
+  if (!read_registers(kRegFifoCountH, raw, sizeof(raw)))
+  {
+    return 0;
+  }
+  return static_cast<uint16_t>((raw[0] << 8) | raw[1]);
+}
+
+// Drains whole records from the FIFO. Returns the number of samples passed
+// to handle_sample.
+template <typename Handler>
+size_t drain_fifo(Handler handle_sample)
+{
+  uint8_t status = 0;
+  if (read_registers(kRegIntStatus, &status, 1) && (status & kIntStatusFifoOverflow))
+  {
+    // A partial record may be stuck at the head; restart cleanly.
+    ++fifo_overflows;
+    reset_fifo();
+    return 0;
+  }
+
+  size_t available = fifo_count() / kSampleBytes;
+  size_t handled = 0;
+  uint8_t burst[kSampleBytes * kSamplesPerBurst];
+
+  while (available > 0)
+  {
+    const size_t samples = min(available, kSamplesPerBurst);
+    if (!read_registers(kRegFifoRw, burst, samples * kSampleBytes))
+    {
+      break;
+    }
+
+    for (size_t i = 0; i < samples; ++i)
+    {
+      const uint8_t *record = burst + i * kSampleBytes;
+      int16_t accel[3];
+      int16_t gyro[3];
+      for (uint8_t axis = 0; axis < 3; ++axis)
+      {
+        accel[axis] = read_be_i16(record + axis * 2);
+        gyro[axis] = read_be_i16(record + 6 + axis * 2);
+      }
+      handle_sample(accel, gyro);
+    }
+
+    available -= samples;
+    handled += samples;
+  }
+
+  return handled;
+}
+
+void filter_sample(const int16_t accel[3], const int16_t gyro[3])
+{
+  int32_t gyro_q16[3];
+  for (uint8_t axis = 0; axis < 3; ++axis)
+  {
+    gyro_q16[axis] = ((gyro[axis] - gyro_bias_raw[axis]) * kGyroRawToRadQ16Q8) >> 8;
+  }
+
+  fusion::update(attitude, accel, gyro_q16, kSampleDtUs);
+  yaw_rate_raw = static_cast<int16_t>(gyro[2] - gyro_bias_raw[2]);
+  ++sample_count;
+}
+
+void calibrate_gyro_bias()
+{
+  int32_t sum[3]{};
+  uint16_t collected = 0;
+  const unsigned long deadline =
+      millis() + 2000UL + (1000UL * kImuCalibrationSamples) / kImuSampleHz;
+
+  reset_fifo();
+  while (collected < kImuCalibrationSamples && millis() < deadline)
+  {
+    delay(20);
+    drain_fifo([&](const int16_t *, const int16_t *gyro) {
+      if (collected >= kImuCalibrationSamples)
+      {
+        return;
+      }
+      for (uint8_t axis = 0; axis < 3; ++axis)
+      {
+        sum[axis] += gyro[axis];
+      }
+      ++collected;
+    });
+  }
+
+  if (collected > 0)
+  {
+    for (uint8_t axis = 0; axis < 3; ++axis)
+    {
+      gyro_bias_raw[axis] = static_cast<int16_t>(sum[axis] / collected);
+    }
+  }
+}
+
+} // namespace
+
+bool setup_imu()
+{
+  Wire.begin(kImuSdaPin, kImuSclPin, kImuI2cHz);
+
+  uint8_t who_am_i = 0;
+  if (!read_registers(kRegWhoAmI, &who_am_i, 1) || who_am_i != 0x68)
+  {
+    Serial.printf("IMU not found at 0x%02X (who_am_i=0x%02X)\n", kImuAddress, who_am_i);
+    return false;
+  }
+
+  write_register(kRegPwrMgmt1, 0x01);  // wake, PLL on gyro X
+  delay(50);
+  write_register(kRegConfig, kDlpf44Hz);
+  write_register(kRegSmplrtDiv, static_cast<uint8_t>(1000 / kImuSampleHz - 1));
+  write_register(kRegGyroConfig, kGyro500Dps);
+  write_register(kRegAccelConfig, kAccel4G);
+  write_register(kRegFifoEn, kFifoEnAccelGyro);
+  reset_fifo();
+
+  calibrate_gyro_bias();
+  fusion::reset(attitude);
+  attitude.kp_q8 = kImuMahonyKpQ8;
+  attitude.ki_q8 = kImuMahonyKiQ8;
+  imu_ready = true;
+
+  Serial.printf("MPU-6050 ready: %u Hz FIFO, I2C %lu Hz, gyro bias %.2f %.2f %.2f dps\n",
+                static_cast<unsigned>(kImuSampleHz),
+                static_cast<unsigned long>(kImuI2cHz),
+                gyro_bias_raw[0] / kGyroLsbPerDps,
+                gyro_bias_raw[1] / kGyroLsbPerDps,
+                gyro_bias_raw[2] / kGyroLsbPerDps);
+  return true;
+}
+
+void update_imu()
+{
+  if (!imu_ready)
+  {
+    return;
+  }
+  drain_fifo(filter_sample);
 }
 
 float get_heading_deg()
 {
-  // TODO: return fused yaw estimate
-  return 0.0f;
+  return fusion::yaw_bam(attitude) * (360.0f / 65536.0f);
 }
 
 float get_pitch_deg()
 {
-  // TODO: return pitch from accelerometer
-  return 0.0f;
+  return fusion::pitch_bam(attitude) * (360.0f / 65536.0f);
 }
 
 float get_roll_deg()
 {
-  // TODO: return roll from accelerometer
-  return 0.0f;
+  return fusion::roll_bam(attitude) * (360.0f / 65536.0f);
+}
+
+float get_yaw_rate_dps()
+{
+  return yaw_rate_raw / kGyroLsbPerDps;
+}
+
+int16_t get_heading_bam()
+{
+  return fusion::yaw_bam(attitude);
+}
+
+void get_quaternion_q14(int16_t quat[4])
+{
+  for (uint8_t i = 0; i < 4; ++i)
+  {
+    quat[i] = fusion::quat_q14(attitude, i);
+  }
+}
+
+uint32_t get_imu_sample_count()
+{
+  return sample_count;
 }
 
 } // namespace bot
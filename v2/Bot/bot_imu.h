@@ -1,21 +1,31 @@
 #pragma once
 
-// Optional: IMU support (e.g. MPU-6050, ICM-42688-P)
+// Optional: IMU support (MPU-6050)
 //
 // Not required for the basic build — the bot runs fine with just TT motors and LiDAR.
-// Enable by defining BOT_HAS_IMU in bot_config.h and filling in the implementation.
+// Enable by defining BOT_HAS_IMU in bot_config.h.
+// Samples are collected by the sensor's hardware FIFO at kImuSampleHz and read
+// in I2C bursts, so each loop costs one or two transactions regardless of rate.
+// Every sample runs through the fixed-point Mahony filter in bot_fusion.h.
 // Useful for heading estimation and tilt compensation in more advanced navigation.
 
+#include "bot_config.h"  // defines BOT_HAS_IMU
+
 #ifdef BOT_HAS_IMU
 
 #include <Arduino.h>
 
 namespace bot {
 
-void  setup_imu();
-float get_heading_deg();  // yaw estimate from gyro/magnetometer fusion
-float get_pitch_deg();    // pitch from accelerometer
-float get_roll_deg();     // roll from accelerometer
+bool  setup_imu();
+void  update_imu();       // call every loop; drains the FIFO and runs the Mahony filter
+float get_heading_deg();  // fused yaw (gyro only, no magnetometer), CCW positive
+float get_pitch_deg();
+float get_roll_deg();
+float get_yaw_rate_dps(); // latest bias-corrected z rate
+int16_t get_heading_bam();               // fused yaw, 65536 = one turn
+void  get_quaternion_q14(int16_t quat[4]);  // w x y z, 16384 = 1.0
+uint32_t get_imu_sample_count();
 
 } // namespace bot
 
@@ -1,10 +1,11 @@
 #include "bot_lidar.h"
 
-#include <esp_now.h>
 #include <string.h>
 
 #include "bot_behaviors.h"
+#include "bot_planner.h"
 #include "bot_state.h"
+#include "bot_telemetry.h"
 
 namespace bot {
 namespace {
@@ -130,97 +131,8 @@ void update_lidar()
   {
     const lidar::ScanFrame &scan = lidar_reader.latest_scan();
     refresh_lidar_state(scan);
-
-    const unsigned long now = millis();
-    if (controller_peer_known && (now - last_telemetry_ms) >= kTelemetryIntervalMs)
-    {
-      last_telemetry_ms = now;
-      ++telemetry_frame_id;
-
-      TelemetryPoint sampled_points[kTelemetryMaxPoints]{};
-      uint8_t sampled_count = 0;
-
-      if (scan.valid_point_count > 0)
-      {
-        const uint16_t desired_points =
-            (scan.valid_point_count < kTelemetryMaxPoints)
-                ? scan.valid_point_count
-                : static_cast<uint16_t>(kTelemetryMaxPoints);
-        uint16_t valid_index = 0;
-        uint8_t selected = 0;
-
-        for (uint16_t i = 0; i < scan.point_count && selected < desired_points; ++i)
-        {
-          const lidar::ScanPoint &point = scan.points[i];
-          if (!point.valid)
-          {
-            continue;
-          }
-
-          const uint16_t bucket =
-              static_cast<uint32_t>(valid_index) * desired_points / scan.valid_point_count;
-          if (bucket == selected)
-          {
-            sampled_points[selected].x_mm = point.x_mm;
-            sampled_points[selected].y_mm = point.y_mm;
-            sampled_points[selected].intensity = point.intensity;
-            ++selected;
-          }
-
-          ++valid_index;
-        }
-
-        sampled_count = selected;
-      }
-
-      if (sampled_count > 0)
-      {
-        const uint8_t chunk_count =
-            (sampled_count + kTelemetryPointsPerChunk - 1) / kTelemetryPointsPerChunk;
-
-        for (uint8_t chunk_index = 0; chunk_index < chunk_count; ++chunk_index)
-        {
-          const uint8_t point_offset = chunk_index * kTelemetryPointsPerChunk;
-          const uint8_t remaining = sampled_count - point_offset;
-          const uint8_t points_in_chunk =
-              (remaining < kTelemetryPointsPerChunk) ? remaining : kTelemetryPointsPerChunk;
-          const size_t packet_size =
-              sizeof(TelemetryHeader) + points_in_chunk * sizeof(TelemetryPoint);
-          uint8_t packet_buffer[sizeof(TelemetryHeader) +
-                                kTelemetryPointsPerChunk * sizeof(TelemetryPoint)]{};
-
-          TelemetryHeader header{
-              kTelemetryMagic,
-              kTelemetryVersion,
-              kTelemetryTypeScanChunk,
-              telemetry_frame_id,
-              chunk_index,
-              chunk_count,
-              points_in_chunk,
-              sampled_count,
-          };
-
-          memcpy(packet_buffer, &header, sizeof(header));
-          memcpy(packet_buffer + sizeof(header),
-                 &sampled_points[point_offset],
-                 points_in_chunk * sizeof(TelemetryPoint));
-          esp_now_send(controller_peer_addr, packet_buffer, packet_size);
-        }
-      }
-
-      const MotionTelemetry motion_packet{
-          kTelemetryMagic,
-          kTelemetryVersion,
-          kTelemetryTypeMotion,
-          static_cast<char>(mode),
-          static_cast<char>(direction),
-          static_cast<uint8_t>(((g_dodging || g_unsticking) ? 0x01 : 0x00) |
-                               (g_wall_follow_left ? 0x02 : 0x00)),
-      };
-      esp_now_send(controller_peer_addr,
-                   reinterpret_cast<const uint8_t *>(&motion_packet),
-                   sizeof(motion_packet));
-    }
+    update_planner_histogram(scan);
+    update_telemetry(scan);
   }
 }
 
@@ -1,58 +1,201 @@
 #include "bot_motor.h"
 
+#include <soc/gpio_reg.h>
+#include <soc/soc.h>
+
 #include "bot_config.h"
+#include "bot_encoder.h"
 #include "bot_led.h"
 #include "bot_state.h"
 
 namespace bot {
 
+namespace {
+
+int8_t standby_state = -1;
+
+} // namespace
+
 void enable_motor_driver(bool enabled)
 {
-  if (kMotorStandbyPin >= 0)
+  if (kMotorStandbyPin >= 0 && standby_state != static_cast<int8_t>(enabled))
   {
     digitalWrite(kMotorStandbyPin, enabled ? HIGH : LOW);
+    standby_state = static_cast<int8_t>(enabled);
+  }
+}
+
+namespace {
+
+struct MotorPins
+{
+  int pwm;
+  int in1;
+  int in2;
+  int polarity;
+};
+
+constexpr MotorPins kMotorPins[2] = {
+    {kLeftPwmPin, kLeftMotorIn1Pin, kLeftMotorIn2Pin, kLeftMotorPolarity},
+    {kRightPwmPin, kRightMotorIn1Pin, kRightMotorIn2Pin, kRightMotorPolarity},
+};
+
+// Direction pins are driven through the GPIO set/clear registers, which only
+// cover GPIO 0-31 on the C3.
+static_assert(kLeftMotorIn1Pin < 32 && kLeftMotorIn2Pin < 32 &&
+                  kRightMotorIn1Pin < 32 && kRightMotorIn2Pin < 32,
+              "motor direction pins must be GPIO 0-31");
+
+// Last values written to each channel; drive() is called far more often than
+// the output actually changes. Only the loop task writes the motors (remote
+// packets are queued by the receive callback and run from loop()), so the
+// cache never goes stale under a concurrent write.
+struct MotorOutputCache
+{
+  bool valid = false;
+  int8_t dir = 0;
+  uint32_t duty = 0;
+};
+
+MotorOutputCache output_cache[2];
+uint32_t output_writes = 0;
+uint32_t output_writes_skipped = 0;
+
+constexpr unsigned long kBenchSettleMs = 800;
+constexpr unsigned long kBenchSampleMs = 100;
+constexpr uint8_t kBenchSamples = 12;
+
+uint32_t duty_for(MotorSide side, int magnitude)
+{
+  if (magnitude <= 0)
+  {
+    return 0;
+  }
+
+  const PwmMode &pwm = kPwmModes[pwm_mode_index];
+  const uint32_t full = (1UL << pwm.bits) - 1;
+  const uint16_t min_permille =
+      (side == kLeftMotor) ? pwm.left_min_permille : pwm.right_min_permille;
+  const uint32_t min_duty = full * min_permille / 1000U;
+  return min_duty + (full - min_duty) * static_cast<uint32_t>(magnitude) / 255U;
+}
+
+void attach_motor_pwm()
+{
+  const PwmMode &pwm = kPwmModes[pwm_mode_index];
+  for (const MotorPins &pins : kMotorPins)
+  {
+    ledcDetach(pins.pwm);
+    ledcDetach(pins.in1);
+    ledcDetach(pins.in2);
+    output_cache[&pins - kMotorPins].valid = false;
+
+    if (decay_mode == kFastDecay)
+    {
+      pinMode(pins.pwm, OUTPUT);
+      digitalWrite(pins.pwm, HIGH);
+      ledcAttach(pins.in1, pwm.freq_hz, pwm.bits);
+      ledcAttach(pins.in2, pwm.freq_hz, pwm.bits);
+    }
+    else
+    {
+      ledcAttach(pins.pwm, pwm.freq_hz, pwm.bits);
+      pinMode(pins.in1, OUTPUT);
+      pinMode(pins.in2, OUTPUT);
+    }
+  }
+}
+
+void write_direction_pins(const MotorPins &pins, int8_t dir)
+{
+  const uint32_t in1_mask = 1UL << pins.in1;
+  const uint32_t in2_mask = 1UL << pins.in2;
+  const uint32_t set_mask = (dir > 0) ? in1_mask : (dir < 0) ? in2_mask : 0;
+
+  // Clear first, then set: each register write updates its pins in one bus
+  // cycle, and the bridge never sees IN1=IN2=HIGH (short brake) in between.
+  REG_WRITE(GPIO_OUT_W1TC_REG, (in1_mask | in2_mask) & ~set_mask);
+  if (set_mask != 0)
+  {
+    REG_WRITE(GPIO_OUT_W1TS_REG, set_mask);
   }
 }
 
-void set_motor(int pwm_pin, int in1_pin, int in2_pin, int speed)
+} // namespace
+
+void set_motor(MotorSide side, int speed)
 {
-  speed = constrain(speed, -255, 255);
+  const MotorPins &pins = kMotorPins[side];
+  speed = constrain(speed * pins.polarity, -255, 255);
+  const int8_t dir = static_cast<int8_t>((speed > 0) - (speed < 0));
+  const uint32_t duty = duty_for(side, abs(speed));
 
-  if (speed == 0)
+  MotorOutputCache &cache = output_cache[side];
+  const bool dir_changed = !cache.valid || cache.dir != dir;
+  const bool duty_changed = !cache.valid || cache.duty != duty;
+  if (!dir_changed && !duty_changed)
   {
-    digitalWrite(in1_pin, LOW);
-    digitalWrite(in2_pin, LOW);
-    ledcWrite(pwm_pin, 0);
+    ++output_writes_skipped;
     return;
   }
+  ++output_writes;
+
+  if (speed != 0)
+  {
+    enable_motor_driver(true);
+  }
 
-  enable_motor_driver(true);
-  if (speed > 0)
+  if (decay_mode == kFastDecay)
   {
-    digitalWrite(in1_pin, HIGH);
-    digitalWrite(in2_pin, LOW);
+    // Drive/coast: chop the active input, hold the other low.
+    ledcWrite(pins.in1, dir > 0 ? duty : 0);
+    ledcWrite(pins.in2, dir < 0 ? duty : 0);
   }
   else
   {
-    digitalWrite(in1_pin, LOW);
-    digitalWrite(in2_pin, HIGH);
-    speed = -speed;
+    // Drive/brake: direction on the inputs, chop PWMx.
+    if (dir_changed)
+    {
+      write_direction_pins(pins, dir);
+    }
+    if (duty_changed)
+    {
+      ledcWrite(pins.pwm, duty);
+    }
   }
 
-  const uint32_t duty = kLedcMax * static_cast<uint32_t>(speed) / 255U;
-  ledcWrite(pwm_pin, duty);
+  cache.valid = true;
+  cache.dir = dir;
+  cache.duty = duty;
 }
 
-void drive(int left_speed, int right_speed)
+namespace {
+
+int ramp_toward(int current, int target, int accel_step, int decel_step)
 {
-  set_motor(kLeftPwmPin,
-            kLeftMotorIn1Pin,
-            kLeftMotorIn2Pin,
-            left_speed * kLeftMotorPolarity);
-  set_motor(kRightPwmPin,
-            kRightMotorIn1Pin,
-            kRightMotorIn2Pin,
-            right_speed * kRightMotorPolarity);
+  if (current == target)
+  {
+    return current;
+  }
+
+  const bool speeding_up = (current >= 0 && target > current) ||
+                           (current <= 0 && target < current);
+  const int step = speeding_up ? accel_step : decel_step;
+  int next = (target > current) ? min(current + step, target)
+                                : max(current - step, target);
+
+  // A reversal stops at zero first so the accel limit governs the new direction.
+  if ((current > 0 && next < 0) || (current < 0 && next > 0))
+  {
+    next = 0;
+  }
+  return next;
+}
+
+void write_wheels(int left_speed, int right_speed)
+{
+  set_motor(kLeftMotor, left_speed);
+  set_motor(kRightMotor, right_speed);
 
   if (left_speed == 0 && right_speed == 0)
   {
@@ -60,14 +203,144 @@ void drive(int left_speed, int right_speed)
   }
 }
 
+} // namespace
+
+void set_pwm_targets(int left_speed, int right_speed)
+{
+  motion_profile.target_left = constrain(left_speed, -255, 255);
+  motion_profile.target_right = constrain(right_speed, -255, 255);
+}
+
+void drive(int left_speed, int right_speed)
+{
+  speed_targets.active = false;
+  set_pwm_targets(left_speed, right_speed);
+}
+
+int mmps_to_pwm(MotorSide side, int mmps)
+{
+  const SpeedMapPoint *map = (side == kLeftMotor) ? kLeftSpeedMap : kRightSpeedMap;
+  const size_t count = (side == kLeftMotor)
+                           ? sizeof(kLeftSpeedMap) / sizeof(kLeftSpeedMap[0])
+                           : sizeof(kRightSpeedMap) / sizeof(kRightSpeedMap[0]);
+  const int magnitude = abs(mmps);
+  if (magnitude == 0)
+  {
+    return 0;
+  }
+
+  int pwm = map[count - 1].pwm;
+  for (size_t i = 1; i < count; ++i)
+  {
+    if (magnitude <= map[i].mmps)
+    {
+      const int span_mmps = map[i].mmps - map[i - 1].mmps;
+      const int span_pwm = map[i].pwm - map[i - 1].pwm;
+      pwm = map[i - 1].pwm +
+            (span_mmps > 0 ? (magnitude - map[i - 1].mmps) * span_pwm / span_mmps : 0);
+      break;
+    }
+  }
+  return mmps < 0 ? -pwm : pwm;
+}
+
+void drive_mmps(int left_mmps, int right_mmps)
+{
+#ifdef BOT_HAS_ENCODERS
+  if (!speed_targets.active)
+  {
+    reset_pid();
+  }
+#endif
+  speed_targets.active = true;
+  speed_targets.left_mmps = left_mmps;
+  speed_targets.right_mmps = right_mmps;
+
+  // Feed-forward now; with encoders the PID trims it on the next sample.
+  set_pwm_targets(mmps_to_pwm(kLeftMotor, left_mmps),
+                  mmps_to_pwm(kRightMotor, right_mmps));
+}
+
+void update_speed_control()
+{
+#ifdef BOT_HAS_ENCODERS
+  if (speed_targets.active)
+  {
+    update_pid(speed_targets.left_mmps, speed_targets.right_mmps);
+  }
+#endif
+}
+
+void drive_immediate(int left_speed, int right_speed)
+{
+  drive(left_speed, right_speed);
+  motion_profile.current_left = motion_profile.target_left;
+  motion_profile.current_right = motion_profile.target_right;
+  motion_profile.last_update_ms = millis();
+  write_wheels(motion_profile.current_left, motion_profile.current_right);
+}
+
+void update_motion_profile()
+{
+  const unsigned long now = millis();
+  const unsigned long elapsed_ms = now - motion_profile.last_update_ms;
+  if (elapsed_ms < kMotionProfileTickMs)
+  {
+    return;
+  }
+  motion_profile.last_update_ms = now;
+
+  // Cap the step after a long blocking call so it cannot turn into a jump.
+  const unsigned long dt_ms = min(elapsed_ms, 5 * kMotionProfileTickMs);
+  const int accel_step = static_cast<int>(kMotorAccelPwmPerS * dt_ms / 1000UL);
+  const int decel_step = static_cast<int>(kMotorDecelPwmPerS * dt_ms / 1000UL);
+
+  const int left = ramp_toward(motion_profile.current_left,
+                               motion_profile.target_left,
+                               accel_step,
+                               decel_step);
+  const int right = ramp_toward(motion_profile.current_right,
+                                motion_profile.target_right,
+                                accel_step,
+                                decel_step);
+  if (left == motion_profile.current_left && right == motion_profile.current_right)
+  {
+    return;
+  }
+
+  motion_profile.current_left = left;
+  motion_profile.current_right = right;
+  write_wheels(left, right);
+}
+
+void hold_drive(unsigned long duration_ms)
+{
+  const unsigned long start = millis();
+  while (millis() - start < duration_ms)
+  {
+    update_motion_profile();
+    delay(kMotionProfileTickMs);
+  }
+}
+
+// With encoders, straight-line teleop runs closed-loop so the two TT motors
+// track each other without per-wheel trim.
 void forward()
 {
+#ifdef BOT_HAS_ENCODERS
+  drive_mmps(kDriveSpeedMmps, kDriveSpeedMmps);
+#else
   drive(kDriveSpeed, kDriveSpeed);
+#endif
 }
 
 void backward()
 {
+#ifdef BOT_HAS_ENCODERS
+  drive_mmps(-kDriveSpeedMmps, -kDriveSpeedMmps);
+#else
   drive(-kDriveSpeed, -kDriveSpeed);
+#endif
 }
 
 void reverse_short()
@@ -97,7 +370,8 @@ void spin_right()
 
 void stop_drive()
 {
-  drive(0, 0);
+  // Stops are emergency paths: cut both wheels now instead of ramping.
+  drive_immediate(0, 0);
 }
 
 void control_motor(char cmd)
@@ -136,25 +410,131 @@ void apply_motor_cmd(char motor, char dir, uint8_t pwm)
                                  : (dir == 'b') ? -static_cast<int>(pwm) : 0;
   if (motor == 'L')
   {
-    set_motor(kLeftPwmPin, kLeftMotorIn1Pin, kLeftMotorIn2Pin, speed * kLeftMotorPolarity);
+    drive(speed, motion_profile.target_right);
   }
   else
   {
-    set_motor(kRightPwmPin, kRightMotorIn1Pin, kRightMotorIn2Pin, speed * kRightMotorPolarity);
+    drive(motion_profile.target_left, speed);
   }
 
   trigger_activity();
   Serial.printf("Motor %c: %c PWM %u\n", motor, dir, static_cast<unsigned>(pwm));
 }
 
+bool set_pwm_mode(uint8_t index)
+{
+  if (index >= kPwmModeCount)
+  {
+    return false;
+  }
+
+  pwm_mode_index = index;
+  attach_motor_pwm();
+  write_wheels(motion_profile.current_left, motion_profile.current_right);
+  return true;
+}
+
+void set_decay_mode(DecayMode new_mode)
+{
+  decay_mode = new_mode;
+  attach_motor_pwm();
+  write_wheels(motion_profile.current_left, motion_profile.current_right);
+}
+
+void print_motor_status()
+{
+  Serial.printf("Motor decay=%s current=%d,%d target=%d,%d writes=%lu skipped=%lu\n",
+                decay_mode == kFastDecay ? "fast" : "slow",
+                motion_profile.current_left,
+                motion_profile.current_right,
+                motion_profile.target_left,
+                motion_profile.target_right,
+                static_cast<unsigned long>(output_writes),
+                static_cast<unsigned long>(output_writes_skipped));
+  Serial.printf("Drive cmd seq=%u accepted=%lu stale=%lu expired=%lu remote_dropped=%lu\n",
+                static_cast<unsigned>(drive_command.last_seq),
+                static_cast<unsigned long>(drive_command.accepted),
+                static_cast<unsigned long>(drive_command.stale),
+                static_cast<unsigned long>(drive_command.expired),
+                static_cast<unsigned long>(remote_commands.dropped));
+  for (uint8_t i = 0; i < kPwmModeCount; ++i)
+  {
+    Serial.printf("  %c lf%u: %lu Hz %u-bit min_duty=%u/%u permille\n",
+                  i == pwm_mode_index ? '*' : ' ',
+                  static_cast<unsigned>(i),
+                  static_cast<unsigned long>(kPwmModes[i].freq_hz),
+                  static_cast<unsigned>(kPwmModes[i].bits),
+                  static_cast<unsigned>(kPwmModes[i].left_min_permille),
+                  static_cast<unsigned>(kPwmModes[i].right_min_permille));
+  }
+}
+
+// Bench test for a bot on a stand: runs both wheels at a fixed PWM in every
+// LEDC mode and reports velocity ripple (stddev / mean of per-window encoder
+// ticks) when encoders are fitted. Blocks for a few seconds.
+void run_pwm_bench(int pwm)
+{
+  if (mode != 'x')
+  {
+    Serial.println("PWM bench: switch to x (stopped) first");
+    return;
+  }
+
+  const uint8_t saved_mode = pwm_mode_index;
+  for (uint8_t i = 0; i < kPwmModeCount; ++i)
+  {
+    set_pwm_mode(i);
+    drive_immediate(pwm, pwm);
+    delay(kBenchSettleMs);
+
+#ifdef BOT_HAS_ENCODERS
+    float sum[2] = {0.0f, 0.0f};
+    float sum_sq[2] = {0.0f, 0.0f};
+    long last_ticks[2] = {get_left_ticks(), get_right_ticks()};
+    for (uint8_t sample = 0; sample < kBenchSamples; ++sample)
+    {
+      delay(kBenchSampleMs);
+      const long ticks[2] = {get_left_ticks(), get_right_ticks()};
+      for (uint8_t side = 0; side < 2; ++side)
+      {
+        const float delta = static_cast<float>(labs(ticks[side] - last_ticks[side]));
+        sum[side] += delta;
+        sum_sq[side] += delta * delta;
+        last_ticks[side] = ticks[side];
+      }
+    }
+
+    float ripple_pct[2] = {0.0f, 0.0f};
+    for (uint8_t side = 0; side < 2; ++side)
+    {
+      const float mean = sum[side] / kBenchSamples;
+      const float variance = sum_sq[side] / kBenchSamples - mean * mean;
+      ripple_pct[side] = mean > 0.0f ? 100.0f * sqrtf(max(variance, 0.0f)) / mean : 0.0f;
+    }
+    Serial.printf("PWM bench lf%u %lu Hz: left %.1f ticks/%lums ripple %.1f%%, right %.1f ticks/%lums ripple %.1f%%\n",
+                  static_cast<unsigned>(i),
+                  static_cast<unsigned long>(kPwmModes[i].freq_hz),
+                  sum[0] / kBenchSamples,
+                  kBenchSampleMs,
+                  ripple_pct[0],
+                  sum[1] / kBenchSamples,
+                  kBenchSampleMs,
+                  ripple_pct[1]);
+#else
+    delay(kBenchSampleMs * kBenchSamples);
+    Serial.printf("PWM bench lf%u %lu Hz: no encoders, listen/observe only\n",
+                  static_cast<unsigned>(i),
+                  static_cast<unsigned long>(kPwmModes[i].freq_hz));
+#endif
+  }
+
+  stop_drive();
+  set_pwm_mode(saved_mode);
+}
+
 void setup_motor()
 {
-  ledcAttach(kLeftPwmPin, kLedcFreqHz, kLedcBits);
-  ledcAttach(kRightPwmPin, kLedcFreqHz, kLedcBits);
-  pinMode(kLeftMotorIn1Pin, OUTPUT);
-  pinMode(kLeftMotorIn2Pin, OUTPUT);
-  pinMode(kRightMotorIn1Pin, OUTPUT);
-  pinMode(kRightMotorIn2Pin, OUTPUT);
+  attach_motor_pwm();
   if (kMotorStandbyPin >= 0)
   {
     pinMode(kMotorStandbyPin, OUTPUT);
@@ -179,7 +559,11 @@ void setup_motor()
   {
     Serial.println("  STBY tied high on driver board");
   }
-  Serial.println("  1=manual  4=basic wander  x=stop");
+  Serial.printf("  PWM %lu Hz %u-bit, %s decay\n",
+                static_cast<unsigned long>(kPwmModes[pwm_mode_index].freq_hz),
+                static_cast<unsigned>(kPwmModes[pwm_mode_index].bits),
+                decay_mode == kFastDecay ? "fast" : "slow");
+  Serial.println("  1=manual  4=basic wander  5=planner  x=stop");
 }
 
 } // namespace bot
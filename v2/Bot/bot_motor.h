@@ -2,11 +2,21 @@
 
 #include <Arduino.h>
 
+#include "bot_config.h"
+
 namespace bot {
 
+// Loop task only: the output cache in bot_motor.cpp is not locked.
 void enable_motor_driver(bool enabled);
-void set_motor(int pwm_pin, int in1_pin, int in2_pin, int speed);
+void set_motor(MotorSide side, int speed);
+void set_pwm_targets(int left_speed, int right_speed);
 void drive(int left_speed, int right_speed);
+int mmps_to_pwm(MotorSide side, int mmps);
+void drive_mmps(int left_mmps, int right_mmps);
+void update_speed_control();
+void drive_immediate(int left_speed, int right_speed);
+void update_motion_profile();
+void hold_drive(unsigned long duration_ms);
 void forward();
 void backward();
 void reverse_short();
@@ -17,6 +27,10 @@ void spin_right();
 void stop_drive();
 void control_motor(char cmd);
 void apply_motor_cmd(char motor, char dir, uint8_t pwm);
+bool set_pwm_mode(uint8_t index);
+void set_decay_mode(DecayMode new_mode);
+void print_motor_status();
+void run_pwm_bench(int pwm);
 void setup_motor();
 
 } // namespace bot
@@ -0,0 +1,155 @@
+#include "bot_odometry.h"
+
+#ifdef BOT_HAS_ENCODERS
+
+#include <math.h>
+#include "bot_config.h"
+#include "bot_encoder.h"
+
+namespace bot {
+namespace {
+
+constexpr float kWheelbaseM = kWheelbaseMm / 1000.0f;
+
+OdometryPose pose;
+long last_left_ticks = 0;
+long last_right_ticks = 0;
+unsigned long last_update_ms = 0;
+
+float wrap_angle(float angle)
+{
+  while (angle > (float)M_PI)
+  {
+    angle -= 2.0f * (float)M_PI;
+  }
+  while (angle <= -(float)M_PI)
+  {
+    angle += 2.0f * (float)M_PI;
+  }
+  return angle;
+}
+
+// cov = Fp * cov * Fp^T + Fw * diag(var_r, var_l) * Fw^T
+void propagate_covariance(float ds, float heading_mid, float var_r, float var_l)
+{
+  const float c = cosf(heading_mid);
+  const float s = sinf(heading_mid);
+
+  const float fp[3][3] = {
+      {1.0f, 0.0f, -ds * s},
+      {0.0f, 1.0f, ds * c},
+      {0.0f, 0.0f, 1.0f},
+  };
+  const float half_ratio = ds / (2.0f * kWheelbaseM);
+  const float fw[3][2] = {
+      {0.5f * c - half_ratio * s, 0.5f * c + half_ratio * s},
+      {0.5f * s + half_ratio * c, 0.5f * s - half_ratio * c},
+      {1.0f / kWheelbaseM, -1.0f / kWheelbaseM},
+  };
+
+  float tmp[3][3]{};
+  for (uint8_t i = 0; i < 3; ++i)
+  {
+    for (uint8_t j = 0; j < 3; ++j)
+    {
+      for (uint8_t k = 0; k < 3; ++k)
+      {
+        tmp[i][j] += fp[i][k] * pose.cov[k][j];
+      }
+    }
+  }
+
+  float next[3][3]{};
+  for (uint8_t i = 0; i < 3; ++i)
+  {
+    for (uint8_t j = 0; j < 3; ++j)
+    {
+      for (uint8_t k = 0; k < 3; ++k)
+      {
+        next[i][j] += tmp[i][k] * fp[j][k];
+      }
+      next[i][j] += fw[i][0] * var_r * fw[j][0] + fw[i][1] * var_l * fw[j][1];
+    }
+  }
+
+  memcpy(pose.cov, next, sizeof(pose.cov));
+}
+
+} // namespace
+
+void reset_pose()
+{
+  pose = OdometryPose{};
+  last_left_ticks = get_left_ticks();
+  last_right_ticks = get_right_ticks();
+}
+
+void update_odometry()
+{
+  const unsigned long now = millis();
+  if (now - last_update_ms < kOdometryIntervalMs)
+  {
+    return;
+  }
+  last_update_ms = now;
+
+  const long left_ticks = get_left_ticks();
+  const long right_ticks = get_right_ticks();
+  const float m_per_tick = get_meters_per_tick();
+  float dl = (left_ticks - last_left_ticks) * m_per_tick;
+  float dr = (right_ticks - last_right_ticks) * m_per_tick;
+  last_left_ticks = left_ticks;
+  last_right_ticks = right_ticks;
+
+  // Single-channel encoders count up in both directions; sign by wheel speed.
+  // Quadrature deltas are already signed, and the lagging speed window would
+  // flip them wrongly while a wheel reverses.
+  if (!get_ticks_signed())
+  {
+    if (get_left_speed_mps() < 0.0f && dl > 0.0f)
+    {
+      dl = -dl;
+    }
+    if (get_right_speed_mps() < 0.0f && dr > 0.0f)
+    {
+      dr = -dr;
+    }
+  }
+  if (dl == 0.0f && dr == 0.0f)
+  {
+    return;
+  }
+
+  const float ds = 0.5f * (dr + dl);
+  const float dtheta = (dr - dl) / kWheelbaseM;
+  const float heading_mid = pose.theta_rad + 0.5f * dtheta;
+
+  if (fabsf(dtheta) < 1.0e-6f)
+  {
+    pose.x_m += ds * cosf(heading_mid);
+    pose.y_m += ds * sinf(heading_mid);
+  }
+  else
+  {
+    // Exact integration along the circular arc of radius ds / dtheta.
+    const float radius = ds / dtheta;
+    const float heading_end = pose.theta_rad + dtheta;
+    pose.x_m += radius * (sinf(heading_end) - sinf(pose.theta_rad));
+    pose.y_m -= radius * (cosf(heading_end) - cosf(pose.theta_rad));
+  }
+
+  propagate_covariance(ds,
+                       heading_mid,
+                       kOdomSlipVarPerM * fabsf(dr),
+                       kOdomSlipVarPerM * fabsf(dl));
+  pose.theta_rad = wrap_angle(pose.theta_rad + dtheta);
+}
+
+const OdometryPose &get_pose()
+{
+  return pose;
+}
+
+} // namespace bot
+
+#endif // BOT_HAS_ENCODERS
@@ -0,0 +1,32 @@
+#pragma once
+
+// Optional: differential-drive odometry (requires BOT_HAS_ENCODERS)
+//
+// Integrates left/right encoder tick deltas into a pose (x, y, theta) in the
+// frame the bot started in: +x forward, +y left, theta counter-clockwise.
+// Each step uses the exact arc for constant wheel speeds and grows a 3x3
+// covariance from a wheel-slip error model.
+
+#include "bot_config.h"  // defines BOT_HAS_ENCODERS
+
+#ifdef BOT_HAS_ENCODERS
+
+#include <Arduino.h>
+
+namespace bot {
+
+struct OdometryPose
+{
+  float x_m = 0.0f;
+  float y_m = 0.0f;
+  float theta_rad = 0.0f;
+  float cov[3][3]{};        // x, y, theta
+};
+
+void reset_pose();
+void update_odometry();     // call every loop; integrates at kOdometryIntervalMs
+const OdometryPose &get_pose();
+
+} // namespace bot
+
+#endif // BOT_HAS_ENCODERS
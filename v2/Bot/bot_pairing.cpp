@@ -0,0 +1,270 @@
+#include "bot_pairing.h"
+
+#include <Preferences.h>
+#include <esp_now.h>
+#include <string.h>
+
+#include "bot_config.h"
+#include "bot_radio.h"
+#include "bot_state.h"
+
+namespace bot {
+namespace {
+
+static_assert(kPeerCacheSize >= 2, "the controller and a candidate need a peer each");
+
+portMUX_TYPE pair_mux = portMUX_INITIALIZER_UNLOCKED;
+Preferences pair_store;
+
+// The controller kept in NVS. Only loop() writes it.
+uint8_t stored_controller[6]{};
+bool have_stored_controller = false;
+
+// Peers added to ESP-NOW, oldest first. Only loop() touches these, so the
+// receive callback never adds or deletes a peer.
+uint8_t peer_cache[kPeerCacheSize][6];
+uint8_t peer_cache_count = 0;
+
+bool same_mac(const uint8_t *a, const uint8_t *b)
+{
+  return memcmp(a, b, 6) == 0;
+}
+
+void print_mac(const char *label, const uint8_t *mac)
+{
+  Serial.printf("%s %02X:%02X:%02X:%02X:%02X:%02X\n",
+                label, mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+}
+
+// Makes mac an ESP-NOW peer. A full cache gives up its oldest entry that is
+// not the current controller.
+bool ensure_peer(const uint8_t *mac)
+{
+  for (uint8_t i = 0; i < peer_cache_count; ++i)
+  {
+    if (same_mac(peer_cache[i], mac))
+    {
+      return true;
+    }
+  }
+
+  if (peer_cache_count == kPeerCacheSize)
+  {
+    const uint8_t victim =
+        (controller_peer_known && same_mac(peer_cache[0], controller_peer_addr)) ? 1 : 0;
+    esp_now_del_peer(peer_cache[victim]);
+    memmove(peer_cache[victim], peer_cache[victim + 1], (peer_cache_count - victim - 1) * 6);
+    --peer_cache_count;
+  }
+
+  esp_now_peer_info_t peer = {};
+  memcpy(peer.peer_addr, mac, sizeof(peer.peer_addr));
+  peer.channel = 0;
+  peer.encrypt = false;
+  if (esp_now_add_peer(&peer) != ESP_OK)
+  {
+    return false;
+  }
+  memcpy(peer_cache[peer_cache_count++], mac, 6);
+  return true;
+}
+
+// Called with pair_mux held.
+void request_pairing(const uint8_t *mac)
+{
+  if (!pairing.request_pending)
+  {
+    memcpy(pairing.candidate, mac, sizeof(pairing.candidate));
+    pairing.request_pending = true;
+  }
+}
+
+// Makes mac the radio's destination. Commands from it are taken at once if
+// it is the stored controller, otherwise only after it accepts us.
+void switch_controller(const uint8_t *mac)
+{
+  portENTER_CRITICAL(&pair_mux);
+  memcpy(controller_peer_addr, mac, sizeof(controller_peer_addr));
+  controller_peer_known = true;
+  pairing.paired = have_stored_controller && same_mac(mac, stored_controller);
+  pairing.accepted = false;
+  pairing.last_controller_rx_ms = millis();
+  portEXIT_CRITICAL(&pair_mux);
+}
+
+void send_pair_request()
+{
+  const PairRequest request{kTelemetryMagic, kPairingVersion, kTelemetryTypePairRequest};
+  radio_send(reinterpret_cast<const uint8_t *>(&request), sizeof(request), kTxControl);
+  ++pairing.requests;
+}
+
+} // namespace
+
+void setup_pairing()
+{
+  pair_store.begin("pairing", false);
+  have_stored_controller =
+      pair_store.getBytes("ctrl", stored_controller, sizeof(stored_controller)) == sizeof(stored_controller);
+  if (!have_stored_controller)
+  {
+    Serial.println("Not paired, waiting for a controller beacon");
+    return;
+  }
+
+  print_mac("Paired controller", stored_controller);
+  if (ensure_peer(stored_controller))
+  {
+    switch_controller(stored_controller);
+  }
+}
+
+bool pairing_on_recv(const uint8_t *mac, const uint8_t *data, int len)
+{
+  const unsigned long now = millis();
+  const bool pairing_packet =
+      len >= 3 && data[0] == kTelemetryMagic && data[1] == kPairingVersion;
+
+  portENTER_CRITICAL(&pair_mux);
+  const bool from_controller = controller_peer_known && same_mac(mac, controller_peer_addr);
+  if (from_controller && pairing.paired)
+  {
+    pairing.last_controller_rx_ms = now;
+  }
+
+  if (pairing_packet && data[2] == kTelemetryTypeBeacon && len == static_cast<int>(sizeof(PairBeacon)))
+  {
+    const bool open = data[3] != 0;
+    const bool lost = !pairing.paired || now - pairing.last_controller_rx_ms > kControllerLostMs;
+    if ((from_controller && pairing.paired) || (have_stored_controller && same_mac(mac, stored_controller)))
+    {
+      // Our controller: ask once per boot so it confirms our id, or takes us
+      // back if it was unpaired from us.
+      if (!pairing.accepted)
+      {
+        request_pairing(mac);
+      }
+    }
+    else if (open && lost)
+    {
+      request_pairing(mac);
+    }
+    portEXIT_CRITICAL(&pair_mux);
+    return false;
+  }
+
+  if (pairing_packet && data[2] == kTelemetryTypePairAccept && len == static_cast<int>(sizeof(PairAccept)))
+  {
+    if (from_controller)
+    {
+      pairing.accept_pending = true;
+      pairing.accepted_bot = data[3];
+    }
+    portEXIT_CRITICAL(&pair_mux);
+    return false;
+  }
+
+  const bool take = from_controller && pairing.paired;
+  portEXIT_CRITICAL(&pair_mux);
+  return take;
+}
+
+void update_pairing()
+{
+  uint8_t candidate[6];
+  bool request = false;
+  bool accept = false;
+  uint8_t bot_id = 0;
+
+  portENTER_CRITICAL(&pair_mux);
+  if (pairing.request_pending)
+  {
+    request = true;
+    memcpy(candidate, pairing.candidate, sizeof(candidate));
+    pairing.request_pending = false;
+  }
+  if (pairing.accept_pending)
+  {
+    accept = true;
+    bot_id = pairing.accepted_bot;
+    pairing.accept_pending = false;
+  }
+  portEXIT_CRITICAL(&pair_mux);
+
+  if (accept)
+  {
+    portENTER_CRITICAL(&pair_mux);
+    pairing.paired = true;
+    pairing.accepted = true;
+    pairing.bot_id = bot_id;
+    pairing.last_controller_rx_ms = millis();
+    portEXIT_CRITICAL(&pair_mux);
+
+    if (!have_stored_controller || !same_mac(stored_controller, controller_peer_addr))
+    {
+      memcpy(stored_controller, controller_peer_addr, sizeof(stored_controller));
+      have_stored_controller = true;
+      pair_store.putBytes("ctrl", stored_controller, sizeof(stored_controller));
+    }
+    Serial.printf("Paired as bot %u\n", static_cast<unsigned>(bot_id));
+    print_mac("Controller", controller_peer_addr);
+  }
+
+  if (request)
+  {
+    if (!controller_peer_known || !same_mac(candidate, controller_peer_addr))
+    {
+      if (!ensure_peer(candidate))
+      {
+        return;
+      }
+      switch_controller(candidate);
+      print_mac("Pairing with", candidate);
+    }
+    send_pair_request();
+  }
+}
+
+void forget_controller()
+{
+  pair_store.remove("ctrl");
+  have_stored_controller = false;
+
+  // Stop sending telemetry to the old controller as well.
+  portENTER_CRITICAL(&pair_mux);
+  pairing.paired = false;
+  pairing.accepted = false;
+  pairing.request_pending = false;
+  pairing.accept_pending = false;
+  controller_peer_known = false;
+  memset(controller_peer_addr, 0, sizeof(controller_peer_addr));
+  portEXIT_CRITICAL(&pair_mux);
+
+  for (uint8_t i = 0; i < peer_cache_count; ++i)
+  {
+    esp_now_del_peer(peer_cache[i]);
+  }
+  peer_cache_count = 0;
+  Serial.println("Controller forgotten, waiting for an open beacon");
+}
+
+void print_pairing_status()
+{
+  if (controller_peer_known)
+  {
+    print_mac("Controller", controller_peer_addr);
+  }
+  else
+  {
+    Serial.println("Controller not seen yet");
+  }
+  Serial.printf("Pairing paired=%d accepted=%d stored=%d bot=%u requests=%lu peers=%u\n",
+                pairing.paired ? 1 : 0,
+                pairing.accepted ? 1 : 0,
+                have_stored_controller ? 1 : 0,
+                static_cast<unsigned>(pairing.bot_id),
+                static_cast<unsigned long>(pairing.requests),
+                static_cast<unsigned>(peer_cache_count));
+}
+
+} // namespace bot
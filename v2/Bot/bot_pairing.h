@@ -0,0 +1,20 @@
+#pragma once
+
+#include <Arduino.h>
+
+namespace bot {
+
+// Loads the stored controller from NVS and makes it the radio's peer. Call
+// once ESP-NOW is up.
+void setup_pairing();
+// Receive callback side. Notes beacons and pair accepts for update_pairing()
+// and returns true if the packet came from the paired controller and should
+// be handled. Never touches the ESP-NOW peer list.
+bool pairing_on_recv(const uint8_t *mac, const uint8_t *data, int len);
+// Adds peers, sends pair requests and stores a new controller. Call every loop.
+void update_pairing();
+// Drops the stored controller; the bot pairs with the next open beacon.
+void forget_controller();
+void print_pairing_status();
+
+} // namespace bot
@@ -0,0 +1,75 @@
+#pragma once
+
+// Wheel speed PID for bot_encoder.cpp: feed-forward from the PWM -> speed map
+// plus a PID trim, derivative on measurement, and an integral that stops
+// while the output is pinned in the direction of the error.
+// Header-only with no Arduino dependencies so it can be compiled on a host.
+
+namespace bot {
+namespace pid {
+
+struct Gains
+{
+  float kp;                  // PWM per mm/s of error
+  float ki;                  // PWM per mm of accumulated error
+  float kd;                  // PWM per mm/s^2
+  float integral_limit_pwm;  // anti-windup clamp
+  float dt_s;                // time between steps
+};
+
+struct WheelPid
+{
+  float integral = 0.0f;
+  float last_measured = 0.0f;
+};
+
+inline float clamp(float value, float lo, float hi)
+{
+  return value < lo ? lo : (value > hi ? hi : value);
+}
+
+inline void reset(WheelPid &state, float measured_mmps)
+{
+  state.integral = 0.0f;
+  state.last_measured = measured_mmps;
+}
+
+// Returns the PWM for one wheel. feed_forward_pwm is the open-loop PWM for
+// target_mmps.
+inline int step(WheelPid &state,
+                const Gains &gains,
+                int target_mmps,
+                float measured_mmps,
+                float feed_forward_pwm)
+{
+  if (target_mmps == 0)
+  {
+    reset(state, measured_mmps);
+    return 0;
+  }
+
+  const float error = target_mmps - measured_mmps;
+  // Derivative on measurement so setpoint steps do not kick the output.
+  const float derivative = -(measured_mmps - state.last_measured) / gains.dt_s;
+  state.last_measured = measured_mmps;
+
+  const float unclamped =
+      feed_forward_pwm + gains.kp * error + state.integral + gains.kd * derivative;
+
+  // Anti-windup: stop integrating while the output is pinned in the same
+  // direction as the error, and bound the integral term regardless.
+  const bool saturated = (unclamped >= 255.0f && error > 0.0f) ||
+                         (unclamped <= -255.0f && error < 0.0f);
+  if (!saturated)
+  {
+    state.integral = clamp(state.integral + gains.ki * error * gains.dt_s,
+                           -gains.integral_limit_pwm,
+                           gains.integral_limit_pwm);
+  }
+
+  const float output = feed_forward_pwm + gains.kp * error + state.integral + gains.kd * derivative;
+  return static_cast<int>(clamp(output, -255.0f, 255.0f));
+}
+
+} // namespace pid
+} // namespace bot
@@ -0,0 +1,54 @@
+#include "bot_planner.h"
+
+#include "bot_dwa.h"
+#include "bot_state.h"
+
+namespace bot {
+
+void reset_planner_state()
+{
+  planner_state.last_plan_ms = 0;
+  planner_state.cmd_left = 0;
+  planner_state.cmd_right = 0;
+}
+
+void update_planner_histogram(const lidar::ScanFrame &scan)
+{
+  dwa::build_sectors(scan, planner_state.sectors);
+}
+
+bool plan_dynamic_window(int current_left,
+                         int current_right,
+                         int &left_pwm,
+                         int &right_pwm)
+{
+  const unsigned long start_us = micros();
+  const bool planned = dwa::plan_dynamic_window(
+      planner_state.sectors, current_left, current_right, left_pwm, right_pwm);
+
+  const uint32_t elapsed_us = micros() - start_us;
+  planner_state.last_plan_us = elapsed_us;
+  if (elapsed_us > planner_state.max_plan_us)
+  {
+    planner_state.max_plan_us = elapsed_us;
+  }
+  ++planner_state.plans;
+  if (!planned)
+  {
+    ++planner_state.blocked_plans;
+  }
+  return planned;
+}
+
+void print_planner_status()
+{
+  Serial.printf("Planner plans=%lu blocked=%lu last_us=%lu max_us=%lu cmd=%d,%d\n",
+                static_cast<unsigned long>(planner_state.plans),
+                static_cast<unsigned long>(planner_state.blocked_plans),
+                static_cast<unsigned long>(planner_state.last_plan_us),
+                static_cast<unsigned long>(planner_state.max_plan_us),
+                planner_state.cmd_left,
+                planner_state.cmd_right);
+}
+
+} // namespace bot
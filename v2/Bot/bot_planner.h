@@ -0,0 +1,18 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "LD06_LiDAR.h"
+#include "bot_config.h"
+
+namespace bot {
+
+void reset_planner_state();
+void update_planner_histogram(const lidar::ScanFrame &scan);
+bool plan_dynamic_window(int current_left,
+                         int current_right,
+                         int &left_pwm,
+                         int &right_pwm);
+void print_planner_status();
+
+} // namespace bot
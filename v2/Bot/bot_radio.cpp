@@ -0,0 +1,358 @@
+#include "bot_radio.h"
+
+#include <esp_now.h>
+#include <string.h>
+
+#include "bot_state.h"
+
+namespace bot {
+namespace {
+
+struct TxSlot
+{
+  uint8_t data[kTelemetryMaxPacketBytes];
+  uint8_t len;
+  uint8_t type;
+  uint8_t priority;   // TxPriority
+  uint16_t frame_id;  // scan chunks only
+  uint8_t retries;
+  bool used;
+  uint32_t seq;       // send order, oldest first
+};
+
+// Slots are shared with the send callback, which runs on the WiFi task.
+// Everything below is guarded by tx_mux, except the data of the slot on the
+// air, which nothing else touches until its callback frees it.
+//
+// A send that times out frees its slot but keeps the radio busy (abandoned)
+// until its late callback turns up, or kTxCallbackLostMs passes, so that
+// callback is never credited to the next frame. tx_busy_seq tags the frame
+// on the air; a callback is only applied to a slot that still carries it.
+portMUX_TYPE tx_mux = portMUX_INITIALIZER_UNLOCKED;
+TxSlot tx_slots[kTxQueueSlots]{};
+uint32_t tx_next_seq = 0;
+bool tx_busy = false;
+bool tx_abandoned = false;
+uint8_t tx_busy_slot = 0;
+uint32_t tx_busy_seq = 0;
+uint32_t tx_sent_us = 0;
+
+bool in_flight(uint8_t index)
+{
+  return tx_busy && !tx_abandoned && tx_busy_slot == index && tx_slots[index].seq == tx_busy_seq;
+}
+
+uint16_t scan_frame_id(const uint8_t *data)
+{
+  ScanChunkHeader header;
+  memcpy(&header, data, sizeof(header));
+  return header.frame_id;
+}
+
+bool queued(uint8_t index)
+{
+  return tx_slots[index].used && !in_flight(index);
+}
+
+uint8_t queue_depth()
+{
+  uint8_t depth = 0;
+  for (uint8_t i = 0; i < kTxQueueSlots; ++i)
+  {
+    depth += tx_slots[i].used ? 1 : 0;
+  }
+  return depth;
+}
+
+// Call with tx_mux held. EWMA with a 1/8 weight; success_q8 is 256 at 100%.
+void note_delivery(bool delivered)
+{
+  if (delivered)
+  {
+    ++link_stats.delivered;
+    link_stats.success_q8 += (256 - link_stats.success_q8) >> 3;
+  }
+  else
+  {
+    ++link_stats.failed;
+    link_stats.success_q8 -= link_stats.success_q8 >> 3;
+  }
+}
+
+// Finds the slot for a new packet, evicting whatever it supersedes. Call
+// with tx_mux held. Returns kTxQueueSlots if the queue is full.
+uint8_t claim_slot(uint8_t type, uint16_t frame_id)
+{
+  uint8_t free_slot = kTxQueueSlots;
+  uint8_t reuse_slot = kTxQueueSlots;
+
+  for (uint8_t i = 0; i < kTxQueueSlots; ++i)
+  {
+    if (!tx_slots[i].used)
+    {
+      free_slot = free_slot == kTxQueueSlots ? i : free_slot;
+      continue;
+    }
+    if (!queued(i) || tx_slots[i].type != type)
+    {
+      continue;
+    }
+
+    if (type == kTelemetryTypeScanChunk)
+    {
+      // A partial old frame is useless once a new one is coming.
+      if (tx_slots[i].frame_id != frame_id)
+      {
+        tx_slots[i].used = false;
+        ++link_stats.superseded;
+        free_slot = free_slot == kTxQueueSlots ? i : free_slot;
+      }
+    }
+    else if (tx_slots[i].priority == kTxState && reuse_slot == kTxQueueSlots)
+    {
+      // Newer state replaces older state in place, keeping its turn.
+      reuse_slot = i;
+      ++link_stats.superseded;
+    }
+  }
+
+  return reuse_slot != kTxQueueSlots ? reuse_slot : free_slot;
+}
+
+// Drops the newest queued bulk frame to make room. Call with tx_mux held.
+uint8_t evict_bulk()
+{
+  uint8_t pick = kTxQueueSlots;
+  for (uint8_t i = 0; i < kTxQueueSlots; ++i)
+  {
+    if (queued(i) && tx_slots[i].priority == kTxBulk &&
+        (pick == kTxQueueSlots || static_cast<int32_t>(tx_slots[i].seq - tx_slots[pick].seq) > 0))
+    {
+      pick = i;
+    }
+  }
+  if (pick != kTxQueueSlots)
+  {
+    tx_slots[pick].used = false;
+    ++link_stats.overflow;
+  }
+  return pick;
+}
+
+void send_next()
+{
+  uint8_t pick = kTxQueueSlots;
+
+  portENTER_CRITICAL(&tx_mux);
+  if (!tx_busy)
+  {
+    for (uint8_t i = 0; i < kTxQueueSlots; ++i)
+    {
+      if (!tx_slots[i].used)
+      {
+        continue;
+      }
+      if (pick == kTxQueueSlots ||
+          tx_slots[i].priority < tx_slots[pick].priority ||
+          (tx_slots[i].priority == tx_slots[pick].priority &&
+           static_cast<int32_t>(tx_slots[i].seq - tx_slots[pick].seq) < 0))
+      {
+        pick = i;
+      }
+    }
+    if (pick != kTxQueueSlots)
+    {
+      tx_busy = true;
+      tx_abandoned = false;
+      tx_busy_slot = pick;
+      tx_busy_seq = tx_slots[pick].seq;
+      tx_sent_us = micros();
+    }
+  }
+  portEXIT_CRITICAL(&tx_mux);
+
+  if (pick == kTxQueueSlots)
+  {
+    return;
+  }
+
+  const esp_err_t err = esp_now_send(controller_peer_addr, tx_slots[pick].data, tx_slots[pick].len);
+
+  portENTER_CRITICAL(&tx_mux);
+  if (err == ESP_OK)
+  {
+    ++link_stats.sent;
+  }
+  else if (in_flight(pick))
+  {
+    // No callback will come. Out of buffers: keep the slot for
+    // update_radio(). Anything else will not get better with a retry.
+    tx_busy = false;
+    if (err == ESP_ERR_ESPNOW_NO_MEM)
+    {
+      ++link_stats.no_mem;
+    }
+    else
+    {
+      tx_slots[pick].used = false;
+      note_delivery(false);
+    }
+  }
+  portEXIT_CRITICAL(&tx_mux);
+}
+
+} // namespace
+
+bool radio_send(const uint8_t *data, size_t len, TxPriority priority)
+{
+  // Nothing to send to until a controller is paired or being paired.
+  if (!controller_peer_known || len < 3 || len > kTelemetryMaxPacketBytes)
+  {
+    return false;
+  }
+
+  const uint8_t type = data[2];
+  const uint16_t frame_id =
+      (type == kTelemetryTypeScanChunk && len >= sizeof(ScanChunkHeader)) ? scan_frame_id(data) : 0;
+
+  bool accepted = false;
+  portENTER_CRITICAL(&tx_mux);
+  uint8_t slot = claim_slot(type, frame_id);
+  if (slot == kTxQueueSlots && priority == kTxControl)
+  {
+    // Control frames must not be lost to a queue full of telemetry.
+    slot = evict_bulk();
+  }
+  if (slot != kTxQueueSlots)
+  {
+    TxSlot &tx = tx_slots[slot];
+    memcpy(tx.data, data, len);
+    tx.len = static_cast<uint8_t>(len);
+    tx.type = type;
+    tx.priority = priority;
+    tx.frame_id = frame_id;
+    tx.retries = 0;
+    if (!tx.used)
+    {
+      tx.used = true;
+      tx.seq = tx_next_seq++;
+    }
+    ++link_stats.queued;
+    accepted = true;
+  }
+  else
+  {
+    ++link_stats.overflow;
+  }
+  const uint8_t depth = queue_depth();
+  if (depth > link_stats.max_depth)
+  {
+    link_stats.max_depth = depth;
+  }
+  portEXIT_CRITICAL(&tx_mux);
+
+  send_next();
+  return accepted;
+}
+
+void radio_on_sent(bool delivered)
+{
+  const uint32_t now_us = micros();
+  uint32_t airtime_us = 0;
+  uint8_t len = 0;
+
+  portENTER_CRITICAL(&tx_mux);
+  if (!tx_busy)
+  {
+    // Later than kTxCallbackLostMs; the radio has already moved on.
+    ++link_stats.late_callbacks;
+    portEXIT_CRITICAL(&tx_mux);
+    return;
+  }
+  if (!in_flight(tx_busy_slot))
+  {
+    // The frame timed out in update_radio() and was already counted lost.
+    tx_busy = false;
+    tx_abandoned = false;
+    ++link_stats.late_callbacks;
+    portEXIT_CRITICAL(&tx_mux);
+    send_next();
+    return;
+  }
+
+  TxSlot &tx = tx_slots[tx_busy_slot];
+  airtime_us = now_us - tx_sent_us;
+  len = tx.len;
+  if (!delivered && tx.retries < kTxMaxRetries)
+  {
+    // Keeps its sequence number, so it goes again next.
+    ++tx.retries;
+    ++link_stats.retries;
+  }
+  else
+  {
+    tx.used = false;
+  }
+  tx_busy = false;
+  note_delivery(delivered);
+  portEXIT_CRITICAL(&tx_mux);
+
+  // Small packets are dominated by fixed overhead; only scan chunks set the rate.
+  if (len >= kTelemetryMaxPacketBytes / 2)
+  {
+    const uint32_t us_per_kb = airtime_us * 1024UL / len;
+    link_stats.us_per_kb = link_stats.us_per_kb == 0
+                               ? us_per_kb
+                               : link_stats.us_per_kb + (static_cast<int32_t>(us_per_kb - link_stats.us_per_kb) >> 3);
+  }
+
+  send_next();
+}
+
+void update_radio()
+{
+  portENTER_CRITICAL(&tx_mux);
+  const uint32_t waited_us = micros() - tx_sent_us;
+  if (in_flight(tx_busy_slot) && waited_us > kTxCallbackTimeoutMs * 1000UL)
+  {
+    tx_slots[tx_busy_slot].used = false;
+    tx_abandoned = true;
+    ++link_stats.timeouts;
+    note_delivery(false);
+  }
+  else if (tx_busy && tx_abandoned && waited_us > kTxCallbackLostMs * 1000UL)
+  {
+    tx_busy = false;
+    tx_abandoned = false;
+  }
+  portEXIT_CRITICAL(&tx_mux);
+
+  send_next();
+}
+
+void print_radio_status()
+{
+  portENTER_CRITICAL(&tx_mux);
+  const uint8_t depth = queue_depth();
+  portEXIT_CRITICAL(&tx_mux);
+
+  Serial.printf("Link sent=%lu delivered=%lu failed=%lu success=%u%% airtime=%lu us/KB\n",
+                static_cast<unsigned long>(link_stats.sent),
+                static_cast<unsigned long>(link_stats.delivered),
+                static_cast<unsigned long>(link_stats.failed),
+                static_cast<unsigned>(link_stats.success_q8 * 100 / 256),
+                static_cast<unsigned long>(link_stats.us_per_kb));
+  Serial.printf("TX queue depth=%u/%u max=%u queued=%lu superseded=%lu overflow=%lu retries=%lu no_mem=%lu timeouts=%lu late=%lu\n",
+                static_cast<unsigned>(depth),
+                static_cast<unsigned>(kTxQueueSlots),
+                static_cast<unsigned>(link_stats.max_depth),
+                static_cast<unsigned long>(link_stats.queued),
+                static_cast<unsigned long>(link_stats.superseded),
+                static_cast<unsigned long>(link_stats.overflow),
+                static_cast<unsigned long>(link_stats.retries),
+                static_cast<unsigned long>(link_stats.no_mem),
+                static_cast<unsigned long>(link_stats.timeouts),
+                static_cast<unsigned long>(link_stats.late_callbacks));
+}
+
+} // namespace bot
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "bot_config.h"
+
+namespace bot {
+
+// Queues a packet for the controller. One frame is on the air at a time; the
+// next is sent from the send callback, highest priority class first. A queued
+// scan chunk from an older frame, or a queued packet of the same type, is
+// replaced rather than sent late. Returns false if the packet was dropped.
+bool radio_send(const uint8_t *data, size_t len, TxPriority priority);
+// ESP-NOW send callback hook.
+void radio_on_sent(bool delivered);
+// Restarts the queue after a rejected send or a lost callback. Call every loop.
+void update_radio();
+void print_radio_status();
+
+} // namespace bot
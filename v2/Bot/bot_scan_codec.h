@@ -0,0 +1,516 @@
+#pragma once
+
+// Scan chunk v2 point stream. Positions are in fine grid bins; the cursor
+// starts at the header's start_bin and the stride at its bin_stride.
+//
+//   0x0n               skip n bins (1..15)
+//   0x00 n             skip n bins (1..255)
+//   0x00 0x00 s        set the stride to s; each point then covers s bins
+//   [iiii c zzz] ...   point: i = intensity >> 4 (1..15, so never 0x0_),
+//                      zzz = low 3 bits of the zigzag residual, c = more bits
+//                      follow as LEB128 bytes (7 bits each, high bit = more).
+//
+// The residual is the quantised distance minus a prediction: 2*d1 - d2 after
+// two adjacent points, d1 after one, across a skip or a stride change, zero at
+// a chunk start. Smooth walls therefore cost one byte per point regardless of
+// their slope.
+//
+// The stride is chosen per sector of kTelemetrySectorBins. Sectors start at
+// full resolution and the least important ones are coarsened until the scan
+// fits the byte budget. Near returns and range edges are important; far,
+// flat walls are not. bot_telemetry.cpp sets the budget from the link.
+//
+// With kTelemetryRotatePhase, a coarse sector starts its groups frame_id %
+// stride bins in, behind a skip token, and drops the partial group at its
+// end. Over stride frames every fine bin is the centre of some group.
+//
+// Kept apart from bot_telemetry.cpp, and free of anything but bot_config.h
+// and the LiDAR types, so v2/host can check it against the controller's
+// decoder.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bot_config.h"
+#include "lidar_data.h"
+
+namespace bot {
+namespace scan_codec {
+
+// Lead byte plus two LEB128 bytes covers any 16-bit zigzag residual.
+constexpr size_t kMaxTokenBytes = 3;
+
+struct ChunkSet
+{
+  uint8_t packets[kTelemetryMaxChunks][kTelemetryMaxPacketBytes]{};
+  size_t lengths[kTelemetryMaxChunks]{};
+  uint16_t points[kTelemetryMaxChunks]{};
+  uint8_t count = 0;
+  bool overflow = false;
+};
+
+class ChunkWriter
+{
+ public:
+  ChunkWriter(ChunkSet &set, uint16_t frame_id, uint8_t stride)
+      : set_(set), frame_id_(frame_id), stride_(stride)
+  {
+    set_.count = 0;
+    set_.overflow = false;
+  }
+
+  void set_stride(uint8_t stride)
+  {
+    if (stride == stride_)
+    {
+      return;
+    }
+    stride_ = stride;
+    stride_changed_ = open_;
+    history_ = history_ > 0 ? 1 : 0;
+  }
+
+  void add_point(uint16_t bin, uint16_t dist_q, uint8_t intensity)
+  {
+    if (!reserve(bin))
+    {
+      return;
+    }
+    flush_skip();
+    if (stride_changed_)
+    {
+      put(0x00);
+      put(0x00);
+      put(stride_);
+      stride_changed_ = false;
+    }
+
+    int32_t prediction = 0;
+    if (history_ >= 2)
+    {
+      prediction = 2 * static_cast<int32_t>(d1_) - d2_;
+    }
+    else if (history_ == 1)
+    {
+      prediction = d1_;
+    }
+    const int32_t residual = static_cast<int32_t>(dist_q) - prediction;
+    uint32_t zigzag = (static_cast<uint32_t>(residual) << 1) ^ static_cast<uint32_t>(residual >> 31);
+
+    const uint8_t intensity_q = max<uint8_t>(1, intensity >> 4);
+    put((intensity_q << 4) | (zigzag > 7 ? 0x08 : 0x00) | (zigzag & 0x07));
+    zigzag >>= 3;
+    while (zigzag != 0)
+    {
+      put((zigzag & 0x7F) | (zigzag > 0x7F ? 0x80 : 0x00));
+      zigzag >>= 7;
+    }
+
+    d2_ = d1_;
+    d1_ = dist_q;
+    history_ = history_ < 2 ? history_ + 1 : 2;
+    ++set_.points[set_.count - 1];
+  }
+
+  void add_gap()
+  {
+    skip(stride_);
+  }
+
+  void skip(uint16_t bins)
+  {
+    if (!open_ || bins == 0)
+    {
+      return;
+    }
+    pending_skip_ += bins;
+    // The slope does not carry across a gap, the last distance still does.
+    history_ = history_ > 0 ? 1 : 0;
+  }
+
+  // Drops trailing skips, which carry no information, and fills in the
+  // chunk and point counts of every header.
+  void finish()
+  {
+    pending_skip_ = 0;
+    for (uint8_t i = 0; i < set_.count; ++i)
+    {
+      ScanChunkHeader header;
+      memcpy(&header, set_.packets[i], sizeof(header));
+      header.chunk_count = set_.count;
+      header.point_count = set_.points[i];
+      memcpy(set_.packets[i], &header, sizeof(header));
+    }
+  }
+
+  // Payload bytes written so far, excluding chunk headers.
+  size_t payload_bytes() const
+  {
+    size_t total = 0;
+    for (uint8_t i = 0; i < set_.count; ++i)
+    {
+      total += set_.lengths[i] - sizeof(ScanChunkHeader);
+    }
+    return total;
+  }
+
+ private:
+  // Makes room for one more point token, opening a new chunk if needed.
+  bool reserve(uint16_t bin)
+  {
+    const size_t prefix_bytes =
+        2 * ((pending_skip_ + 254) / 255) + 1 + (stride_changed_ ? 3 : 0);
+    if (open_ && length() + prefix_bytes + kMaxTokenBytes <= kTelemetryMaxPacketBytes)
+    {
+      return true;
+    }
+    if (set_.count >= kTelemetryMaxChunks)
+    {
+      set_.overflow = true;
+      return false;
+    }
+
+    const ScanChunkHeader header{
+        kTelemetryMagic,
+        kTelemetryVersion,
+        kTelemetryTypeScanChunk,
+        frame_id_,
+        set_.count,
+        0,  // chunk_count, filled in by finish()
+        stride_,
+        bin,
+        0,  // point_count, filled in by finish()
+    };
+    memcpy(set_.packets[set_.count], &header, sizeof(header));
+    set_.lengths[set_.count] = sizeof(header);
+    set_.points[set_.count] = 0;
+    ++set_.count;
+    open_ = true;
+    pending_skip_ = 0;
+    stride_changed_ = false;
+    history_ = 0;
+    return true;
+  }
+
+  void flush_skip()
+  {
+    while (pending_skip_ > 0)
+    {
+      if (pending_skip_ <= 0x0F)
+      {
+        put(static_cast<uint8_t>(pending_skip_));
+        pending_skip_ = 0;
+        break;
+      }
+      const uint16_t run = min<uint16_t>(pending_skip_, 255);
+      put(0x00);
+      put(static_cast<uint8_t>(run));
+      pending_skip_ -= run;
+    }
+  }
+
+  size_t length() const
+  {
+    return set_.lengths[set_.count - 1];
+  }
+
+  void put(uint8_t value)
+  {
+    set_.packets[set_.count - 1][set_.lengths[set_.count - 1]++] = value;
+  }
+
+  ChunkSet &set_;
+  uint16_t frame_id_;
+  uint8_t stride_;
+  bool open_ = false;
+  bool stride_changed_ = false;
+  uint16_t pending_skip_ = 0;
+  uint8_t history_ = 0;
+  uint16_t d1_ = 0;
+  uint16_t d2_ = 0;
+};
+
+struct ScanGrid
+{
+  uint16_t dist_q[kTelemetryAngleBins]{};  // 0 = empty
+  uint8_t intensity[kTelemetryAngleBins]{};
+  uint8_t angle_error_q8[kTelemetryAngleBins]{};
+};
+
+constexpr uint8_t kStrideLevels[] = {1, 2, 3, 5};
+constexpr uint8_t kStrideLevelCount = sizeof(kStrideLevels);
+constexpr uint8_t kSectorCount = kTelemetryAngleBins / kTelemetrySectorBins;
+constexpr uint8_t kMaxEncodePasses = 4;
+static_assert(kTelemetryAngleBins % kTelemetrySectorBins == 0, "sectors must tile the grid");
+// 30 is the least common multiple of the stride levels.
+static_assert(kTelemetrySectorBins % 30 == 0, "every stride level must tile a sector");
+static_assert(kStrideLevels[kStrideLevelCount - 1] <= kTelemetryMaxBinStride, "controller limit");
+
+struct SectorPlan
+{
+  uint8_t level[kSectorCount]{};        // index into kStrideLevels
+  uint16_t importance[kSectorCount]{};
+  uint16_t valid[kSectorCount]{};
+  uint16_t bytes[kSectorCount]{};       // payload at the current level
+};
+
+inline uint16_t quantise_distance(int32_t distance_mm)
+{
+  return static_cast<uint16_t>(
+      max<int32_t>(1, (distance_mm + kTelemetryDistQuantumMm / 2) / kTelemetryDistQuantumMm));
+}
+
+// Angle in grid bins, Q8.
+inline int32_t angle_to_bin_q8(float angle_deg)
+{
+  return static_cast<int32_t>(angle_deg * (kTelemetryAngleBins * 256.0f / 360.0f) + 0.5f);
+}
+
+// Resamples the scan onto the fixed angle grid. The LD06 does not sample on
+// the grid, so a bin between two returns on the same surface gets the
+// distance interpolated to its centre. That keeps walls smooth for the
+// predictor and puts points at the angle the controller will draw them.
+// Bins next to a range jump, or with a single return, take the return
+// closest in angle.
+inline void build_grid(const lidar::ScanFrame &scan, ScanGrid &grid)
+{
+  memset(grid.dist_q, 0, sizeof(grid.dist_q));
+  memset(grid.angle_error_q8, 0xFF, sizeof(grid.angle_error_q8));
+
+  constexpr int32_t kGridQ8 = static_cast<int32_t>(kTelemetryAngleBins) << 8;
+  bool have_previous = false;
+  int32_t previous_q8 = 0;
+  uint16_t previous_mm = 0;
+
+  for (uint16_t i = 0; i < scan.point_count; ++i)
+  {
+    const lidar::ScanPoint &point = scan.points[i];
+    if (!point.valid)
+    {
+      have_previous = false;
+      continue;
+    }
+
+    const int32_t angle_q8 = angle_to_bin_q8(point.angle_deg);
+    uint16_t bin = static_cast<uint16_t>((angle_q8 + 128) >> 8);
+    if (bin >= kTelemetryAngleBins)
+    {
+      bin -= kTelemetryAngleBins;
+    }
+    const uint8_t error_q8 = static_cast<uint8_t>(abs(angle_q8 - ((angle_q8 + 128) & ~0xFF)));
+    if (error_q8 < grid.angle_error_q8[bin])
+    {
+      grid.dist_q[bin] = quantise_distance(point.distance_mm);
+      grid.intensity[bin] = point.intensity;
+      grid.angle_error_q8[bin] = error_q8;
+    }
+
+    const int32_t span_q8 = angle_q8 - previous_q8;
+    if (have_previous && span_q8 != 0 && abs(span_q8) < 2 * 256 &&
+        abs(static_cast<int32_t>(point.distance_mm) - previous_mm) <= kTelemetryEdgeMm)
+    {
+      const int32_t lo_q8 = min(previous_q8, angle_q8);
+      const int32_t hi_q8 = max(previous_q8, angle_q8);
+      for (int32_t centre_q8 = (lo_q8 + 255) & ~0xFF; centre_q8 <= hi_q8; centre_q8 += 256)
+      {
+        const uint16_t centre_bin = static_cast<uint16_t>((centre_q8 % kGridQ8) >> 8);
+        const int32_t distance_mm =
+            previous_mm + (static_cast<int32_t>(point.distance_mm) - previous_mm) *
+                              (centre_q8 - previous_q8) / span_q8;
+        grid.dist_q[centre_bin] = quantise_distance(distance_mm);
+        grid.intensity[centre_bin] = point.intensity;
+        grid.angle_error_q8[centre_bin] = 0;
+      }
+    }
+
+    have_previous = true;
+    previous_q8 = angle_q8;
+    previous_mm = point.distance_mm;
+  }
+}
+
+// Per-sector importance per valid bin, Q4. Every return is worth 16; near
+// returns up to three times that, plus a bonus at range edges and corners.
+inline void rate_sectors(const ScanGrid &grid, SectorPlan &plan)
+{
+  for (uint8_t sector = 0; sector < kSectorCount; ++sector)
+  {
+    uint32_t weight = 0;
+    uint16_t valid = 0;
+    const uint16_t first = sector * kTelemetrySectorBins;
+
+    for (uint16_t bin = first; bin < first + kTelemetrySectorBins; ++bin)
+    {
+      const uint16_t dist_q = grid.dist_q[bin];
+      if (dist_q == 0)
+      {
+        continue;
+      }
+      ++valid;
+
+      const int32_t dist_mm = static_cast<int32_t>(dist_q) * kTelemetryDistQuantumMm;
+      weight += 16;
+      if (dist_mm < kTelemetryNearMm)
+      {
+        weight += 32 * (kTelemetryNearMm - dist_mm) / kTelemetryNearMm;
+      }
+
+      const uint16_t prev = grid.dist_q[bin == 0 ? kTelemetryAngleBins - 1 : bin - 1];
+      const uint16_t next = grid.dist_q[bin + 1 == kTelemetryAngleBins ? 0 : bin + 1];
+      if (prev == 0 || next == 0)
+      {
+        weight += 16;
+      }
+      else
+      {
+        const int32_t curvature = static_cast<int32_t>(prev) + next - 2 * dist_q;
+        if (abs(curvature) * kTelemetryDistQuantumMm > kTelemetryEdgeMm / 4)
+        {
+          weight += 16;
+        }
+      }
+    }
+
+    plan.importance[sector] = valid > 0 ? static_cast<uint16_t>(weight / valid) : 0;
+    plan.valid[sector] = valid;
+  }
+}
+
+inline void encode_grid(const ScanGrid &grid, SectorPlan &plan, uint16_t frame_id, ChunkSet &set)
+{
+  ChunkWriter writer(set, frame_id, kStrideLevels[plan.level[0]]);
+
+  for (uint8_t sector = 0; sector < kSectorCount; ++sector)
+  {
+    const uint8_t stride = kStrideLevels[plan.level[sector]];
+    const uint16_t first = sector * kTelemetrySectorBins;
+    const uint16_t end = first + kTelemetrySectorBins;
+    const uint8_t phase = kTelemetryRotatePhase ? frame_id % stride : 0;
+    const size_t bytes_before = writer.payload_bytes();
+    writer.set_stride(stride);
+    writer.skip(phase);
+
+    uint16_t bin = first + phase;
+    for (; bin + stride <= end; bin += stride)
+    {
+      // A coarse bin keeps the nearest return it covers.
+      uint16_t dist_q = 0;
+      uint8_t intensity = 0;
+      for (uint8_t k = 0; k < stride; ++k)
+      {
+        const uint16_t fine = bin + k;
+        if (grid.dist_q[fine] != 0 && (dist_q == 0 || grid.dist_q[fine] < dist_q))
+        {
+          dist_q = grid.dist_q[fine];
+          intensity = grid.intensity[fine];
+        }
+      }
+
+      if (dist_q == 0)
+      {
+        writer.add_gap();
+      }
+      else
+      {
+        writer.add_point(bin, dist_q, intensity);
+      }
+    }
+    writer.skip(end - bin);
+
+    plan.bytes[sector] = static_cast<uint16_t>(writer.payload_bytes() - bytes_before);
+  }
+  writer.finish();
+}
+
+// Coarsens the sectors with the least importance per kept point until the
+// estimated payload drops below the budget. Returns false if nothing is left
+// to coarsen.
+inline bool coarsen_sectors(SectorPlan &plan, int32_t excess_bytes)
+{
+  bool changed = false;
+  while (excess_bytes > 0)
+  {
+    uint8_t pick = kSectorCount;
+    uint32_t pick_value = UINT32_MAX;
+    for (uint8_t sector = 0; sector < kSectorCount; ++sector)
+    {
+      if (plan.valid[sector] == 0 || plan.level[sector] + 1 >= kStrideLevelCount)
+      {
+        continue;
+      }
+      const uint32_t value =
+          static_cast<uint32_t>(plan.importance[sector]) * kStrideLevels[plan.level[sector]];
+      if (value < pick_value)
+      {
+        pick_value = value;
+        pick = sector;
+      }
+    }
+    if (pick == kSectorCount)
+    {
+      break;
+    }
+
+    const uint8_t stride = kStrideLevels[plan.level[pick]];
+    const uint8_t next_stride = kStrideLevels[plan.level[pick] + 1];
+    const uint16_t saved = plan.bytes[pick] - plan.bytes[pick] * stride / next_stride;
+    plan.bytes[pick] -= saved;
+    excess_bytes -= max<uint16_t>(saved, 1);
+    ++plan.level[pick];
+    changed = true;
+  }
+  return changed;
+}
+
+// Working buffers for encode_scan(), kept together so the caller can make
+// them static.
+struct ScanEncoder
+{
+  ScanGrid grid;
+  SectorPlan plan;
+  ChunkSet set;
+};
+
+// Resamples the scan, then coarsens sectors until the payload fits
+// budget_bytes with no point spilling past target_chunks, or nothing is
+// left to coarsen. The chunks are in encoder.set, headers filled in.
+inline void encode_scan(const lidar::ScanFrame &scan,
+                        uint16_t frame_id,
+                        uint16_t budget_bytes,
+                        uint8_t target_chunks,
+                        ScanEncoder &encoder)
+{
+  build_grid(scan, encoder.grid);
+  rate_sectors(encoder.grid, encoder.plan);
+  memset(encoder.plan.level, 0, sizeof(encoder.plan.level));
+
+  for (uint8_t pass = 0; pass < kMaxEncodePasses; ++pass)
+  {
+    encode_grid(encoder.grid, encoder.plan, frame_id, encoder.set);
+    const ChunkSet &set = encoder.set;
+    size_t payload = 0;
+    for (uint8_t i = 0; i < set.count; ++i)
+    {
+      payload += set.lengths[i] - sizeof(ScanChunkHeader);
+    }
+
+    // Points never straddle chunks, so the target chunk count can be
+    // exceeded with the payload still under budget; shed whatever spilled.
+    int32_t excess = static_cast<int32_t>(payload) - budget_bytes;
+    for (uint8_t i = target_chunks; i < set.count; ++i)
+    {
+      excess = max<int32_t>(excess, set.lengths[i] - sizeof(ScanChunkHeader));
+    }
+    if (set.overflow)
+    {
+      excess = max<int32_t>(excess, static_cast<int32_t>(payload) / 4);
+    }
+    if (excess <= 0 || !coarsen_sectors(encoder.plan, excess))
+    {
+      break;
+    }
+  }
+}
+
+} // namespace scan_codec
+} // namespace bot
@@ -10,6 +10,7 @@ volatile bool activity_flag = false;
 volatile char mode = 'x';
 volatile char direction = 'x';
 volatile unsigned long last_cmd_time = 0;
+volatile unsigned long last_command_rx_ms = 0;
 
 uint32_t led_base_color = 0;
 unsigned long led_flash_end = 0;
@@ -17,6 +18,12 @@ unsigned long last_lidar_status_ms = 0;
 
 LidarState lidar_state;
 StuckTracker stuck_tracker;
+PlannerState planner_state;
+TurnState turn_state;
+MotionProfile motion_profile;
+SpeedTargets speed_targets;
+uint8_t pwm_mode_index = kDefaultPwmMode;
+DecayMode decay_mode = kDefaultDecayMode;
 WanderAction wander_next_action = kDoForward;
 unsigned long wander_deadline_ms = 0;
 bool g_dodging = false;
@@ -26,6 +33,11 @@ unsigned long g_unstuck_end_ms = 0;
 bool g_wall_follow_left = true;
 unsigned long last_telemetry_ms = 0;
 uint16_t telemetry_frame_id = 0;
+TelemetryStats telemetry_stats;
+LinkStats link_stats;
+DriveCommandState drive_command;
+RemoteCommandQueue remote_commands;
+PairingState pairing;
 bool controller_peer_known = false;
 uint8_t controller_peer_addr[6]{};
 
@@ -16,6 +16,7 @@ extern volatile bool activity_flag;
 extern volatile char mode;
 extern volatile char direction;
 extern volatile unsigned long last_cmd_time;
+extern volatile unsigned long last_command_rx_ms;
 
 extern uint32_t led_base_color;
 extern unsigned long led_flash_end;
@@ -23,6 +24,12 @@ extern unsigned long last_lidar_status_ms;
 
 extern LidarState lidar_state;
 extern StuckTracker stuck_tracker;
+extern PlannerState planner_state;
+extern TurnState turn_state;
+extern MotionProfile motion_profile;
+extern SpeedTargets speed_targets;
+extern uint8_t pwm_mode_index;
+extern DecayMode decay_mode;
 extern WanderAction wander_next_action;
 extern unsigned long wander_deadline_ms;
 extern bool g_dodging;
@@ -32,6 +39,11 @@ extern unsigned long g_unstuck_end_ms;
 extern bool g_wall_follow_left;
 extern unsigned long last_telemetry_ms;
 extern uint16_t telemetry_frame_id;
+extern TelemetryStats telemetry_stats;
+extern LinkStats link_stats;
+extern DriveCommandState drive_command;
+extern RemoteCommandQueue remote_commands;
+extern PairingState pairing;
 extern bool controller_peer_known;
 extern uint8_t controller_peer_addr[6];
 
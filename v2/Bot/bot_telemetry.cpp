@@ -0,0 +1,167 @@
+#include "bot_telemetry.h"
+
+#include <string.h>
+
+#include "bot_imu.h"
+#include "bot_odometry.h"
+#include "bot_radio.h"
+#include "bot_scan_codec.h"
+#include "bot_state.h"
+
+// Scans are encoded by bot_scan_codec.h. The byte budget set here shrinks
+// when ESP-NOW sends fail or take longer on air.
+
+namespace bot {
+namespace {
+
+using scan_codec::ChunkSet;
+using scan_codec::ScanEncoder;
+using scan_codec::SectorPlan;
+using scan_codec::encode_scan;
+using scan_codec::kSectorCount;
+
+ScanEncoder scan_encoder;
+uint8_t backoff_count = 0;
+
+uint16_t scan_byte_budget(bool commanding)
+{
+  constexpr uint16_t kChunkPayload = kTelemetryMaxPacketBytes - sizeof(ScanChunkHeader);
+
+  uint32_t budget = commanding ? kChunkPayload : kTelemetryTargetChunks * kChunkPayload;
+  const uint32_t us_per_kb = link_stats.us_per_kb;
+  if (us_per_kb > 0)
+  {
+    budget = min<uint32_t>(budget, kTelemetryAirtimeBudgetUs * 1024UL / us_per_kb);
+  }
+  // Scale down with the delivery ratio once it drops below ~90%.
+  const uint32_t success_q8 = link_stats.success_q8;
+  if (success_q8 < 230)
+  {
+    budget = budget * success_q8 / 256;
+  }
+  return static_cast<uint16_t>(max<uint32_t>(budget, kTelemetryMinScanBytes));
+}
+
+void send_scan_chunks(const lidar::ScanFrame &scan, bool commanding)
+{
+  if (scan.valid_point_count == 0)
+  {
+    return;
+  }
+
+  const uint16_t budget = scan_byte_budget(commanding);
+  encode_scan(scan, telemetry_frame_id, budget, commanding ? 1 : kTelemetryTargetChunks, scan_encoder);
+  const ChunkSet &chunk_set = scan_encoder.set;
+  const SectorPlan &sector_plan = scan_encoder.plan;
+
+  uint16_t total_points = 0;
+  size_t total_bytes = 0;
+  for (uint8_t i = 0; i < chunk_set.count; ++i)
+  {
+    radio_send(chunk_set.packets[i], chunk_set.lengths[i], kTxBulk);
+    total_points += chunk_set.points[i];
+    total_bytes += chunk_set.lengths[i];
+  }
+
+  uint8_t coarse_sectors = 0;
+  for (uint8_t sector = 0; sector < kSectorCount; ++sector)
+  {
+    coarse_sectors += sector_plan.level[sector] > 0 ? 1 : 0;
+  }
+
+  ++telemetry_stats.frames;
+  telemetry_stats.chunks += chunk_set.count;
+  telemetry_stats.bytes += total_bytes;
+  telemetry_stats.last_points = total_points;
+  telemetry_stats.last_bytes = static_cast<uint16_t>(total_bytes);
+  telemetry_stats.last_budget = budget;
+  telemetry_stats.last_coarse_sectors = coarse_sectors;
+}
+
+} // namespace
+
+void update_telemetry(const lidar::ScanFrame &scan)
+{
+  const unsigned long now = millis();
+  if (!controller_peer_known || (now - last_telemetry_ms) < kTelemetryIntervalMs)
+  {
+    return;
+  }
+  last_telemetry_ms = now;
+
+  // Leave the air to command traffic while the controller is driving.
+  const bool commanding = (now - last_command_rx_ms) < kCommandActiveMs;
+  if (!commanding || ++backoff_count >= kTelemetryBackoffFactor)
+  {
+    backoff_count = 0;
+    ++telemetry_frame_id;
+    send_scan_chunks(scan, commanding);
+  }
+  else
+  {
+    ++telemetry_stats.backoff_skips;
+  }
+
+  const MotionTelemetry motion_packet{
+      kTelemetryMagic,
+      kTelemetryVersion,
+      kTelemetryTypeMotion,
+      static_cast<char>(mode),
+      static_cast<char>(direction),
+      static_cast<uint8_t>(((g_dodging || g_unsticking) ? 0x01 : 0x00) |
+                           (g_wall_follow_left ? 0x02 : 0x00)),
+  };
+  radio_send(reinterpret_cast<const uint8_t *>(&motion_packet), sizeof(motion_packet), kTxState);
+
+#ifdef BOT_HAS_ENCODERS
+  const OdometryPose &pose = get_pose();
+  const PoseTelemetry pose_packet{
+      kTelemetryMagic,
+      kTelemetryVersion,
+      kTelemetryTypePose,
+      static_cast<int32_t>(lroundf(pose.x_m * 1000.0f)),
+      static_cast<int32_t>(lroundf(pose.y_m * 1000.0f)),
+      static_cast<int16_t>(lroundf(pose.theta_rad * 1000.0f)),
+      static_cast<uint16_t>(min(sqrtf(pose.cov[0][0]) * 1000.0f, 65535.0f)),
+      static_cast<uint16_t>(min(sqrtf(pose.cov[1][1]) * 1000.0f, 65535.0f)),
+      static_cast<uint16_t>(min(sqrtf(pose.cov[2][2]) * 1000.0f, 65535.0f)),
+  };
+  radio_send(reinterpret_cast<const uint8_t *>(&pose_packet), sizeof(pose_packet), kTxState);
+#endif
+
+#ifdef BOT_HAS_IMU
+  AttitudeTelemetry attitude_packet{
+      kTelemetryMagic,
+      kTelemetryVersion,
+      kTelemetryTypeAttitude,
+      {},
+      static_cast<int16_t>((static_cast<int32_t>(get_heading_bam()) * 36000) / 65536),
+      static_cast<int16_t>(constrain(lroundf(get_yaw_rate_dps() * 100.0f), -32767L, 32767L)),
+  };
+  int16_t quat_q14[4];
+  get_quaternion_q14(quat_q14);
+  memcpy(attitude_packet.quat_q14, quat_q14, sizeof(quat_q14));
+  radio_send(reinterpret_cast<const uint8_t *>(&attitude_packet), sizeof(attitude_packet), kTxState);
+#endif
+}
+
+void print_telemetry_status()
+{
+  Serial.printf("Telemetry v%u frames=%lu chunks=%lu bytes=%lu last: points=%u bytes=%u budget=%u coarse_sectors=%u/%u (%.2f B/pt) backoff_skips=%lu\n",
+                static_cast<unsigned>(kTelemetryVersion),
+                static_cast<unsigned long>(telemetry_stats.frames),
+                static_cast<unsigned long>(telemetry_stats.chunks),
+                static_cast<unsigned long>(telemetry_stats.bytes),
+                static_cast<unsigned>(telemetry_stats.last_points),
+                static_cast<unsigned>(telemetry_stats.last_bytes),
+                static_cast<unsigned>(telemetry_stats.last_budget),
+                static_cast<unsigned>(telemetry_stats.last_coarse_sectors),
+                static_cast<unsigned>(kSectorCount),
+                telemetry_stats.last_points > 0
+                    ? static_cast<float>(telemetry_stats.last_bytes) / telemetry_stats.last_points
+                    : 0.0f,
+                static_cast<unsigned long>(telemetry_stats.backoff_skips));
+  print_radio_status();
+}
+
+} // namespace bot
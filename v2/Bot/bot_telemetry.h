@@ -0,0 +1,15 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "LD06_LiDAR.h"
+#include "bot_config.h"
+
+namespace bot {
+
+// Sends the scan, motion, pose and attitude packets to the controller every
+// kTelemetryIntervalMs. Call once per completed scan.
+void update_telemetry(const lidar::ScanFrame &scan);
+void print_telemetry_status();
+
+} // namespace bot
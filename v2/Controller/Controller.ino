@@ -1,9 +1,14 @@
 #include <Arduino.h>
 #include <Adafruit_NeoPixel.h>
 #include <esp_now.h>
+#include <Preferences.h>
 #include <WiFi.h>
 #include <string.h>
 
+#include <atomic>
+
+#include "scan_decode.h"
+
 namespace
 {
 
@@ -11,18 +16,80 @@ constexpr int kLedPin = 2;
 constexpr uint32_t kUsbBaud = 460800;
 constexpr unsigned long kKeepaliveMs = 500;
 constexpr unsigned long kViewerHandshakeMs = 1000;
-
-constexpr uint8_t kBotMac[6] = {0x34, 0xB7, 0xDA, 0xF2, 0x36, 0xC4};
+constexpr unsigned long kPingIntervalMs = 250;
+constexpr unsigned long kPingTimeoutMs = 1000;   // later pongs count as lost
+constexpr unsigned long kLinkReportMs = 1000;
+constexpr uint8_t kPingSlots = 8;                // pings awaiting a pong
+constexpr uint8_t kLinkRttWindow = 64;           // samples behind the percentiles
+constexpr uint8_t kScanWindow = 2;               // frames assembled at once
+constexpr unsigned long kScanPartialTimeoutMs = 80;  // then sent with what arrived
+constexpr unsigned long kCompositePoseFreshMs = 500;  // older pose/attitude is ignored
+
+// Binary USB mode ('B' on, 'J' back to JSON lines). Each record is
+// u8 type | u8 bot | u16 frame_id | payload | u16 CRC-16/CCITT-FALSE,
+// COBS-encoded between 0x00 delimiters. Decoder and payload layouts:
+// v2/host/usb_frames.h.
+constexpr uint8_t kUsbRecordScan = 1;
+constexpr uint8_t kUsbRecordMotion = 2;
+constexpr uint8_t kUsbRecordPose = 3;
+constexpr uint8_t kUsbRecordAttitude = 4;
+constexpr uint8_t kUsbRecordLink = 5;
+constexpr uint8_t kUsbRecordScanStats = 6;
+
+// USB output is queued in whole records (a text line, a JSON object or a
+// binary frame) and written only as fast as the CDC buffer takes it, so a
+// stalled host never blocks loop() or the keepalives it sends.
+constexpr size_t kUsbTxRingBytes = 16384;   // two full JSON scans
+constexpr uint8_t kUsbTxMaxRecords = 32;
+constexpr size_t kUsbTxCdcBufferBytes = 4096;
+
+// Binary commands from the host use the same framing as binary output:
+// 0x00, COBS(u8 type | u8 bot | u16 seq | payload | u16 CRC), 0x00. Text
+// keys never contain 0x00, so both kinds can be mixed on one port.
+constexpr uint8_t kUsbCommandDrive = 1;  // i16 left, i16 right (PWM, -255..255), u16 ttl_ms
+constexpr size_t kUsbCommandMaxBytes = 32;
+constexpr size_t kMotorLineMaxChars = 8;  // "Lf255"
+
+// Fleet: one controller serves up to kMaxBots paired bots. A bot's index is
+// its id: it tags all USB output for that bot, and commands are routed by it.
+// Text keys go to the bot selected with '@' and a digit (bot 0 at start).
+// The fleet is kept in NVS, in pairing order, so ids survive a restart.
+constexpr uint8_t kMaxBots = 4;
 constexpr uint8_t kChannel = 1;
 
+// Pairing: a beacon is broadcast every kBeaconIntervalMs. It is "open" while
+// the fleet is empty, or for kPairWindowMs after 'P'. A bot answers an open
+// beacon with a pair request; a known bot is always answered, a new one only
+// while open.
+constexpr unsigned long kBeaconIntervalMs = 1000;
+constexpr unsigned long kPairWindowMs = 30000;
+constexpr uint8_t kBroadcastMac[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
 constexpr uint8_t kTelemetryMagic = 0xA5;
-constexpr uint8_t kTelemetryVersion = 1;
+// Scan chunks come in two layouts: v1 raw (x, y, intensity) points and v2
+// delta-coded polar points. Every other packet is the same in both.
+constexpr uint8_t kTelemetryMinVersion = 1;
+constexpr uint8_t kTelemetryVersion = 2;
 constexpr uint8_t kTelemetryTypeScanChunk = 1;
 constexpr uint8_t kTelemetryTypeMotion = 2;
-constexpr uint8_t kTelemetryPointsPerChunk = 48;
-constexpr uint8_t kTelemetryMaxPoints = 96;
-constexpr uint8_t kTelemetryMaxChunks =
-    (kTelemetryMaxPoints + kTelemetryPointsPerChunk - 1) / kTelemetryPointsPerChunk;
+constexpr uint8_t kTelemetryTypePose = 3;
+constexpr uint8_t kTelemetryTypeAttitude = 4;
+constexpr uint8_t kTelemetryTypePing = 5;
+constexpr uint8_t kTelemetryTypePong = 6;
+constexpr uint8_t kTelemetryTypeDrive = 7;  // controller -> bot, both wheels at once
+constexpr uint8_t kDriveCommandVersion = 1;  // DriveCommand layout, independent of telemetry
+constexpr uint8_t kTelemetryTypeBeacon = 8;       // controller -> broadcast
+constexpr uint8_t kTelemetryTypePairRequest = 9;  // bot -> controller
+constexpr uint8_t kTelemetryTypePairAccept = 10;  // controller -> bot
+constexpr uint8_t kPairingVersion = 1;  // pairing packet layout, independent of telemetry
+constexpr uint8_t kTelemetryPointsPerChunk = 48;  // v1
+constexpr uint8_t kTelemetryMaxPoints = 96;       // v1
+constexpr uint16_t kTelemetryAngleBins = 450;     // v2, 0.8 degree grid
+constexpr uint8_t kTelemetryDistQuantumMm = 8;    // v2
+constexpr uint8_t kTelemetryMaxBinStride = 5;     // v2
+constexpr uint8_t kTelemetryMaxChunks = 4;
+constexpr uint16_t kTelemetryMaxScanPoints = kTelemetryAngleBins;
+constexpr uint8_t kScanSlots = kMaxBots * kScanWindow + 2;  // filling, ready, draining
 
 struct __attribute__((packed)) TelemetryHeader
 {
@@ -36,6 +103,19 @@ struct __attribute__((packed)) TelemetryHeader
   uint8_t total_points;
 };
 
+struct __attribute__((packed)) ScanChunkHeader
+{
+  uint8_t magic;
+  uint8_t version;
+  uint8_t type;
+  uint16_t frame_id;
+  uint8_t chunk_index;
+  uint8_t chunk_count;
+  uint8_t bin_stride;
+  uint16_t start_bin;
+  uint16_t point_count;
+};
+
 struct __attribute__((packed)) TelemetryPoint
 {
   int16_t x_mm;
@@ -53,20 +133,143 @@ struct __attribute__((packed)) MotionTelemetry
   uint8_t flags;
 };
 
-struct TelemetryAssembly
+struct __attribute__((packed)) PoseTelemetry
+{
+  uint8_t magic;
+  uint8_t version;
+  uint8_t type;
+  int32_t x_mm;
+  int32_t y_mm;
+  int16_t theta_mrad;
+  uint16_t sigma_x_mm;
+  uint16_t sigma_y_mm;
+  uint16_t sigma_theta_mrad;
+};
+
+struct __attribute__((packed)) AttitudeTelemetry
+{
+  uint8_t magic;
+  uint8_t version;
+  uint8_t type;
+  int16_t quat_q14[4];
+  int16_t yaw_cdeg;
+  int16_t yaw_rate_cdps;
+};
+
+// Both wheels in one packet, so a curve is never half applied. The bot
+// ignores packets older than the last seq it applied and stops the wheels
+// if no newer command arrives within ttl_ms.
+struct __attribute__((packed)) DriveCommand
+{
+  uint8_t magic;
+  uint8_t version;
+  uint8_t type;
+  uint16_t seq;
+  int16_t left;
+  int16_t right;
+  uint16_t ttl_ms;
+};
+
+struct __attribute__((packed)) PairBeacon
+{
+  uint8_t magic;
+  uint8_t version;
+  uint8_t type;
+  uint8_t open;  // 1 while new bots are taken
+};
+
+struct __attribute__((packed)) PairRequest
+{
+  uint8_t magic;
+  uint8_t version;
+  uint8_t type;
+};
+
+struct __attribute__((packed)) PairAccept
+{
+  uint8_t magic;
+  uint8_t version;
+  uint8_t type;
+  uint8_t bot;  // the bot's id
+};
+
+struct __attribute__((packed)) LinkPing
+{
+  uint8_t magic;
+  uint8_t version;
+  uint8_t type;
+  uint16_t seq;
+  uint32_t sent_us;
+  int8_t rssi;  // pong: dBm the bot received the ping at
+};
+
+// Scans are assembled in place in a small pool of slots, shared by all
+// bots. Ownership moves
+// through the slot state: the receive callback (WiFi task) claims a Free
+// slot and fills it, publishes it as Ready, and loop() takes it as Draining,
+// streams it to USB and frees it. Points are written once, by the decoder.
+//
+// Up to kScanWindow frames fill at once, so a chunk that arrives after the
+// next frame has started still lands. A frame is published when all its
+// chunks are in, or with whatever arrived once it times out or is pushed
+// out of the window; chunk_mask tells the host which parts are missing.
+enum ScanSlotState : uint8_t
+{
+  kSlotFree,
+  kSlotFilling,
+  kSlotReady,
+  kSlotDraining,
+};
+
+// Where a v2 point came from on the fine grid: the group of `stride` bins
+// starting at `bin`. The composite needs it; v1 points have none.
+struct __attribute__((packed)) PointCell
+{
+  uint16_t bin;
+  uint8_t stride;
+};
+
+// The bot's pose when a scan was published, from the freshest pose packet,
+// else the attitude yaw alone, else none (identity).
+enum ScanPoseSource : uint8_t
+{
+  kPoseNone,
+  kPoseAttitude,
+  kPoseOdometry,
+};
+
+struct ScanPose
 {
+  float x_mm = 0.0f;
+  float y_mm = 0.0f;
+  float theta_rad = 0.0f;
+  uint8_t source = kPoseNone;
+};
+
+struct ScanSlot
+{
+  std::atomic<uint8_t> state{kSlotFree};
+  uint32_t ready_seq = 0;     // publish order, oldest drained first
+  uint8_t bot = 0;
+  uint8_t version = 0;
   uint16_t frame_id = 0;
   uint8_t chunk_count = 0;
-  uint8_t total_points = 0;
-  bool chunk_received[kTelemetryMaxChunks]{};
-  TelemetryPoint points[kTelemetryMaxPoints]{};
+  uint16_t total_points = 0;  // v1: announced up front; v2: grows as chunks decode
+  uint8_t chunk_mask = 0;     // bit i set once chunk i is in
+  unsigned long first_chunk_ms = 0;
+  ScanPose pose;
+  TelemetryPoint points[kTelemetryMaxScanPoints]{};
+  PointCell cells[kTelemetryMaxScanPoints]{};  // v2 only
 };
 
-struct ReadyScan
+// Updated by the receive callback, read by loop() for the 1 s report.
+struct ScanStats
 {
-  volatile bool pending = false;
-  uint16_t point_count = 0;
-  TelemetryPoint points[kTelemetryMaxPoints]{};
+  volatile uint32_t complete = 0;
+  volatile uint32_t partial = 0;      // published with chunks missing
+  volatile uint32_t dropped = 0;      // timed out or displaced with no usable points
+  volatile uint32_t late = 0;         // chunks of a frame already published
+  volatile uint32_t overwritten = 0;  // loop() fell behind and lost a ready scan
 };
 
 struct MotionState
@@ -78,396 +281,1793 @@ struct MotionState
   bool wall_follow_left = true;
 };
 
+struct PoseState
+{
+  volatile bool pending = false;
+  volatile unsigned long received_ms = 0;
+  PoseTelemetry packet{};
+};
+
+struct AttitudeState
+{
+  volatile bool pending = false;
+  volatile unsigned long received_ms = 0;
+  AttitudeTelemetry packet{};
+};
+
+// Composite scan mode ('C' on, 'F' back to single frames). The bot rotates
+// the sampling phase of its coarse sectors every frame; merging the last few
+// frames on the fine grid, in world coordinates, restores most of the
+// resolution the coarsening gave up, without extra airtime.
+//
+// A bin keeps its point for as many frames as the stride of the group that
+// last covered it, so full-resolution sectors show only the newest frame.
+struct CompositeBin
+{
+  float x_mm = 0.0f;  // world frame
+  float y_mm = 0.0f;
+  uint16_t frame_id = 0;
+  uint8_t keep_frames = 0;  // stride of the newest group covering this bin
+  uint8_t intensity = 0;
+  bool valid = false;
+};
+
+struct ScanComposite
+{
+  CompositeBin bins[kTelemetryAngleBins];
+  uint16_t frame_id = 0;
+  uint8_t pose_source = kPoseNone;  // points from different sources do not line up
+  bool have_frame = false;
+};
+
+struct __attribute__((packed)) LinkSummary
+{
+  uint8_t samples;
+  uint32_t p50_us;
+  uint32_t p90_us;
+  uint32_t p99_us;
+  uint32_t max_us;
+  uint16_t loss_permille;
+  uint32_t pings;
+  uint32_t lost;
+  int8_t rssi;
+  int8_t bot_rssi;
+};
+
+enum PingSlotState : uint8_t
+{
+  kPingFree,
+  kPingWaiting,
+  kPingAnswered,
+};
+
+// Slots are written by the receive callback only in the Waiting -> Answered
+// step; loop() does everything else.
+struct PingSlot
+{
+  volatile uint8_t state = kPingFree;
+  uint16_t seq = 0;
+  unsigned long sent_ms = 0;
+  uint32_t rtt_us = 0;
+  int8_t bot_rssi = 0;
+};
+
+struct LinkMonitor
+{
+  PingSlot slots[kPingSlots];
+  uint32_t rtt_us[kLinkRttWindow]{};
+  uint8_t rtt_head = 0;
+  uint8_t rtt_count = 0;
+  uint64_t lost_bits = 0;   // last 64 resolved pings, 1 = lost
+  uint8_t resolved = 0;     // valid bits in lost_bits
+  uint32_t pings = 0;
+  uint32_t lost = 0;
+  volatile int16_t rssi_q4 = 0;  // EWMA of received packets, dBm * 16
+  int8_t bot_rssi = 0;
+};
+
+// Everything kept per bot. The receive callback owns the assembly window;
+// the pending flags hand state packets to loop() as before.
+struct BotLink
+{
+  esp_now_peer_info_t peer{};
+  char mode = 'x';  // last mode key sent to this bot
+  ScanSlot *filling_slots[kScanWindow]{};  // receive callback only
+  uint16_t newest_scan_frame = 0;         // receive callback only
+  bool have_scan_frame = false;
+  uint16_t ping_seq = 0;
+  ScanStats scan_stats;
+  MotionState motion;
+  PoseState pose;
+  AttitudeState attitude;
+  LinkMonitor link;
+  ScanComposite composite;
+};
+
+enum UsbTxKind : uint8_t
+{
+  kUsbTxText,
+  kUsbTxScan,   // a newer scan supersedes queued ones
+  kUsbTxState,
+};
+
+// Byte positions only grow; the ring index is position % kUsbTxRingBytes.
+// Records are contiguous, oldest first. Only the oldest can be partly sent,
+// and it is always finished so the host never sees half a record.
+struct UsbTxRecord
+{
+  uint32_t start;
+  uint32_t end;
+  uint8_t kind;
+  bool dropped;
+};
+
+struct UsbTxRing
+{
+  uint8_t bytes[kUsbTxRingBytes];
+  UsbTxRecord records[kUsbTxMaxRecords];
+  uint8_t first = 0;
+  uint8_t count = 0;
+  uint32_t send_pos = 0;
+  uint32_t write_pos = 0;
+  uint32_t open_start = 0;
+  uint8_t open_kind = kUsbTxText;
+  bool open = false;
+  bool open_failed = false;
+  uint32_t scans_dropped = 0;
+  uint32_t other_dropped = 0;
+};
+
 Adafruit_NeoPixel status_led(1, kLedPin, NEO_GRB + NEO_KHZ800);
-esp_now_peer_info_t bot_peer = {};
+BotLink bots[kMaxBots];
+std::atomic<uint8_t> bot_count{0};  // bots[] is filled before this is raised
+uint8_t selected_bot = 0;  // target of text keys
+bool bot_select_pending = false;  // '@' seen, digit next
 
 volatile bool activity_flag = false;
 uint32_t led_base_color = 0;
 unsigned long led_flash_end = 0;
 
-char current_mode = 'x';
 char held_cmd = 'x';
 char last_sent_cmd = 0;
 unsigned long last_send_time = 0;
 unsigned long last_handshake_time = 0;
-String cmd_buf;
+unsigned long last_ping_time = 0;
+unsigned long last_link_report_time = 0;
+volatile uint8_t background_in_flight = 0;  // pings and beacons
+Preferences fleet_store;
+portMUX_TYPE pair_mux = portMUX_INITIALIZER_UNLOCKED;
+uint8_t pair_request_mac[6]{};  // set by the receive callback
+bool pair_request_pending = false;
+unsigned long pair_window_end = 0;
+unsigned long last_beacon_time = 0;
+char motor_line[kMotorLineMaxChars + 1];  // "Lf200" being typed
+uint8_t motor_line_len = 0;
+uint8_t usb_command[kUsbCommandMaxBytes];  // COBS bytes of a binary command
+uint8_t usb_command_len = 0;
+bool usb_command_open = false;
+bool usb_binary = false;
+bool composite_scans = false;
+
+// One encoded record at a time, delimiters included. A full scan is the
+// largest record.
+constexpr size_t kUsbRecordMaxBytes = 4 + 4 + kTelemetryMaxScanPoints * sizeof(TelemetryPoint) + 2;
+uint8_t usb_frame[kUsbRecordMaxBytes + kUsbRecordMaxBytes / 254 + 3];
+
+ScanSlot scan_slots[kScanSlots];
+uint32_t scan_ready_seq = 0;
+float bin_cos[kTelemetryAngleBins];
+float bin_sin[kTelemetryAngleBins];
+UsbTxRing usb_tx_ring;
+
+void count_usb_drop(uint8_t kind)
+{
+  if (kind == kUsbTxScan)
+  {
+    ++usb_tx_ring.scans_dropped;
+  }
+  else
+  {
+    ++usb_tx_ring.other_dropped;
+  }
+}
+
+// Discards the oldest queued record to make room. Returns false if there is
+// none, or it is already on its way out.
+bool drop_oldest_usb_record()
+{
+  UsbTxRing &ring = usb_tx_ring;
+  if (ring.count == 0)
+  {
+    return false;
+  }
+  UsbTxRecord &oldest = ring.records[ring.first];
+  if (!oldest.dropped)
+  {
+    if (ring.send_pos != oldest.start)
+    {
+      return false;
+    }
+    count_usb_drop(oldest.kind);
+  }
+  ring.send_pos = oldest.end;
+  ring.first = (ring.first + 1) % kUsbTxMaxRecords;
+  --ring.count;
+  return true;
+}
+
+void usb_tx_end();
+
+void usb_tx_begin(uint8_t kind)
+{
+  UsbTxRing &ring = usb_tx_ring;
+  if (ring.open)
+  {
+    usb_tx_end();
+  }
+
+  if (kind == kUsbTxScan)
+  {
+    for (uint8_t i = 0; i < ring.count; ++i)
+    {
+      UsbTxRecord &record = ring.records[(ring.first + i) % kUsbTxMaxRecords];
+      const bool sending = i == 0 && ring.send_pos != record.start;
+      if (record.kind == kUsbTxScan && !record.dropped && !sending)
+      {
+        record.dropped = true;
+        count_usb_drop(kUsbTxScan);
+      }
+    }
+  }
+
+  ring.open = true;
+  ring.open_failed = false;
+  ring.open_start = ring.write_pos;
+  ring.open_kind = kind;
+}
+
+void usb_tx_put(const uint8_t *data, size_t len)
+{
+  UsbTxRing &ring = usb_tx_ring;
+  if (!ring.open)
+  {
+    usb_tx_begin(kUsbTxText);
+  }
+  if (ring.open_failed)
+  {
+    return;
+  }
+
+  while (kUsbTxRingBytes - (ring.write_pos - ring.send_pos) < len)
+  {
+    if (!drop_oldest_usb_record())
+    {
+      // Even an empty ring cannot take it: give up on this record.
+      ring.open_failed = true;
+      ring.write_pos = ring.open_start;
+      return;
+    }
+  }
+
+  for (size_t i = 0; i < len; ++i)
+  {
+    ring.bytes[ring.write_pos++ % kUsbTxRingBytes] = data[i];
+  }
+
+  // Plain prints are one line per record.
+  if (ring.open_kind == kUsbTxText && len > 0 && data[len - 1] == '\n')
+  {
+    usb_tx_end();
+  }
+}
+
+void usb_tx_end()
+{
+  UsbTxRing &ring = usb_tx_ring;
+  if (!ring.open)
+  {
+    return;
+  }
+  ring.open = false;
+
+  if (!ring.open_failed && ring.count == kUsbTxMaxRecords && !drop_oldest_usb_record())
+  {
+    ring.open_failed = true;
+    ring.write_pos = ring.open_start;
+  }
+  if (ring.open_failed)
+  {
+    count_usb_drop(ring.open_kind);
+    return;
+  }
+  if (ring.write_pos == ring.open_start)
+  {
+    return;
+  }
+
+  ring.records[(ring.first + ring.count) % kUsbTxMaxRecords] =
+      UsbTxRecord{ring.open_start, ring.write_pos, ring.open_kind, false};
+  ++ring.count;
+}
+
+// Writes what the CDC buffer has room for. Never blocks.
+void pump_usb_tx()
+{
+  UsbTxRing &ring = usb_tx_ring;
+  while (ring.count > 0)
+  {
+    UsbTxRecord &oldest = ring.records[ring.first];
+    if (!oldest.dropped)
+    {
+      const int room = Serial.availableForWrite();
+      if (room <= 0)
+      {
+        return;
+      }
+      const size_t index = ring.send_pos % kUsbTxRingBytes;
+      const size_t len = min<size_t>(min<size_t>(oldest.end - ring.send_pos, static_cast<size_t>(room)),
+                                     kUsbTxRingBytes - index);
+      const size_t written = Serial.write(&ring.bytes[index], len);
+      ring.send_pos += written;
+      if (ring.send_pos != oldest.end)
+      {
+        if (written < len)
+        {
+          return;
+        }
+        continue;
+      }
+    }
+    ring.send_pos = oldest.end;
+    ring.first = (ring.first + 1) % kUsbTxMaxRecords;
+    --ring.count;
+  }
+}
+
+// Print front end for the ring: usb_tx.printf() and friends queue a line.
+class UsbTxStream : public Print
+{
+ public:
+  size_t write(uint8_t value) override
+  {
+    usb_tx_put(&value, 1);
+    return 1;
+  }
+
+  size_t write(const uint8_t *data, size_t len) override
+  {
+    usb_tx_put(data, len);
+    return len;
+  }
+};
+
+UsbTxStream usb_tx;
+
+void set_led_color(uint8_t r, uint8_t g, uint8_t b)
+{
+  status_led.setPixelColor(0, status_led.Color(r, g, b));
+  status_led.show();
+}
+
+void led_error()
+{
+  led_base_color = status_led.Color(200, 0, 0);
+  set_led_color(200, 0, 0);
+}
+
+void led_waiting()
+{
+  led_base_color = status_led.Color(200, 100, 0);
+  set_led_color(200, 100, 0);
+}
+
+void trigger_activity()
+{
+  activity_flag = true;
+}
+
+void update_led()
+{
+  if (activity_flag)
+  {
+    activity_flag = false;
+    if (led_base_color != status_led.Color(200, 0, 0))
+    {
+      led_base_color = status_led.Color(0, 200, 0);
+    }
+    led_flash_end = millis() + 300;
+    set_led_color(0, 0, 200);
+  }
+  else if (millis() > led_flash_end)
+  {
+    const uint8_t r = (led_base_color >> 16) & 0xFF;
+    const uint8_t g = (led_base_color >> 8) & 0xFF;
+    const uint8_t b = led_base_color & 0xFF;
+    static uint32_t last_shown = 0xFFFFFFFF;
+    if (led_base_color != last_shown)
+    {
+      set_led_color(r, g, b);
+      last_shown = led_base_color;
+    }
+  }
+}
+
+void setup_led()
+{
+  status_led.begin();
+  status_led.setBrightness(40);
+  led_waiting();
+}
+
+void setup_angle_table()
+{
+  for (uint16_t bin = 0; bin < kTelemetryAngleBins; ++bin)
+  {
+    const float angle_rad = bin * (TWO_PI / kTelemetryAngleBins);
+    bin_cos[bin] = cosf(angle_rad);
+    bin_sin[bin] = sinf(angle_rad);
+  }
+}
+
+// Claims a slot for a new frame. When loop() is behind and every slot is
+// taken, the oldest scan it has not started on is recycled.
+ScanSlot *claim_scan_slot()
+{
+  for (ScanSlot &slot : scan_slots)
+  {
+    uint8_t expected = kSlotFree;
+    if (slot.state.compare_exchange_strong(expected, kSlotFilling, std::memory_order_acquire))
+    {
+      return &slot;
+    }
+  }
+
+  ScanSlot *oldest = nullptr;
+  for (ScanSlot &slot : scan_slots)
+  {
+    if (slot.state.load(std::memory_order_acquire) == kSlotReady &&
+        (oldest == nullptr || static_cast<int32_t>(slot.ready_seq - oldest->ready_seq) < 0))
+    {
+      oldest = &slot;
+    }
+  }
+  uint8_t expected = kSlotReady;
+  if (oldest != nullptr &&
+      oldest->state.compare_exchange_strong(expected, kSlotFilling, std::memory_order_acquire))
+  {
+    ++bots[oldest->bot].scan_stats.overwritten;
+    return oldest;
+  }
+  return nullptr;
+}
+
+uint8_t full_chunk_mask(uint8_t chunk_count)
+{
+  return static_cast<uint8_t>((1U << chunk_count) - 1);
+}
+
+// v1 chunks land at fixed offsets; closes the gaps left by missing ones.
+void compact_v1_scan(ScanSlot &slot)
+{
+  uint16_t count = 0;
+  for (uint8_t i = 0; i < slot.chunk_count; ++i)
+  {
+    const uint16_t offset = i * kTelemetryPointsPerChunk;
+    if (((slot.chunk_mask >> i) & 1) == 0 || offset >= slot.total_points)
+    {
+      continue;
+    }
+    const uint16_t n = min<uint16_t>(kTelemetryPointsPerChunk, slot.total_points - offset);
+    memmove(&slot.points[count], &slot.points[offset], n * sizeof(TelemetryPoint));
+    count += n;
+  }
+  slot.total_points = count;
+}
+
+// The bot sends its pose ahead of the scan's bulk chunks, so the freshest
+// pose at publish time belongs to this scan.
+void stamp_scan_pose(const BotLink &bot, ScanSlot &slot, unsigned long now)
+{
+  slot.pose = ScanPose{};
+  if (bot.pose.received_ms != 0 && now - bot.pose.received_ms < kCompositePoseFreshMs)
+  {
+    slot.pose.x_mm = static_cast<float>(bot.pose.packet.x_mm);
+    slot.pose.y_mm = static_cast<float>(bot.pose.packet.y_mm);
+    slot.pose.theta_rad = bot.pose.packet.theta_mrad / 1000.0f;
+    slot.pose.source = kPoseOdometry;
+  }
+  else if (bot.attitude.received_ms != 0 && now - bot.attitude.received_ms < kCompositePoseFreshMs)
+  {
+    slot.pose.theta_rad = bot.attitude.packet.yaw_cdeg * (static_cast<float>(M_PI) / 18000.0f);
+    slot.pose.source = kPoseAttitude;
+  }
+}
+
+// Hands a frame to loop(), complete or not. The release store makes the
+// points visible before the state change.
+void publish_scan(BotLink &bot, uint8_t window_index)
+{
+  ScanSlot &slot = *bot.filling_slots[window_index];
+  bot.filling_slots[window_index] = nullptr;
+
+  if (slot.version == 1 && slot.chunk_mask != full_chunk_mask(slot.chunk_count))
+  {
+    compact_v1_scan(slot);
+  }
+
+  if (slot.total_points == 0)
+  {
+    ++bot.scan_stats.dropped;
+    slot.state.store(kSlotFree, std::memory_order_release);
+    return;
+  }
+
+  if (slot.chunk_mask == full_chunk_mask(slot.chunk_count))
+  {
+    ++bot.scan_stats.complete;
+  }
+  else
+  {
+    ++bot.scan_stats.partial;
+  }
+  stamp_scan_pose(bot, slot, millis());
+  slot.ready_seq = ++scan_ready_seq;
+  slot.state.store(kSlotReady, std::memory_order_release);
+}
+
+// Publishes frames that have waited too long for their missing chunks. Runs
+// on every received packet; pongs alone arrive every kPingIntervalMs.
+void expire_scans(unsigned long now)
+{
+  for (uint8_t b = 0; b < bot_count; ++b)
+  {
+    BotLink &bot = bots[b];
+    for (uint8_t i = 0; i < kScanWindow; ++i)
+    {
+      if (bot.filling_slots[i] != nullptr &&
+          now - bot.filling_slots[i]->first_chunk_ms >= kScanPartialTimeoutMs)
+      {
+        publish_scan(bot, i);
+      }
+    }
+  }
+}
+
+// Returns the slot assembling this frame, starting a new one if needed.
+// Starting a frame when the window is full publishes the oldest one.
+// Returns nullptr for chunks of frames already published.
+ScanSlot *scan_slot_for(BotLink &bot, uint8_t version, uint16_t frame_id, uint8_t chunk_count, uint16_t total_points)
+{
+  uint8_t free_index = kScanWindow;
+  uint8_t oldest_index = kScanWindow;
+  for (uint8_t i = 0; i < kScanWindow; ++i)
+  {
+    ScanSlot *slot = bot.filling_slots[i];
+    if (slot == nullptr)
+    {
+      free_index = free_index == kScanWindow ? i : free_index;
+      continue;
+    }
+    if (slot->frame_id == frame_id)
+    {
+      if (slot->version == version &&
+          slot->chunk_count == chunk_count &&
+          (version != 1 || slot->total_points == total_points))
+      {
+        return slot;
+      }
+      // Same id, different shape: the bot restarted. Start over.
+      publish_scan(bot, i);
+      free_index = i;
+      continue;
+    }
+    if (oldest_index == kScanWindow ||
+        static_cast<int16_t>(slot->frame_id - bot.filling_slots[oldest_index]->frame_id) < 0)
+    {
+      oldest_index = i;
+    }
+  }
+
+  // Frames just behind the newest one seen and not in the window have gone.
+  // Anything further back is a bot restart, not a late chunk.
+  const int16_t age = static_cast<int16_t>(bot.newest_scan_frame - frame_id);
+  if (bot.have_scan_frame && age > 0 && age <= 8)
+  {
+    ++bot.scan_stats.late;
+    return nullptr;
+  }
+
+  if (free_index == kScanWindow)
+  {
+    publish_scan(bot, oldest_index);
+    free_index = oldest_index;
+  }
+
+  ScanSlot *slot = claim_scan_slot();
+  if (slot == nullptr)
+  {
+    return nullptr;
+  }
+
+  slot->bot = static_cast<uint8_t>(&bot - bots);
+  slot->version = version;
+  slot->frame_id = frame_id;
+  slot->chunk_count = min(chunk_count, kTelemetryMaxChunks);
+  slot->total_points = min(total_points, kTelemetryMaxScanPoints);
+  slot->chunk_mask = 0;
+  slot->first_chunk_ms = millis();
+  bot.filling_slots[free_index] = slot;
+  bot.newest_scan_frame = frame_id;
+  bot.have_scan_frame = true;
+  return slot;
+}
+
+// Records a chunk and publishes the frame once all chunks are in.
+void note_scan_chunk(BotLink &bot, ScanSlot &slot, uint8_t chunk_index)
+{
+  slot.chunk_mask |= static_cast<uint8_t>(1U << chunk_index);
+  if (slot.chunk_mask != full_chunk_mask(slot.chunk_count))
+  {
+    return;
+  }
+
+  for (uint8_t i = 0; i < kScanWindow; ++i)
+  {
+    if (bot.filling_slots[i] == &slot)
+    {
+      publish_scan(bot, i);
+      return;
+    }
+  }
+}
+
+void handle_scan_chunk_v1(BotLink &bot, const uint8_t *data, int len)
+{
+  if (len < static_cast<int>(sizeof(TelemetryHeader)))
+  {
+    return;
+  }
+
+  TelemetryHeader header;
+  memcpy(&header, data, sizeof(header));
+
+  if (header.chunk_count == 0 ||
+      header.chunk_count > kTelemetryMaxChunks ||
+      header.total_points == 0 ||
+      header.total_points > kTelemetryMaxPoints ||
+      header.chunk_index >= header.chunk_count ||
+      header.point_count > kTelemetryPointsPerChunk)
+  {
+    return;
+  }
+
+  const int expected_len =
+      static_cast<int>(sizeof(TelemetryHeader) +
+                       header.point_count * sizeof(TelemetryPoint));
+  if (len != expected_len)
+  {
+    return;
+  }
+
+  ScanSlot *slot = scan_slot_for(bot, 1, header.frame_id, header.chunk_count, header.total_points);
+  if (slot == nullptr)
+  {
+    return;
+  }
+
+  const uint8_t point_offset = header.chunk_index * kTelemetryPointsPerChunk;
+  if (point_offset + header.point_count > slot->total_points)
+  {
+    return;
+  }
+
+  memcpy(&slot->points[point_offset],
+         data + sizeof(TelemetryHeader),
+         header.point_count * sizeof(TelemetryPoint));
+  note_scan_chunk(bot, *slot, header.chunk_index);
+}
+
+// Decodes one v2 point stream into drawable points. Returns the number of
+// points written, or -1 if the stream is malformed.
+int decode_scan_points(const uint8_t *data,
+                       size_t len,
+                       uint16_t bin,
+                       uint8_t stride,
+                       TelemetryPoint *out,
+                       PointCell *cells,
+                       uint16_t capacity)
+{
+  uint16_t count = 0;
+  return scan_decode::decode_points(
+      data, len, bin, stride, kTelemetryAngleBins, kTelemetryMaxBinStride, capacity,
+      [&](uint16_t point_bin, uint8_t point_stride, int32_t dist_q, uint8_t intensity)
+      {
+        // A point covering several bins is drawn at their middle.
+        const uint16_t centre = point_bin + point_stride / 2;
+        const float dist_mm = static_cast<float>(dist_q * kTelemetryDistQuantumMm);
+        out[count].x_mm = static_cast<int16_t>(lroundf(dist_mm * bin_cos[centre]));
+        out[count].y_mm = static_cast<int16_t>(lroundf(dist_mm * bin_sin[centre]));
+        out[count].intensity = static_cast<uint8_t>((intensity << 4) | 0x08);
+        cells[count] = PointCell{point_bin, point_stride};
+        ++count;
+      });
+}
+
+void handle_scan_chunk_v2(BotLink &bot, const uint8_t *data, int len)
+{
+  if (len < static_cast<int>(sizeof(ScanChunkHeader)))
+  {
+    return;
+  }
+
+  ScanChunkHeader header;
+  memcpy(&header, data, sizeof(header));
+
+  if (header.chunk_count == 0 ||
+      header.chunk_count > kTelemetryMaxChunks ||
+      header.chunk_index >= header.chunk_count ||
+      header.bin_stride == 0 ||
+      header.bin_stride > kTelemetryMaxBinStride)
+  {
+    return;
+  }
+
+  ScanSlot *slot = scan_slot_for(bot, 2, header.frame_id, header.chunk_count, 0);
+  if (slot == nullptr || (slot->chunk_mask >> header.chunk_index) & 1)
+  {
+    return;
+  }
+
+  // Chunks decode independently, so points are appended in arrival order,
+  // straight into the slot that will be streamed out.
+  const int decoded = decode_scan_points(data + sizeof(header),
+                                         len - sizeof(header),
+                                         header.start_bin,
+                                         header.bin_stride,
+                                         &slot->points[slot->total_points],
+                                         &slot->cells[slot->total_points],
+                                         kTelemetryMaxScanPoints - slot->total_points);
+  if (decoded != header.point_count)
+  {
+    return;
+  }
+
+  slot->total_points += decoded;
+  note_scan_chunk(bot, *slot, header.chunk_index);
+}
+
+void handle_scan_chunk(BotLink &bot, const uint8_t *data, int len)
+{
+  if (data[1] == 1)
+  {
+    handle_scan_chunk_v1(bot, data, len);
+  }
+  else
+  {
+    handle_scan_chunk_v2(bot, data, len);
+  }
+}
+
+void handle_motion_packet(BotLink &bot, const uint8_t *data, int len)
+{
+  if (len != static_cast<int>(sizeof(MotionTelemetry)))
+  {
+    return;
+  }
+
+  MotionTelemetry packet;
+  memcpy(&packet, data, sizeof(packet));
+  if (packet.magic != kTelemetryMagic ||
+      packet.type != kTelemetryTypeMotion)
+  {
+    return;
+  }
+
+  const bool dodging = (packet.flags & 0x01) != 0;
+  const bool wall_follow_left = (packet.flags & 0x02) != 0;
+  MotionState &motion = bot.motion;
+  const bool changed = motion.mode != packet.mode ||
+                       motion.direction != packet.direction ||
+                       motion.dodging != dodging ||
+                       motion.wall_follow_left != wall_follow_left;
+  if (!changed)
+  {
+    return;
+  }
+
+  motion.mode = packet.mode;
+  motion.direction = packet.direction;
+  motion.dodging = dodging;
+  motion.wall_follow_left = wall_follow_left;
+  motion.pending = true;
+}
+
+void handle_pose_packet(BotLink &bot, const uint8_t *data, int len)
+{
+  if (len != static_cast<int>(sizeof(PoseTelemetry)))
+  {
+    return;
+  }
+
+  memcpy(&bot.pose.packet, data, sizeof(bot.pose.packet));
+  bot.pose.received_ms = millis();
+  bot.pose.pending = true;
+}
+
+void handle_attitude_packet(BotLink &bot, const uint8_t *data, int len)
+{
+  if (len != static_cast<int>(sizeof(AttitudeTelemetry)))
+  {
+    return;
+  }
+
+  memcpy(&bot.attitude.packet, data, sizeof(bot.attitude.packet));
+  bot.attitude.received_ms = millis();
+  bot.attitude.pending = true;
+}
+
+void handle_pong_packet(BotLink &bot, const uint8_t *data, int len)
+{
+  if (len != static_cast<int>(sizeof(LinkPing)))
+  {
+    return;
+  }
+
+  LinkPing pong;
+  memcpy(&pong, data, sizeof(pong));
+  PingSlot &slot = bot.link.slots[pong.seq % kPingSlots];
+  if (slot.state != kPingWaiting || slot.seq != pong.seq)
+  {
+    return;  // timed out already
+  }
+  slot.rtt_us = micros() - pong.sent_us;
+  slot.bot_rssi = pong.rssi;
+  slot.state = kPingAnswered;
+}
+
+void note_rssi(BotLink &bot, const esp_now_recv_info *info)
+{
+  if (info->rx_ctrl == nullptr)
+  {
+    return;
+  }
+  const int16_t rssi_q4 = static_cast<int16_t>(info->rx_ctrl->rssi) * 16;
+  const int16_t current = bot.link.rssi_q4;
+  bot.link.rssi_q4 = current == 0 ? rssi_q4 : current + (rssi_q4 - current) / 8;
+}
+
+// Returns the fleet entry for a sender, or nullptr for a MAC not in the fleet.
+BotLink *find_bot(const uint8_t *mac)
+{
+  for (uint8_t i = 0; i < bot_count; ++i)
+  {
+    if (memcmp(bots[i].peer.peer_addr, mac, 6) == 0)
+    {
+      return &bots[i];
+    }
+  }
+  return nullptr;
+}
+
+void on_data_sent(const wifi_tx_info_t *info, esp_now_send_status_t status)
+{
+  (void)info;
+  if (background_in_flight > 0)
+  {
+    // Pings and beacons are background traffic; keep the LED for real commands.
+    // Callbacks come back in send order.
+    background_in_flight = background_in_flight - 1;
+    return;
+  }
+  if (status == ESP_NOW_SEND_SUCCESS)
+  {
+    trigger_activity();
+  }
+}
+
+void on_data_recv(const esp_now_recv_info *info, const uint8_t *data, int len)
+{
+  expire_scans(millis());
+  if (info == nullptr || info->src_addr == nullptr)
+  {
+    return;
+  }
+  if (len == static_cast<int>(sizeof(PairRequest)) && data[0] == kTelemetryMagic &&
+      data[1] == kPairingVersion && data[2] == kTelemetryTypePairRequest)
+  {
+    // Peers are only added from loop(); a second request in the same pass
+    // is dropped and the bot asks again on the next beacon.
+    portENTER_CRITICAL(&pair_mux);
+    if (!pair_request_pending)
+    {
+      memcpy(pair_request_mac, info->src_addr, sizeof(pair_request_mac));
+      pair_request_pending = true;
+    }
+    portEXIT_CRITICAL(&pair_mux);
+    return;
+  }
+
+  BotLink *bot = find_bot(info->src_addr);
+  if (bot == nullptr)
+  {
+    return;
+  }
+  note_rssi(*bot, info);
+  if (len < 3)
+  {
+    return;
+  }
+  if (data[0] != kTelemetryMagic ||
+      data[1] < kTelemetryMinVersion ||
+      data[1] > kTelemetryVersion)
+  {
+    return;
+  }
+
+  if (data[2] == kTelemetryTypeScanChunk)
+  {
+    handle_scan_chunk(*bot, data, len);
+  }
+  else if (data[2] == kTelemetryTypeMotion)
+  {
+    handle_motion_packet(*bot, data, len);
+  }
+  else if (data[2] == kTelemetryTypePose)
+  {
+    handle_pose_packet(*bot, data, len);
+  }
+  else if (data[2] == kTelemetryTypeAttitude)
+  {
+    handle_attitude_packet(*bot, data, len);
+  }
+  else if (data[2] == kTelemetryTypePong)
+  {
+    handle_pong_packet(*bot, data, len);
+  }
+}
+
+void send_raw(const BotLink &bot, const uint8_t *data, size_t len, bool log_text, bool track_command)
+{
+  if (esp_now_send(bot.peer.peer_addr, data, len) == ESP_OK)
+  {
+    if (log_text)
+    {
+      usb_tx.printf("-> %c\n", static_cast<char>(data[0]));
+    }
+  }
+  else if (log_text)
+  {
+    usb_tx.printf("-> %c FAILED\n", static_cast<char>(data[0]));
+  }
+
+  last_send_time = millis();
+  if (track_command && len == 1)
+  {
+    last_sent_cmd = static_cast<char>(data[0]);
+  }
+}
+
+// Text keys go to the selected bot.
+void send_cmd(char cmd)
+{
+  const uint8_t buf[1] = {static_cast<uint8_t>(cmd)};
+  send_raw(bots[selected_bot], buf, sizeof(buf), true, true);
+}
+
+void send_viewer_handshake()
+{
+  const uint8_t buf[1] = {'v'};
+  for (uint8_t i = 0; i < bot_count; ++i)
+  {
+    send_raw(bots[i], buf, sizeof(buf), false, false);
+  }
+}
+
+void record_ping_outcome(LinkMonitor &link, bool lost)
+{
+  link.lost_bits = (link.lost_bits << 1) | (lost ? 1 : 0);
+  if (link.resolved < 64)
+  {
+    ++link.resolved;
+  }
+  if (lost)
+  {
+    ++link.lost;
+  }
+}
+
+// Moves a finished ping into the statistics and frees its slot.
+void resolve_ping(LinkMonitor &link, PingSlot &slot)
+{
+  if (slot.state == kPingAnswered)
+  {
+    link.rtt_us[link.rtt_head] = slot.rtt_us;
+    link.rtt_head = (link.rtt_head + 1) % kLinkRttWindow;
+    if (link.rtt_count < kLinkRttWindow)
+    {
+      ++link.rtt_count;
+    }
+    link.bot_rssi = slot.bot_rssi;
+    record_ping_outcome(link, false);
+  }
+  else
+  {
+    record_ping_outcome(link, true);
+  }
+  slot.state = kPingFree;
+}
+
+void update_link_monitor(unsigned long now)
+{
+  for (uint8_t i = 0; i < bot_count; ++i)
+  {
+    LinkMonitor &link = bots[i].link;
+    for (PingSlot &slot : link.slots)
+    {
+      if (slot.state == kPingAnswered ||
+          (slot.state == kPingWaiting && now - slot.sent_ms >= kPingTimeoutMs))
+      {
+        resolve_ping(link, slot);
+      }
+    }
+  }
+}
+
+// Round-trip probe. Commands are sent straight from loop(), never behind
+// telemetry, and the bot echoes pings ahead of its own queue, so the RTT is
+// what a command sees under the current scan load.
+void send_ping(BotLink &bot)
+{
+  const LinkPing ping{
+      kTelemetryMagic,
+      kTelemetryVersion,
+      kTelemetryTypePing,
+      ++bot.ping_seq,
+      static_cast<uint32_t>(micros()),
+      0,
+  };
+
+  PingSlot &slot = bot.link.slots[bot.ping_seq % kPingSlots];
+  if (slot.state != kPingFree)
+  {
+    resolve_ping(bot.link, slot);
+  }
+  slot.seq = bot.ping_seq;
+  slot.sent_ms = millis();
+  slot.state = kPingWaiting;
+  ++bot.link.pings;
+
+  // Not through send_raw(): a ping must not count as a teleop keepalive.
+  background_in_flight = background_in_flight + 1;
+  if (esp_now_send(bot.peer.peer_addr, reinterpret_cast<const uint8_t *>(&ping), sizeof(ping)) != ESP_OK)
+  {
+    background_in_flight = background_in_flight - 1;
+  }
+}
+
+void send_motor_cmd(const char *line, uint8_t len)
+{
+  if (len < 2)
+  {
+    return;
+  }
+
+  const char motor = line[0];
+  const char dir = line[1];
+  if ((motor != 'L' && motor != 'R') ||
+      (dir != 'f' && dir != 'b' && dir != 's'))
+  {
+    return;
+  }
+
+  int pwm = 0;
+  for (uint8_t i = 2; i < len && line[i] >= '0' && line[i] <= '9'; ++i)
+  {
+    pwm = min(pwm * 10 + (line[i] - '0'), 255);
+  }
+  if (dir == 's')
+  {
+    pwm = 0;
+  }
+
+  const uint8_t buf[3] = {
+      static_cast<uint8_t>(motor),
+      static_cast<uint8_t>(dir),
+      static_cast<uint8_t>(pwm),
+  };
+
+  if (esp_now_send(bots[selected_bot].peer.peer_addr, buf, sizeof(buf)) == ESP_OK)
+  {
+    usb_tx.printf("-> Motor %c %c PWM %d\n", motor, dir, pwm);
+  }
+  else
+  {
+    usb_tx.println("-> Motor cmd FAILED");
+  }
+}
+
+void print_json_scan(const ScanSlot &scan)
+{
+  usb_tx_begin(kUsbTxScan);
+  usb_tx.printf("{\"t\":\"scan\",\"bot\":%u,\"frame\":%u,\"chunks\":%u,\"mask\":%u,\"x\":[",
+                static_cast<unsigned>(scan.bot),
+                static_cast<unsigned>(scan.frame_id),
+                static_cast<unsigned>(scan.chunk_count),
+                static_cast<unsigned>(scan.chunk_mask));
+  for (uint16_t i = 0; i < scan.total_points; ++i)
+  {
+    if (i > 0)
+    {
+      usb_tx.print(',');
+    }
+    usb_tx.print(scan.points[i].x_mm);
+  }
+
+  usb_tx.print(F("],\"y\":["));
+  for (uint16_t i = 0; i < scan.total_points; ++i)
+  {
+    if (i > 0)
+    {
+      usb_tx.print(',');
+    }
+    usb_tx.print(scan.points[i].y_mm);
+  }
+
+  usb_tx.print(F("],\"i\":["));
+  for (uint16_t i = 0; i < scan.total_points; ++i)
+  {
+    if (i > 0)
+    {
+      usb_tx.print(',');
+    }
+    usb_tx.print(scan.points[i].intensity);
+  }
+
+  usb_tx.println(F("]}"));
+  usb_tx_end();
+}
+
+void print_json_motion(uint8_t bot, const MotionState &motion)
+{
+  usb_tx_begin(kUsbTxState);
+  usb_tx.printf("{\"t\":\"motion\",\"bot\":%u,\"mode\":\"", static_cast<unsigned>(bot));
+  usb_tx.print(motion.mode);
+  usb_tx.print(F("\",\"dir\":\""));
+  usb_tx.print(motion.direction);
+  usb_tx.print(F("\",\"dodging\":"));
+  usb_tx.print(motion.dodging ? F("true") : F("false"));
+  usb_tx.print(F(",\"wall_side\":\""));
+  usb_tx.print(motion.wall_follow_left ? F("left") : F("right"));
+  usb_tx.println(F("\"}"));
+  usb_tx_end();
+}
+
+void print_json_pose(uint8_t bot, const PoseTelemetry &pose)
+{
+  usb_tx.printf("{\"t\":\"pose\",\"bot\":%u,\"x\":%.3f,\"y\":%.3f,\"th\":%.3f,\"sx\":%.3f,\"sy\":%.3f,\"sth\":%.3f}\n",
+                static_cast<unsigned>(bot),
+                pose.x_mm / 1000.0f,
+                pose.y_mm / 1000.0f,
+                pose.theta_mrad / 1000.0f,
+                pose.sigma_x_mm / 1000.0f,
+                pose.sigma_y_mm / 1000.0f,
+                pose.sigma_theta_mrad / 1000.0f);
+}
+
+void print_json_attitude(uint8_t bot, const AttitudeTelemetry &attitude)
+{
+  usb_tx.printf("{\"t\":\"attitude\",\"bot\":%u,\"q\":[%.4f,%.4f,%.4f,%.4f],\"yaw\":%.2f,\"rate\":%.2f}\n",
+                static_cast<unsigned>(bot),
+                attitude.quat_q14[0] / 16384.0f,
+                attitude.quat_q14[1] / 16384.0f,
+                attitude.quat_q14[2] / 16384.0f,
+                attitude.quat_q14[3] / 16384.0f,
+                attitude.yaw_cdeg / 100.0f,
+                attitude.yaw_rate_cdps / 100.0f);
+}
+
+void summarise_link(const LinkMonitor &link, LinkSummary &summary)
+{
+  // Insertion sort of at most kLinkRttWindow samples, once a second.
+  uint32_t sorted[kLinkRttWindow];
+  const uint8_t n = link.rtt_count;
+  for (uint8_t i = 0; i < n; ++i)
+  {
+    uint32_t value = link.rtt_us[i];
+    uint8_t j = i;
+    for (; j > 0 && sorted[j - 1] > value; --j)
+    {
+      sorted[j] = sorted[j - 1];
+    }
+    sorted[j] = value;
+  }
+  auto percentile = [&](uint8_t pct) -> uint32_t {
+    return n == 0 ? 0 : sorted[(n - 1) * pct / 100];
+  };
+
+  uint8_t lost = 0;
+  for (uint8_t i = 0; i < link.resolved; ++i)
+  {
+    lost += (link.lost_bits >> i) & 1;
+  }
+
+  summary.samples = n;
+  summary.p50_us = percentile(50);
+  summary.p90_us = percentile(90);
+  summary.p99_us = percentile(99);
+  summary.max_us = percentile(100);
+  summary.loss_permille =
+      link.resolved > 0 ? static_cast<uint16_t>(lost * 1000U / link.resolved) : 0;
+  summary.pings = link.pings;
+  summary.lost = link.lost;
+  summary.rssi = static_cast<int8_t>(link.rssi_q4 / 16);
+  summary.bot_rssi = link.bot_rssi;
+}
+
+void print_json_link(uint8_t bot, const LinkSummary &link)
+{
+  usb_tx.printf("{\"t\":\"link\",\"bot\":%u,\"n\":%u,\"p50_us\":%lu,\"p90_us\":%lu,\"p99_us\":%lu,\"max_us\":%lu,"
+                "\"loss\":%.3f,\"pings\":%lu,\"lost\":%lu,\"rssi\":%d,\"bot_rssi\":%d}\n",
+                static_cast<unsigned>(bot),
+                static_cast<unsigned>(link.samples),
+                static_cast<unsigned long>(link.p50_us),
+                static_cast<unsigned long>(link.p90_us),
+                static_cast<unsigned long>(link.p99_us),
+                static_cast<unsigned long>(link.max_us),
+                link.loss_permille / 1000.0f,
+                static_cast<unsigned long>(link.pings),
+                static_cast<unsigned long>(link.lost),
+                static_cast<int>(link.rssi),
+                static_cast<int>(link.bot_rssi));
+}
+
+// Streams a record into usb_frame: CRC and COBS are computed as the bytes
+// are added, so payloads are read in place rather than gathered first.
+struct UsbRecordWriter
+{
+  size_t out = 0;
+  size_t code_pos = 0;
+  uint8_t code = 1;
+  uint16_t crc = 0xFFFF;
+  uint8_t type = 0;
+};
+UsbRecordWriter usb_writer;
+
+void encode_usb_byte(uint8_t value)
+{
+  if (value != 0)
+  {
+    usb_frame[usb_writer.out++] = value;
+    ++usb_writer.code;
+  }
+  if (value == 0 || usb_writer.code == 0xFF)
+  {
+    usb_frame[usb_writer.code_pos] = usb_writer.code;
+    usb_writer.code_pos = usb_writer.out++;
+    usb_writer.code = 1;
+  }
+}
+
+// CRC-16/CCITT-FALSE, one byte at a time; start from 0xFFFF.
+uint16_t crc16_update(uint16_t crc, uint8_t value)
+{
+  crc ^= static_cast<uint16_t>(value) << 8;
+  for (uint8_t bit = 0; bit < 8; ++bit)
+  {
+    crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x1021) : static_cast<uint16_t>(crc << 1);
+  }
+  return crc;
+}
 
-TelemetryAssembly telemetry_assembly;
-ReadyScan ready_scan;
-MotionState motion_state;
+void append_usb_record(const void *data, size_t len)
+{
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < len; ++i)
+  {
+    usb_writer.crc = crc16_update(usb_writer.crc, bytes[i]);
+    encode_usb_byte(bytes[i]);
+  }
+}
 
-void set_led_color(uint8_t r, uint8_t g, uint8_t b)
+void begin_usb_record(uint8_t type, uint8_t bot, uint16_t frame_id)
 {
-  status_led.setPixelColor(0, status_led.Color(r, g, b));
-  status_led.show();
+  // The leading delimiter ends any text printed since the last record.
+  usb_frame[0] = 0x00;
+  usb_writer = UsbRecordWriter{2, 1, 1, 0xFFFF, type};
+  append_usb_record(&type, sizeof(type));
+  append_usb_record(&bot, sizeof(bot));
+  append_usb_record(&frame_id, sizeof(frame_id));
 }
 
-void led_error()
+void send_usb_record()
 {
-  led_base_color = status_led.Color(200, 0, 0);
-  set_led_color(200, 0, 0);
+  const uint16_t crc = usb_writer.crc;
+  encode_usb_byte(crc & 0xFF);
+  encode_usb_byte(crc >> 8);
+  usb_frame[usb_writer.code_pos] = usb_writer.code;
+  usb_frame[usb_writer.out++] = 0x00;
+  usb_tx_begin(usb_writer.type == kUsbRecordScan ? kUsbTxScan : kUsbTxState);
+  usb_tx_put(usb_frame, usb_writer.out);
+  usb_tx_end();
 }
 
-void led_waiting()
+void write_scan_record(const ScanSlot &scan)
 {
-  led_base_color = status_led.Color(200, 100, 0);
-  set_led_color(200, 100, 0);
+  begin_usb_record(kUsbRecordScan, scan.bot, scan.frame_id);
+  append_usb_record(&scan.total_points, sizeof(scan.total_points));
+  append_usb_record(&scan.chunk_count, sizeof(scan.chunk_count));
+  append_usb_record(&scan.chunk_mask, sizeof(scan.chunk_mask));
+  append_usb_record(scan.points, static_cast<size_t>(scan.total_points) * sizeof(TelemetryPoint));
+  send_usb_record();
 }
 
-void trigger_activity()
+void write_motion_record(uint8_t bot, const MotionState &motion)
 {
-  activity_flag = true;
+  const uint8_t payload[3] = {
+      static_cast<uint8_t>(motion.mode),
+      static_cast<uint8_t>(motion.direction),
+      static_cast<uint8_t>((motion.dodging ? 0x01 : 0x00) | (motion.wall_follow_left ? 0x02 : 0x00)),
+  };
+  begin_usb_record(kUsbRecordMotion, bot, 0);
+  append_usb_record(payload, sizeof(payload));
+  send_usb_record();
 }
 
-void update_led()
+// Pose and attitude records carry the ESP-NOW packet minus its 3-byte header.
+void write_packet_record(uint8_t type, uint8_t bot, const void *packet, size_t len)
 {
-  if (activity_flag)
-  {
-    activity_flag = false;
-    if (led_base_color != status_led.Color(200, 0, 0))
-    {
-      led_base_color = status_led.Color(0, 200, 0);
-    }
-    led_flash_end = millis() + 300;
-    set_led_color(0, 0, 200);
-  }
-  else if (millis() > led_flash_end)
-  {
-    const uint8_t r = (led_base_color >> 16) & 0xFF;
-    const uint8_t g = (led_base_color >> 8) & 0xFF;
-    const uint8_t b = led_base_color & 0xFF;
-    static uint32_t last_shown = 0xFFFFFFFF;
-    if (led_base_color != last_shown)
-    {
-      set_led_color(r, g, b);
-      last_shown = led_base_color;
-    }
-  }
+  begin_usb_record(type, bot, 0);
+  append_usb_record(static_cast<const uint8_t *>(packet) + 3, len - 3);
+  send_usb_record();
 }
 
-void setup_led()
+void write_link_record(uint8_t bot, const LinkSummary &link)
 {
-  status_led.begin();
-  status_led.setBrightness(40);
-  led_waiting();
+  begin_usb_record(kUsbRecordLink, bot, 0);
+  append_usb_record(&link, sizeof(link));
+  send_usb_record();
 }
 
-void reset_telemetry_assembly(uint16_t frame_id, uint8_t chunk_count, uint8_t total_points)
+struct __attribute__((packed)) ScanStatsSummary
 {
-  telemetry_assembly.frame_id = frame_id;
-  telemetry_assembly.chunk_count = min(chunk_count, kTelemetryMaxChunks);
-  telemetry_assembly.total_points = min(total_points, kTelemetryMaxPoints);
-  memset(telemetry_assembly.chunk_received, 0, sizeof(telemetry_assembly.chunk_received));
+  uint32_t complete;
+  uint32_t partial;
+  uint32_t dropped;
+  uint32_t late;
+  uint32_t overwritten;
+  uint32_t usb_scans_dropped;
+  uint32_t usb_other_dropped;
+};
+
+void print_json_scan_stats(uint8_t bot, const ScanStatsSummary &stats)
+{
+  usb_tx.printf("{\"t\":\"scans\",\"bot\":%u,\"complete\":%lu,\"partial\":%lu,\"dropped\":%lu,\"late\":%lu,\"overwritten\":%lu,"
+                "\"usb_scans_dropped\":%lu,\"usb_other_dropped\":%lu}\n",
+                static_cast<unsigned>(bot),
+                static_cast<unsigned long>(stats.complete),
+                static_cast<unsigned long>(stats.partial),
+                static_cast<unsigned long>(stats.dropped),
+                static_cast<unsigned long>(stats.late),
+                static_cast<unsigned long>(stats.overwritten),
+                static_cast<unsigned long>(stats.usb_scans_dropped),
+                static_cast<unsigned long>(stats.usb_other_dropped));
 }
 
-bool assembly_complete()
+// USB drops are for the whole port; every bot's record repeats them.
+void report_scan_stats(uint8_t bot)
 {
-  if (telemetry_assembly.total_points == 0 ||
-      telemetry_assembly.chunk_count == 0)
+  const ScanStats &scan_stats = bots[bot].scan_stats;
+  const ScanStatsSummary stats{scan_stats.complete,
+                               scan_stats.partial,
+                               scan_stats.dropped,
+                               scan_stats.late,
+                               scan_stats.overwritten,
+                               usb_tx_ring.scans_dropped,
+                               usb_tx_ring.other_dropped};
+  if (usb_binary)
   {
-    return false;
+    begin_usb_record(kUsbRecordScanStats, bot, 0);
+    append_usb_record(&stats, sizeof(stats));
+    send_usb_record();
   }
-
-  for (uint8_t i = 0; i < telemetry_assembly.chunk_count; ++i)
+  else
   {
-    if (!telemetry_assembly.chunk_received[i])
-    {
-      return false;
-    }
+    print_json_scan_stats(bot, stats);
   }
-
-  return true;
 }
 
-void stage_ready_scan()
+void report_link(uint8_t bot)
 {
-  if (telemetry_assembly.total_points == 0)
+  LinkSummary summary;
+  summarise_link(bots[bot].link, summary);
+  if (usb_binary)
   {
-    return;
+    write_link_record(bot, summary);
+  }
+  else
+  {
+    print_json_link(bot, summary);
   }
-
-  ready_scan.point_count = telemetry_assembly.total_points;
-  memcpy(ready_scan.points,
-         telemetry_assembly.points,
-         static_cast<size_t>(ready_scan.point_count) * sizeof(TelemetryPoint));
-  ready_scan.pending = true;
 }
 
-void handle_scan_chunk(const uint8_t *data, int len)
+// Forwards a drive command from the host as one ESP-NOW packet to the bot
+// it names. Not echoed: the host streams these at its keepalive rate.
+void handle_drive_command(uint8_t bot, uint16_t seq, const uint8_t *payload, size_t len)
 {
-  if (len < static_cast<int>(sizeof(TelemetryHeader)))
+  if (bot >= bot_count || len != 6)
   {
     return;
   }
 
-  TelemetryHeader header;
-  memcpy(&header, data, sizeof(header));
-
-  if (header.magic != kTelemetryMagic ||
-      header.version != kTelemetryVersion ||
-      header.type != kTelemetryTypeScanChunk)
-  {
-    return;
-  }
+  DriveCommand command{kTelemetryMagic, kDriveCommandVersion, kTelemetryTypeDrive, seq, 0, 0, 0};
+  memcpy(&command.left, payload, 2);
+  memcpy(&command.right, payload + 2, 2);
+  memcpy(&command.ttl_ms, payload + 4, 2);
+  command.left = constrain(command.left, -255, 255);
+  command.right = constrain(command.right, -255, 255);
 
-  if (header.chunk_count == 0 ||
-      header.chunk_count > kTelemetryMaxChunks ||
-      header.total_points == 0 ||
-      header.total_points > kTelemetryMaxPoints ||
-      header.chunk_index >= header.chunk_count ||
-      header.point_count > kTelemetryPointsPerChunk)
+  if (esp_now_send(bots[bot].peer.peer_addr, reinterpret_cast<const uint8_t *>(&command), sizeof(command)) != ESP_OK)
   {
-    return;
+    usb_tx.println("-> Drive cmd FAILED");
   }
+  last_send_time = millis();
+}
 
-  const int expected_len =
-      static_cast<int>(sizeof(TelemetryHeader) +
-                       header.point_count * sizeof(TelemetryPoint));
-  if (len != expected_len)
+// Decodes the COBS bytes collected between two 0x00 delimiters and dispatches
+// the command. Malformed frames are dropped.
+void finish_usb_command()
+{
+  const uint8_t *src = usb_command;
+  const size_t src_len = usb_command_len;
+  uint8_t decoded[kUsbCommandMaxBytes];
+  size_t out = 0;
+  size_t pos = 0;
+  bool ok = true;
+  while (ok && pos < src_len)
   {
-    return;
+    const uint8_t code = src[pos++];
+    if (code == 0 || pos + code - 1 > src_len)
+    {
+      ok = false;
+      break;
+    }
+    memcpy(&decoded[out], &src[pos], code - 1);
+    out += code - 1;
+    pos += code - 1;
+    if (code != 0xFF && pos < src_len)
+    {
+      decoded[out++] = 0;
+    }
   }
+  usb_command_len = 0;
 
-  if (telemetry_assembly.frame_id != header.frame_id ||
-      telemetry_assembly.chunk_count != header.chunk_count ||
-      telemetry_assembly.total_points != header.total_points)
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; ok && i + 2 < out; ++i)
   {
-    reset_telemetry_assembly(header.frame_id, header.chunk_count, header.total_points);
+    crc = crc16_update(crc, decoded[i]);
   }
-
-  const uint8_t point_offset = header.chunk_index * kTelemetryPointsPerChunk;
-  if (point_offset + header.point_count > telemetry_assembly.total_points)
+  if (!ok || out < 6 || crc != static_cast<uint16_t>(decoded[out - 2] | (decoded[out - 1] << 8)))
   {
     return;
   }
 
-  memcpy(&telemetry_assembly.points[point_offset],
-         data + sizeof(TelemetryHeader),
-         header.point_count * sizeof(TelemetryPoint));
-  telemetry_assembly.chunk_received[header.chunk_index] = true;
-
-  if (assembly_complete())
+  const uint16_t seq = static_cast<uint16_t>(decoded[2] | (decoded[3] << 8));
+  if (decoded[0] == kUsbCommandDrive)
   {
-    stage_ready_scan();
+    handle_drive_command(decoded[1], seq, &decoded[4], out - 6);
   }
 }
 
-void handle_motion_packet(const uint8_t *data, int len)
+// Collects a binary command frame. Returns true if the byte belonged to one.
+bool feed_usb_command(uint8_t value)
 {
-  if (len != static_cast<int>(sizeof(MotionTelemetry)))
+  if (!usb_command_open)
   {
-    return;
+    usb_command_open = (value == 0x00);
+    return usb_command_open;
   }
 
-  MotionTelemetry packet;
-  memcpy(&packet, data, sizeof(packet));
-  if (packet.magic != kTelemetryMagic ||
-      packet.version != kTelemetryVersion ||
-      packet.type != kTelemetryTypeMotion)
+  if (value == 0x00)
   {
-    return;
+    // Back-to-back delimiters: the first closed nothing, keep the frame open.
+    if (usb_command_len == 0)
+    {
+      return true;
+    }
+    finish_usb_command();
+    usb_command_open = false;
+    return true;
   }
 
-  const bool dodging = (packet.flags & 0x01) != 0;
-  const bool wall_follow_left = (packet.flags & 0x02) != 0;
-  const bool changed = motion_state.mode != packet.mode ||
-                       motion_state.direction != packet.direction ||
-                       motion_state.dodging != dodging ||
-                       motion_state.wall_follow_left != wall_follow_left;
-  if (!changed)
+  if (usb_command_len == kUsbCommandMaxBytes)
   {
-    return;
+    // Too long for any command: a lost delimiter. Back to text keys.
+    usb_command_len = 0;
+    usb_command_open = false;
+    return false;
   }
-
-  motion_state.mode = packet.mode;
-  motion_state.direction = packet.direction;
-  motion_state.dodging = dodging;
-  motion_state.wall_follow_left = wall_follow_left;
-  motion_state.pending = true;
+  usb_command[usb_command_len++] = value;
+  return true;
 }
 
-void on_data_sent(const wifi_tx_info_t *info, esp_now_send_status_t status)
+void reset_scan_composite(ScanComposite &composite)
 {
-  (void)info;
-  if (status == ESP_NOW_SEND_SUCCESS)
+  for (CompositeBin &bin : composite.bins)
   {
-    trigger_activity();
+    bin.valid = false;
+    bin.keep_frames = 0;
   }
+  composite.have_frame = false;
 }
 
-void on_data_recv(const esp_now_recv_info *info, const uint8_t *data, int len)
+// Merges a v2 scan into its bot's composite, then rewrites the scan's points
+// with the composite, seen from the scan's pose. Runs on the Draining slot.
+void merge_scan_composite(ScanSlot &scan)
 {
-  (void)info;
-  if (len < 3)
-  {
-    return;
-  }
-  if (data[0] != kTelemetryMagic || data[1] != kTelemetryVersion)
+  ScanComposite &scan_composite = bots[scan.bot].composite;
+  const int16_t step = static_cast<int16_t>(scan.frame_id - scan_composite.frame_id);
+  if (!scan_composite.have_frame || step <= 0 || step > kTelemetryMaxBinStride ||
+      scan.pose.source != scan_composite.pose_source)
   {
-    return;
+    reset_scan_composite(scan_composite);
   }
+  scan_composite.frame_id = scan.frame_id;
+  scan_composite.pose_source = scan.pose.source;
+  scan_composite.have_frame = true;
 
-  if (data[2] == kTelemetryTypeScanChunk)
+  const ScanPose &pose = scan.pose;
+  const float c = cosf(pose.theta_rad);
+  const float s = sinf(pose.theta_rad);
+
+  for (uint16_t i = 0; i < scan.total_points; ++i)
   {
-    handle_scan_chunk(data, len);
+    const PointCell cell = scan.cells[i];
+    for (uint8_t k = 0; k < cell.stride; ++k)
+    {
+      scan_composite.bins[cell.bin + k].keep_frames = cell.stride;
+    }
+
+    const float x = scan.points[i].x_mm;
+    const float y = scan.points[i].y_mm;
+    CompositeBin &bin = scan_composite.bins[cell.bin + cell.stride / 2];
+    bin.x_mm = pose.x_mm + c * x - s * y;
+    bin.y_mm = pose.y_mm + s * x + c * y;
+    bin.frame_id = scan.frame_id;
+    bin.intensity = scan.points[i].intensity;
+    bin.valid = true;
   }
-  else if (data[2] == kTelemetryTypeMotion)
+
+  uint16_t count = 0;
+  for (CompositeBin &bin : scan_composite.bins)
   {
-    handle_motion_packet(data, len);
+    if (!bin.valid)
+    {
+      continue;
+    }
+    if (static_cast<uint16_t>(scan.frame_id - bin.frame_id) >= bin.keep_frames)
+    {
+      bin.valid = false;
+      continue;
+    }
+
+    const float dx = bin.x_mm - pose.x_mm;
+    const float dy = bin.y_mm - pose.y_mm;
+    scan.points[count].x_mm = static_cast<int16_t>(constrain(lroundf(c * dx + s * dy), -32767L, 32767L));
+    scan.points[count].y_mm = static_cast<int16_t>(constrain(lroundf(c * dy - s * dx), -32767L, 32767L));
+    scan.points[count].intensity = bin.intensity;
+    ++count;
   }
+  scan.total_points = count;
 }
 
-void send_raw(const uint8_t *data, size_t len, bool log_text, bool track_command)
+void flush_ready_scan()
 {
-  if (esp_now_send(bot_peer.peer_addr, data, len) == ESP_OK)
+  ScanSlot *oldest = nullptr;
+  for (ScanSlot &slot : scan_slots)
   {
-    if (log_text)
+    if (slot.state.load(std::memory_order_acquire) == kSlotReady &&
+        (oldest == nullptr || static_cast<int32_t>(slot.ready_seq - oldest->ready_seq) < 0))
     {
-      Serial.printf("-> %c\n", static_cast<char>(data[0]));
+      oldest = &slot;
     }
   }
-  else if (log_text)
+
+  // The callback may recycle a Ready slot up to the moment it is taken.
+  uint8_t expected = kSlotReady;
+  if (oldest == nullptr ||
+      !oldest->state.compare_exchange_strong(expected, kSlotDraining, std::memory_order_acquire))
   {
-    Serial.printf("-> %c FAILED\n", static_cast<char>(data[0]));
+    return;
   }
 
-  last_send_time = millis();
-  if (track_command && len == 1)
+  if (composite_scans && oldest->version == 2)
   {
-    last_sent_cmd = static_cast<char>(data[0]);
+    merge_scan_composite(*oldest);
+  }
+  if (usb_binary)
+  {
+    write_scan_record(*oldest);
+  }
+  else
+  {
+    print_json_scan(*oldest);
   }
+  oldest->state.store(kSlotFree, std::memory_order_release);
 }
 
-void send_cmd(char cmd)
+void flush_motion_state(uint8_t bot)
 {
-  const uint8_t buf[1] = {static_cast<uint8_t>(cmd)};
-  send_raw(buf, sizeof(buf), true, true);
-}
+  MotionState &motion_state = bots[bot].motion;
+  if (!motion_state.pending)
+  {
+    return;
+  }
 
-void send_viewer_handshake()
-{
-  const uint8_t buf[1] = {'v'};
-  send_raw(buf, sizeof(buf), false, false);
+  MotionState local_motion;
+  local_motion.pending = false;
+  local_motion.mode = motion_state.mode;
+  local_motion.direction = motion_state.direction;
+  local_motion.dodging = motion_state.dodging;
+  local_motion.wall_follow_left = motion_state.wall_follow_left;
+  motion_state.pending = false;
+  if (usb_binary)
+  {
+    write_motion_record(bot, local_motion);
+  }
+  else
+  {
+    print_json_motion(bot, local_motion);
+  }
 }
 
-void send_motor_cmd(const String &s)
+void flush_pose_state(uint8_t bot)
 {
-  if (s.length() < 2)
+  PoseState &pose_state = bots[bot].pose;
+  if (!pose_state.pending)
   {
     return;
   }
 
-  const char motor = s[0];
-  const char dir = s[1];
-  if ((motor != 'L' && motor != 'R') ||
-      (dir != 'f' && dir != 'b' && dir != 's'))
+  const PoseTelemetry local_pose = pose_state.packet;
+  pose_state.pending = false;
+  if (usb_binary)
   {
-    return;
+    write_packet_record(kUsbRecordPose, bot, &local_pose, sizeof(local_pose));
   }
-
-  int pwm = (s.length() > 2) ? constrain(s.substring(2).toInt(), 0, 255) : 0;
-  if (dir == 's')
+  else
   {
-    pwm = 0;
+    print_json_pose(bot, local_pose);
   }
+}
 
-  const uint8_t buf[3] = {
-      static_cast<uint8_t>(motor),
-      static_cast<uint8_t>(dir),
-      static_cast<uint8_t>(pwm),
-  };
+void flush_attitude_state(uint8_t bot)
+{
+  AttitudeState &attitude_state = bots[bot].attitude;
+  if (!attitude_state.pending)
+  {
+    return;
+  }
 
-  if (esp_now_send(bot_peer.peer_addr, buf, sizeof(buf)) == ESP_OK)
+  const AttitudeTelemetry local_attitude = attitude_state.packet;
+  attitude_state.pending = false;
+  if (usb_binary)
   {
-    Serial.printf("-> Motor %c %c PWM %d\n", motor, dir, pwm);
+    write_packet_record(kUsbRecordAttitude, bot, &local_attitude, sizeof(local_attitude));
   }
   else
   {
-    Serial.println("-> Motor cmd FAILED");
+    print_json_attitude(bot, local_attitude);
   }
 }
 
-void print_json_scan(const ReadyScan &scan)
+bool add_peer(esp_now_peer_info_t &peer, const uint8_t *mac)
 {
-  Serial.print(F("{\"t\":\"scan\",\"x\":["));
-  for (uint16_t i = 0; i < scan.point_count; ++i)
+  memset(&peer, 0, sizeof(peer));
+  memcpy(peer.peer_addr, mac, sizeof(peer.peer_addr));
+  peer.channel = kChannel;
+  peer.encrypt = false;
+  return esp_now_add_peer(&peer) == ESP_OK;
+}
+
+// Appends a bot to the fleet. Returns its id, or kMaxBots if it did not fit.
+uint8_t add_bot(const uint8_t *mac)
+{
+  const uint8_t id = bot_count;
+  if (id >= kMaxBots || !add_peer(bots[id].peer, mac))
   {
-    if (i > 0)
-    {
-      Serial.print(',');
-    }
-    Serial.print(scan.points[i].x_mm);
+    return kMaxBots;
   }
+  bot_count.store(id + 1);
+  return id;
+}
 
-  Serial.print(F("],\"y\":["));
-  for (uint16_t i = 0; i < scan.point_count; ++i)
+void save_fleet()
+{
+  uint8_t macs[kMaxBots][6];
+  const uint8_t count = bot_count;
+  for (uint8_t i = 0; i < count; ++i)
   {
-    if (i > 0)
-    {
-      Serial.print(',');
-    }
-    Serial.print(scan.points[i].y_mm);
+    memcpy(macs[i], bots[i].peer.peer_addr, sizeof(macs[i]));
   }
+  fleet_store.putBytes("bots", macs, count * sizeof(macs[0]));
+}
 
-  Serial.print(F("],\"i\":["));
-  for (uint16_t i = 0; i < scan.point_count; ++i)
+void load_fleet()
+{
+  uint8_t macs[kMaxBots][6];
+  const size_t len = fleet_store.isKey("bots") ? fleet_store.getBytes("bots", macs, sizeof(macs)) : 0;
+  for (size_t i = 0; i < len / sizeof(macs[0]); ++i)
   {
-    if (i > 0)
+    if (add_bot(macs[i]) == kMaxBots)
     {
-      Serial.print(',');
+      usb_tx.printf("Peer add failed for bot %u\n", static_cast<unsigned>(i));
+      led_error();
     }
-    Serial.print(scan.points[i].intensity);
   }
+}
 
-  Serial.println(F("]}"));
+bool pairing_open(unsigned long now)
+{
+  return bot_count == 0 || static_cast<long>(pair_window_end - now) > 0;
 }
 
-void print_json_motion(const MotionState &motion)
+void print_pair_status(const char *detail, const uint8_t *mac)
 {
-  Serial.print(F("{\"t\":\"motion\",\"mode\":\""));
-  Serial.print(motion.mode);
-  Serial.print(F("\",\"dir\":\""));
-  Serial.print(motion.direction);
-  Serial.print(F("\",\"dodging\":"));
-  Serial.print(motion.dodging ? F("true") : F("false"));
-  Serial.print(F(",\"wall_side\":\""));
-  Serial.print(motion.wall_follow_left ? F("left") : F("right"));
-  Serial.println(F("\"}"));
+  usb_tx.printf("{\"t\":\"status\",\"stage\":\"pair\",\"detail\":\"%s %02X:%02X:%02X:%02X:%02X:%02X\"}\n",
+                detail, mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
 }
 
-void flush_ready_scan()
+void send_beacon(unsigned long now)
 {
-  if (!ready_scan.pending)
+  const PairBeacon beacon{kTelemetryMagic,
+                          kPairingVersion,
+                          kTelemetryTypeBeacon,
+                          static_cast<uint8_t>(pairing_open(now) ? 1 : 0)};
+  background_in_flight = background_in_flight + 1;
+  if (esp_now_send(kBroadcastMac, reinterpret_cast<const uint8_t *>(&beacon), sizeof(beacon)) != ESP_OK)
   {
-    return;
+    background_in_flight = background_in_flight - 1;
   }
-
-  ReadyScan local_scan;
-  local_scan.pending = false;
-  local_scan.point_count = ready_scan.point_count;
-  memcpy(local_scan.points,
-         ready_scan.points,
-         static_cast<size_t>(ready_scan.point_count) * sizeof(TelemetryPoint));
-  ready_scan.pending = false;
-
-  print_json_scan(local_scan);
 }
 
-void flush_motion_state()
+// Answers the pair request noted by the receive callback, if any. A known
+// bot gets its id again; a new one joins the fleet while pairing is open.
+void handle_pair_request(unsigned long now)
 {
-  if (!motion_state.pending)
+  uint8_t mac[6];
+  portENTER_CRITICAL(&pair_mux);
+  const bool pending = pair_request_pending;
+  memcpy(mac, pair_request_mac, sizeof(mac));
+  pair_request_pending = false;
+  portEXIT_CRITICAL(&pair_mux);
+  if (!pending)
   {
     return;
   }
 
-  MotionState local_motion;
-  local_motion.pending = false;
-  local_motion.mode = motion_state.mode;
-  local_motion.direction = motion_state.direction;
-  local_motion.dodging = motion_state.dodging;
-  local_motion.wall_follow_left = motion_state.wall_follow_left;
-  motion_state.pending = false;
-  print_json_motion(local_motion);
+  BotLink *known = find_bot(mac);
+  uint8_t id = known != nullptr ? static_cast<uint8_t>(known - bots) : kMaxBots;
+  if (known == nullptr)
+  {
+    if (!pairing_open(now))
+    {
+      print_pair_status("closed, ignored", mac);
+      return;
+    }
+    id = add_bot(mac);
+    if (id == kMaxBots)
+    {
+      print_pair_status("fleet full, ignored", mac);
+      return;
+    }
+    save_fleet();
+  }
+
+  const PairAccept accept{kTelemetryMagic, kPairingVersion, kTelemetryTypePairAccept, id};
+  esp_now_send(bots[id].peer.peer_addr, reinterpret_cast<const uint8_t *>(&accept), sizeof(accept));
+  char detail[12];
+  snprintf(detail, sizeof(detail), "bot %u", static_cast<unsigned>(id));
+  print_pair_status(detail, mac);
 }
 
 void setup_espnow()
@@ -475,7 +2075,7 @@ void setup_espnow()
   WiFi.mode(WIFI_STA);
   if (esp_now_init() != ESP_OK)
   {
-    Serial.println("ESP-NOW init failed, restarting");
+    usb_tx.println("ESP-NOW init failed, restarting");
     led_error();
     delay(2000);
     ESP.restart();
@@ -484,29 +2084,30 @@ void setup_espnow()
   esp_now_register_send_cb(on_data_sent);
   esp_now_register_recv_cb(on_data_recv);
 
-  memset(&bot_peer, 0, sizeof(bot_peer));
-  memcpy(bot_peer.peer_addr, kBotMac, sizeof(kBotMac));
-  bot_peer.channel = kChannel;
-  bot_peer.encrypt = false;
-
-  if (esp_now_add_peer(&bot_peer) != ESP_OK)
+  esp_now_peer_info_t broadcast_peer;
+  if (!add_peer(broadcast_peer, kBroadcastMac))
   {
-    Serial.println("Peer add failed");
+    usb_tx.println("Broadcast peer add failed");
     led_error();
   }
+
+  fleet_store.begin("fleet", false);
+  load_fleet();
 }
 
 } // namespace
 
 void setup()
 {
+  Serial.setTxBufferSize(kUsbTxCdcBufferBytes);
   Serial.begin(kUsbBaud);
   delay(500);
   setup_led();
+  setup_angle_table();
   setup_espnow();
   send_viewer_handshake();
 
-  Serial.println("{\"t\":\"status\",\"stage\":\"controller\",\"detail\":\"ready\"}");
+  usb_tx.println("{\"t\":\"status\",\"stage\":\"controller\",\"detail\":\"ready\"}");
 }
 
 void loop()
@@ -515,7 +2116,12 @@ void loop()
 
   while (Serial.available())
   {
-    const char k = static_cast<char>(Serial.read());
+    const int value = Serial.read();
+    if (value < 0 || feed_usb_command(static_cast<uint8_t>(value)))
+    {
+      continue;
+    }
+    const char k = static_cast<char>(value);
 
     if (k == '\r')
     {
@@ -524,27 +2130,47 @@ void loop()
 
     if (k == '\n')
     {
-      if (cmd_buf.length() >= 2)
+      send_motor_cmd(motor_line, motor_line_len);
+      motor_line_len = 0;
+      continue;
+    }
+
+    if (motor_line_len > 0)
+    {
+      if (motor_line_len < kMotorLineMaxChars)
       {
-        send_motor_cmd(cmd_buf);
+        motor_line[motor_line_len++] = k;
       }
-      cmd_buf = "";
       continue;
     }
 
-    if (cmd_buf.length() > 0)
+    if (bot_select_pending)
     {
-      cmd_buf += k;
+      bot_select_pending = false;
+      const uint8_t bot = static_cast<uint8_t>(k - '0');
+      if (k >= '0' && bot < bot_count)
+      {
+        // The old bot's held key is not kept alive; it stops on its own timeout.
+        selected_bot = bot;
+        held_cmd = 'x';
+        last_sent_cmd = 0;
+      }
+      usb_tx.printf("{\"t\":\"status\",\"stage\":\"bot\",\"detail\":\"%u\"}\n",
+                    static_cast<unsigned>(selected_bot));
       continue;
     }
 
-    if (k == '1' || k == '4' || k == 'x')
+    if (k == '1' || k == '4' || k == '5' || k == 'x')
     {
-      current_mode = k;
+      bots[selected_bot].mode = k;
       held_cmd = 'x';
       last_sent_cmd = 0;
       send_cmd(k);
-      Serial.printf("Mode -> %c\n", current_mode);
+      usb_tx.printf("Mode -> %c\n", k);
+    }
+    else if (k == '@')
+    {
+      bot_select_pending = true;
     }
     else if (k == 'w' || k == 's' || k == 'a' || k == 'd' ||
              k == 'q' || k == 'e')
@@ -553,11 +2179,39 @@ void loop()
     }
     else if (k == 'L' || k == 'R')
     {
-      cmd_buf = k;
+      motor_line[0] = k;
+      motor_line_len = 1;
+    }
+    else if (k == 'B' || k == 'J')
+    {
+      usb_binary = (k == 'B');
+      usb_tx.printf("{\"t\":\"status\",\"stage\":\"usb\",\"detail\":\"%s\"}\n",
+                    usb_binary ? "binary" : "json");
+    }
+    else if (k == 'C' || k == 'F')
+    {
+      composite_scans = (k == 'C');
+      for (BotLink &bot : bots)
+      {
+        reset_scan_composite(bot.composite);
+      }
+      usb_tx.printf("{\"t\":\"status\",\"stage\":\"scan\",\"detail\":\"%s\"}\n",
+                    composite_scans ? "composite" : "frames");
+    }
+    else if (k == 'P')
+    {
+      pair_window_end = now + kPairWindowMs;
+      usb_tx.println("{\"t\":\"status\",\"stage\":\"pair\",\"detail\":\"open\"}");
+    }
+    else if (k == 'U')
+    {
+      // Takes effect on the next restart; bots paired now keep their ids.
+      fleet_store.remove("bots");
+      usb_tx.println("{\"t\":\"status\",\"stage\":\"pair\",\"detail\":\"fleet cleared\"}");
     }
   }
 
-  if (current_mode == '1' && held_cmd != 'x')
+  if (bots[selected_bot].mode == '1' && held_cmd != 'x')
   {
     const bool changed = (held_cmd != last_sent_cmd);
     const bool keepalive = (now - last_send_time >= kKeepaliveMs);
@@ -573,8 +2227,40 @@ void loop()
     send_viewer_handshake();
   }
 
+  if (now - last_beacon_time >= kBeaconIntervalMs)
+  {
+    last_beacon_time = now;
+    send_beacon(now);
+  }
+  handle_pair_request(now);
+
+  if (now - last_ping_time >= kPingIntervalMs)
+  {
+    last_ping_time = now;
+    for (uint8_t i = 0; i < bot_count; ++i)
+    {
+      send_ping(bots[i]);
+    }
+  }
+  update_link_monitor(now);
+  if (now - last_link_report_time >= kLinkReportMs)
+  {
+    last_link_report_time = now;
+    for (uint8_t i = 0; i < bot_count; ++i)
+    {
+      report_link(i);
+      report_scan_stats(i);
+    }
+  }
+
   flush_ready_scan();
-  flush_motion_state();
+  for (uint8_t i = 0; i < bot_count; ++i)
+  {
+    flush_motion_state(i);
+    flush_pose_state(i);
+    flush_attitude_state(i);
+  }
+  pump_usb_tx();
   update_led();
   delay(10);
 }
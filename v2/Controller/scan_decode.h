@@ -0,0 +1,101 @@
+#pragma once
+
+// Decoder for the bot's v2 scan point stream (token format in the bot's
+// bot_scan_codec.h). No Arduino dependencies, so v2/host can run it against
+// the bot's encoder.
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace scan_decode {
+
+// Walks one chunk's stream from start_bin at stride and calls
+// emit(bin, stride, dist_q, intensity) for each point; intensity is the
+// point's top four bits. Returns the number of points, or -1 if the stream
+// is malformed, leaves the angle grid or holds more than capacity points.
+template <typename Emit>
+int decode_points(const uint8_t *data,
+                  size_t len,
+                  uint16_t start_bin,
+                  uint8_t stride,
+                  uint16_t angle_bins,
+                  uint8_t max_stride,
+                  uint16_t capacity,
+                  Emit emit)
+{
+  size_t pos = 0;
+  uint16_t bin = start_bin;
+  uint16_t count = 0;
+  uint8_t history = 0;
+  int32_t d1 = 0;
+  int32_t d2 = 0;
+
+  while (pos < len)
+  {
+    const uint8_t lead = data[pos++];
+    if ((lead >> 4) == 0)
+    {
+      // 0x0n skips n bins, 0x00 n skips n bins, 0x00 0x00 s sets the stride.
+      if (lead != 0x00)
+      {
+        bin += lead;
+      }
+      else if (pos < len && data[pos] != 0x00)
+      {
+        bin += data[pos++];
+      }
+      else if (pos + 1 < len)
+      {
+        stride = data[pos + 1];
+        pos += 2;
+        if (stride == 0 || stride > max_stride)
+        {
+          return -1;
+        }
+      }
+      else
+      {
+        return -1;
+      }
+      history = history > 0 ? 1 : 0;
+      continue;
+    }
+
+    uint32_t zigzag = lead & 0x07;
+    if (lead & 0x08)
+    {
+      uint8_t shift = 3;
+      uint8_t next = 0;
+      do
+      {
+        if (pos >= len || shift > 17)
+        {
+          return -1;
+        }
+        next = data[pos++];
+        zigzag |= static_cast<uint32_t>(next & 0x7F) << shift;
+        shift += 7;
+      } while (next & 0x80);
+    }
+
+    const int32_t residual = static_cast<int32_t>(zigzag >> 1) ^ -static_cast<int32_t>(zigzag & 1);
+    const int32_t prediction = history >= 2 ? 2 * d1 - d2 : (history == 1 ? d1 : 0);
+    const int32_t dist_q = prediction + residual;
+    d2 = d1;
+    d1 = dist_q;
+    history = history < 2 ? history + 1 : 2;
+
+    if (bin + stride > angle_bins || dist_q <= 0 || count >= capacity)
+    {
+      return -1;
+    }
+
+    emit(bin, stride, dist_q, static_cast<uint8_t>(lead >> 4));
+    ++count;
+    bin += stride;
+  }
+
+  return count;
+}
+
+} // namespace scan_decode
@@ -0,0 +1,55 @@
+#pragma once
+
+// Just enough of Arduino.h for the header-only bot modules that the host
+// checks include (bot_config.h and what it pulls in), and for the LD06
+// reader (lidar_reader.cpp), which the host tools feed from a capture.
+
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+using std::max;
+using std::min;
+
+#define DEG_TO_RAD 0.017453292519943295f
+#define SERIAL_8N1 0x800001c
+
+class Stream
+{
+ public:
+  int printf(const char *format, ...)
+  {
+    va_list args;
+    va_start(args, format);
+    const int written = vprintf(format, args);
+    va_end(args);
+    return written;
+  }
+};
+
+// Reads come from the last feed() instead of a UART.
+class HardwareSerial : public Stream
+{
+ public:
+  void begin(unsigned long, uint32_t, int, int) {}
+
+  void feed(const uint8_t *data, size_t len)
+  {
+    data_ = data;
+    len_ = len;
+    pos_ = 0;
+  }
+
+  int available() const { return static_cast<int>(len_ - pos_); }
+  int read() { return pos_ < len_ ? data_[pos_++] : -1; }
+
+ private:
+  const uint8_t *data_ = nullptr;
+  size_t len_ = 0;
+  size_t pos_ = 0;
+};
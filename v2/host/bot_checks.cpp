@@ -0,0 +1,830 @@
+// Host checks for the firmware pieces that do not need a board: the
+// fixed-point attitude filter, the wheel speed PID on a simulated motor, the
+// v2 scan point stream (bot encoder against the controller decoder, and the
+// map error of a room scan per byte sent) and the bot's CLI line assembly
+// and tokenizer.
+// Exits non-zero if any group fails.
+//
+//   g++ -std=c++17 -O2 -Iv2/host/arduino v2/host/bot_checks.cpp -o bot_checks
+//   ./bot_checks
+//
+// Adding -fsanitize=address,undefined makes the CLI fuzz catch reads past a
+// buffer as well as writes.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "../Bot/bot_cli_parse.h"
+#include "../Bot/bot_fusion.h"
+#include "../Bot/bot_pid.h"
+#include "../Bot/bot_scan_codec.h"
+#include "../Controller/scan_decode.h"
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                   \
+  do                                                                  \
+  {                                                                   \
+    if (!(cond))                                                      \
+    {                                                                 \
+      std::printf("  %s:%d: %s\n", __FILE__, __LINE__, #cond);        \
+      ++failures;                                                     \
+    }                                                                 \
+  } while (0)
+
+// Deterministic, so a failure reproduces.
+uint32_t next_random(uint32_t &seed)
+{
+  seed = seed * 1103515245u + 12345u;
+  return (seed >> 16) & 0x7FFF;
+}
+
+// Binary angle units per degree.
+constexpr double kBamPerDeg = 65536.0 / 360.0;
+
+bool near_deg(int16_t bam, double deg, double tolerance_deg)
+{
+  return std::abs(bam / kBamPerDeg - deg) <= tolerance_deg;
+}
+
+double quat_norm(const bot::fusion::Mahony &filter)
+{
+  double sum = 0.0;
+  for (int i = 0; i < 4; ++i)
+  {
+    const double q = filter.q[i] / static_cast<double>(bot::fusion::kQ30One);
+    sum += q * q;
+  }
+  return sum;
+}
+
+void check_fusion()
+{
+  using namespace bot::fusion;
+  constexpr uint32_t kDtUs = 10000;  // 100 Hz
+  const int32_t no_rotation[3] = {0, 0, 0};
+
+  // Tilted 30 degrees about x (left side up): the first sample levels the
+  // quaternion to gravity.
+  const int16_t tilted[3] = {0, 8192, 14189};
+  Mahony filter;
+  update(filter, tilted, no_rotation, kDtUs);
+  CHECK(near_deg(roll_bam(filter), 30.0, 0.5));
+  CHECK(near_deg(pitch_bam(filter), 0.0, 0.5));
+  CHECK(near_deg(yaw_bam(filter), 0.0, 0.5));
+
+  // Back on level ground the proportional term pulls roll to zero.
+  const int16_t level[3] = {0, 0, 16384};
+  for (int i = 0; i < 1000; ++i)
+  {
+    update(filter, level, no_rotation, kDtUs);
+  }
+  CHECK(near_deg(roll_bam(filter), 0.0, 0.5));
+  CHECK(near_deg(pitch_bam(filter), 0.0, 0.5));
+
+  // Yaw is the integrated gyro: 1 rad/s for 1 s, and gravity leaves it alone.
+  reset(filter);
+  const int32_t yaw_rate[3] = {0, 0, 1 << 16};
+  for (int i = 0; i < 100; ++i)
+  {
+    update(filter, level, yaw_rate, kDtUs);
+  }
+  CHECK(near_deg(yaw_bam(filter), 57.2958, 1.0));
+  CHECK(near_deg(roll_bam(filter), 0.0, 0.5));
+
+  // The renormalisation holds the quaternion on the unit sphere.
+  for (int i = 0; i < 6000; ++i)
+  {
+    update(filter, level, yaw_rate, kDtUs);
+  }
+  CHECK(std::abs(quat_norm(filter) - 1.0) < 1e-3);
+}
+
+// A TT gear motor: first order, nothing below the dead band, top speed at
+// full PWM. The speed estimate is the bot's 100 ms rolling window.
+class TtMotor
+{
+ public:
+  static constexpr float kDeadBandPwm = 40.0f;
+  static constexpr float kTopSpeedMmps = 420.0f;
+  static constexpr float kTauS = 0.08f;
+  static constexpr int kWindowMs = 100;
+
+  void step_1ms(int pwm, float load_mmps)
+  {
+    const float magnitude = static_cast<float>(std::abs(pwm));
+    const float drive = magnitude <= kDeadBandPwm
+                            ? 0.0f
+                            : (magnitude - kDeadBandPwm) * kTopSpeedMmps / (255.0f - kDeadBandPwm);
+    float target = (pwm < 0 ? -drive : drive) - load_mmps;
+    if (drive == 0.0f)
+    {
+      target = 0.0f;
+    }
+    speed_ += (target - speed_) * (0.001f / kTauS);
+    window_sum_ += speed_ - window_[window_head_];
+    window_[window_head_] = speed_;
+    window_head_ = (window_head_ + 1) % kWindowMs;
+  }
+
+  float speed() const
+  {
+    return speed_;
+  }
+
+  float measured() const
+  {
+    return window_sum_ / kWindowMs;
+  }
+
+  // The bot's speed map, scaled by map_scale the way a real one drifts with
+  // the battery.
+  float feed_forward(int target_mmps) const
+  {
+    if (target_mmps == 0)
+    {
+      return 0.0f;
+    }
+    const float pwm = kDeadBandPwm + std::abs(target_mmps) * (255.0f - kDeadBandPwm) / kTopSpeedMmps;
+    return (target_mmps < 0 ? -pwm : pwm) * map_scale;
+  }
+
+  float map_scale = 1.0f;
+
+ private:
+  float speed_ = 0.0f;
+  float window_[kWindowMs]{};
+  float window_sum_ = 0.0f;
+  int window_head_ = 0;
+};
+
+struct StepResponse
+{
+  float settle_s;       // last time outside +-5% of the target
+  float overshoot;      // fraction of the target change
+  float max_integral;   // largest |integral| seen
+};
+
+// Runs the PID at 20 ms on the motor for duration_s with a fixed target and
+// load, from whatever state the motor and PID are in.
+StepResponse run_pid(TtMotor &motor,
+                     bot::pid::WheelPid &state,
+                     const bot::pid::Gains &gains,
+                     int target_mmps,
+                     float duration_s,
+                     float load_mmps = 0.0f)
+{
+  const float start = motor.speed();
+  const float rising = target_mmps >= start ? 1.0f : -1.0f;
+  StepResponse response{0.0f, 0.0f, 0.0f};
+  int pwm = 0;
+  const int steps_ms = static_cast<int>(duration_s * 1000.0f);
+  const int period_ms = static_cast<int>(gains.dt_s * 1000.0f + 0.5f);
+  for (int ms = 0; ms < steps_ms; ++ms)
+  {
+    if (ms % period_ms == 0)
+    {
+      pwm = bot::pid::step(state, gains, target_mmps, motor.measured(), motor.feed_forward(target_mmps));
+      response.max_integral = std::max(response.max_integral, std::abs(state.integral));
+    }
+    motor.step_1ms(pwm, load_mmps);
+
+    const float speed = motor.speed();
+    if (std::abs(speed - target_mmps) > 0.05f * std::abs(target_mmps))
+    {
+      response.settle_s = (ms + 1) / 1000.0f;
+    }
+    const float change = std::abs(target_mmps - start);
+    if (change > 0.0f)
+    {
+      response.overshoot = std::max(response.overshoot, rising * (speed - target_mmps) / change);
+    }
+  }
+  return response;
+}
+
+void check_wheel_pid()
+{
+  // The defaults from the encoder block in bot_config.h.
+  constexpr bot::pid::Gains kGains{0.35f, 1.2f, 0.01f, 80.0f, 0.02f};
+
+  // Step from rest: the dead band and a 15% feed-forward error are left to
+  // the PID to trim.
+  TtMotor motor;
+  motor.map_scale = 0.85f;
+  bot::pid::WheelPid state;
+  const StepResponse step = run_pid(motor, state, kGains, 250, 2.0f);
+  std::printf("  step 0->250 mm/s: settle %.2f s, overshoot %.1f%%\n",
+              step.settle_s, step.overshoot * 100.0f);
+  CHECK(step.settle_s < 0.6f);
+  CHECK(step.overshoot < 0.10f);
+  CHECK(std::abs(motor.speed() - 250.0f) < 5.0f);
+
+  // Feed-forward does most of the work: without it the PID alone has to
+  // climb out of the dead band.
+  TtMotor no_map_motor;
+  no_map_motor.map_scale = 0.0f;
+  bot::pid::WheelPid no_map_state;
+  const StepResponse no_map = run_pid(no_map_motor, no_map_state, kGains, 250, 2.0f);
+  std::printf("  step 0->250 mm/s without feed-forward: settle %.2f s\n", no_map.settle_s);
+  CHECK(step.settle_s + 0.2f < no_map.settle_s);
+
+  // Slow target near the dead band.
+  const StepResponse slow = run_pid(motor, state, kGains, 80, 2.0f);
+  std::printf("  step 250->80 mm/s: settle %.2f s, overshoot %.1f%%\n",
+              slow.settle_s, slow.overshoot * 100.0f);
+  CHECK(slow.settle_s < 0.8f);
+  CHECK(std::abs(motor.speed() - 80.0f) < 4.0f);
+
+  // Windup: an unreachable target pins the output for 3 s. The integral
+  // must not move while pinned. The drop to a reachable target afterwards is
+  // compared with the same drop from an integral wound up to its clamp,
+  // which is where it would sit without the saturation check. The map is
+  // exact here, so any integral is error.
+  TtMotor fast_motor;
+  bot::pid::WheelPid fast_state;
+  run_pid(fast_motor, fast_state, kGains, 200, 2.0f);
+  const float integral_before = fast_state.integral;
+  const StepResponse pinned = run_pid(fast_motor, fast_state, kGains, 600, 3.0f);
+  CHECK(std::abs(fast_state.integral - integral_before) < 1.0f);
+  CHECK(pinned.max_integral <= kGains.integral_limit_pwm);
+
+  TtMotor wound_motor = fast_motor;
+  bot::pid::WheelPid wound_state = fast_state;
+  wound_state.integral = kGains.integral_limit_pwm;
+  const StepResponse wound = run_pid(wound_motor, wound_state, kGains, 200, 2.0f);
+  const StepResponse recover = run_pid(fast_motor, fast_state, kGains, 200, 2.0f);
+  std::printf("  windup 600->200 mm/s: settle %.2f s, undershoot %.1f%% (wound up: %.2f s)\n",
+              recover.settle_s, recover.overshoot * 100.0f, wound.settle_s);
+  // Most of what is left is the lag of the 100 ms speed window.
+  CHECK(recover.settle_s < 1.0f);
+  CHECK(recover.overshoot < 0.15f);
+  CHECK(recover.settle_s + 0.3f < wound.settle_s);
+
+  // A load step (a carpet edge) is trimmed out by the integral.
+  const StepResponse loaded = run_pid(motor, state, kGains, 200, 2.0f, 60.0f);
+  std::printf("  load 60 mm/s at 200 mm/s: settle %.2f s\n", loaded.settle_s);
+  CHECK(loaded.settle_s < 1.0f);
+  CHECK(std::abs(motor.speed() - 200.0f) < 5.0f);
+
+  // Reverse, and a zero target stops at once and clears the integral.
+  const StepResponse reverse = run_pid(motor, state, kGains, -200, 2.0f);
+  CHECK(reverse.settle_s < 1.0f);
+  CHECK(bot::pid::step(state, kGains, 0, motor.measured(), 0.0f) == 0);
+  CHECK(state.integral == 0.0f);
+}
+
+struct Point
+{
+  uint16_t bin;
+  uint8_t stride;
+  int32_t dist_q;
+  uint8_t intensity;  // top four bits
+
+  bool operator==(const Point &other) const
+  {
+    return bin == other.bin && stride == other.stride && dist_q == other.dist_q &&
+           intensity == other.intensity;
+  }
+};
+
+// Decodes every chunk of a set the way the controller does. Returns false if
+// any header or stream is rejected.
+bool decode_set(const bot::scan_codec::ChunkSet &set, uint16_t frame_id, std::vector<Point> &points)
+{
+  for (uint8_t i = 0; i < set.count; ++i)
+  {
+    bot::ScanChunkHeader header;
+    memcpy(&header, set.packets[i], sizeof(header));
+    if (header.magic != bot::kTelemetryMagic || header.version != bot::kTelemetryVersion ||
+        header.type != bot::kTelemetryTypeScanChunk || header.frame_id != frame_id ||
+        header.chunk_index != i || header.chunk_count != set.count ||
+        set.lengths[i] > bot::kTelemetryMaxPacketBytes)
+    {
+      return false;
+    }
+
+    const int decoded = scan_decode::decode_points(
+        set.packets[i] + sizeof(header),
+        set.lengths[i] - sizeof(header),
+        header.start_bin,
+        header.bin_stride,
+        bot::kTelemetryAngleBins,
+        bot::kTelemetryMaxBinStride,
+        bot::kTelemetryAngleBins,
+        [&](uint16_t bin, uint8_t stride, int32_t dist_q, uint8_t intensity)
+        {
+          points.push_back(Point{bin, stride, dist_q, intensity});
+        });
+    if (decoded != header.point_count)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+void check_scan_codec()
+{
+  using bot::kTelemetryAngleBins;
+  using bot::scan_codec::ChunkSet;
+  using bot::scan_codec::ChunkWriter;
+
+  constexpr uint16_t kFrameId = 0x1234;
+  static ChunkSet set;
+  std::vector<Point> expected;
+
+  // A sweep of smooth walls, gaps, range jumps, a gap over 255 bins and
+  // stride changes with a phase skip, as encode_grid produces them.
+  uint32_t seed = 12345;
+
+  const uint8_t strides[] = {1, 2, 3, 5, 1, 2};
+  const uint16_t sector_bins = kTelemetryAngleBins / 6;
+  ChunkWriter writer(set, kFrameId, strides[0]);
+  int32_t dist_q = 200;
+  for (uint8_t sector = 0; sector < 6; ++sector)
+  {
+    const uint8_t stride = strides[sector];
+    const uint16_t first = sector * sector_bins;
+    const uint16_t end = first + sector_bins;
+    const uint8_t phase = sector % stride;
+    writer.set_stride(stride);
+    writer.skip(phase);
+
+    uint16_t bin = first + phase;
+    for (; bin + stride <= end; bin += stride)
+    {
+      const uint32_t roll = next_random(seed) % 100;
+      if (sector == 4 || roll < 10)
+      {
+        // Sector 4 is empty: one long skip.
+        writer.add_gap();
+        continue;
+      }
+      if (roll < 20)
+      {
+        dist_q = 1 + static_cast<int32_t>(next_random(seed) % 2000);  // range jump
+      }
+      else
+      {
+        dist_q = std::max<int32_t>(1, dist_q + static_cast<int32_t>(next_random(seed) % 7) - 3);
+      }
+      const uint8_t intensity = static_cast<uint8_t>(next_random(seed) & 0xFF);
+      writer.add_point(bin, static_cast<uint16_t>(dist_q), intensity);
+      expected.push_back(Point{bin, stride, dist_q, std::max<uint8_t>(1, intensity >> 4)});
+    }
+    writer.skip(end - bin);
+  }
+  writer.finish();
+
+  CHECK(!set.overflow);
+  CHECK(set.count > 1);
+  std::vector<Point> decoded;
+  CHECK(decode_set(set, kFrameId, decoded));
+  CHECK(decoded == expected);
+
+  // A set that runs out of chunks keeps the points that fit, and those
+  // still decode.
+  ChunkWriter full(set, kFrameId, 1);
+  expected.clear();
+  for (uint16_t bin = 0; bin < kTelemetryAngleBins; ++bin)
+  {
+    // Far, jumpy returns take two or three bytes each.
+    const uint16_t far = static_cast<uint16_t>(1 + next_random(seed) % 8000);
+    full.add_point(bin, far, 0xF0);
+    if (!set.overflow)
+    {
+      expected.push_back(Point{bin, 1, far, 0x0F});
+    }
+  }
+  full.finish();
+  CHECK(set.overflow);
+  CHECK(set.count == bot::kTelemetryMaxChunks);
+  decoded.clear();
+  CHECK(decode_set(set, kFrameId, decoded));
+  CHECK(decoded == expected);
+
+  // Malformed streams are rejected.
+  auto reject = [](const std::vector<uint8_t> &stream) {
+    return scan_decode::decode_points(stream.data(), stream.size(), 0, 1, kTelemetryAngleBins,
+                                      bot::kTelemetryMaxBinStride, kTelemetryAngleBins,
+                                      [](uint16_t, uint8_t, int32_t, uint8_t) {}) < 0;
+  };
+  CHECK(reject({0x18}));                    // residual bytes missing
+  CHECK(reject({0x00, 0x00, 0x00}));        // stride 0
+  CHECK(reject({0x00, 0x00, 0x09}));        // stride above the limit
+  CHECK(reject({0x00}));                    // truncated skip
+  CHECK(reject({0x11}));                    // distance not positive
+  CHECK(reject({0x00, 0xFF, 0x00, 0xFF, 0x14}));  // off the end of the grid
+}
+
+// A 4 x 3 m room seen from off-centre, with a box on the floor.
+struct Wall
+{
+  double x0, y0, x1, y1;
+};
+
+constexpr Wall kRoom[] = {
+    {-1500, -1200, 2500, -1200}, {2500, -1200, 2500, 1800},
+    {2500, 1800, -1500, 1800},   {-1500, 1800, -1500, -1200},
+    {600, 300, 1000, 300},       {1000, 300, 1000, 700},
+    {1000, 700, 600, 700},       {600, 700, 600, 300},
+};
+constexpr double kPi = 3.14159265358979323846;
+
+double ray_range_mm(double angle_rad)
+{
+  const double dx = std::cos(angle_rad);
+  const double dy = std::sin(angle_rad);
+  double best = 1e9;
+  for (const Wall &wall : kRoom)
+  {
+    const double ex = wall.x1 - wall.x0;
+    const double ey = wall.y1 - wall.y0;
+    const double denom = dx * ey - dy * ex;
+    if (std::abs(denom) < 1e-9)
+    {
+      continue;
+    }
+    const double t = (wall.x0 * ey - wall.y0 * ex) / denom;
+    const double u = (wall.x0 * dy - wall.y0 * dx) / denom;
+    if (t > 0.0 && u >= 0.0 && u <= 1.0)
+    {
+      best = std::min(best, t);
+    }
+  }
+  return best;
+}
+
+double wall_distance_mm(double x, double y)
+{
+  double best = 1e9;
+  for (const Wall &wall : kRoom)
+  {
+    const double ex = wall.x1 - wall.x0;
+    const double ey = wall.y1 - wall.y0;
+    double u = ((x - wall.x0) * ex + (y - wall.y0) * ey) / (ex * ex + ey * ey);
+    u = std::max(0.0, std::min(1.0, u));
+    best = std::min(best, std::hypot(x - wall.x0 - u * ex, y - wall.y0 - u * ey));
+  }
+  return best;
+}
+
+// One LD06 revolution: 452 returns off the angle grid, a few mm of range
+// noise and about 3% of returns dropped.
+void room_scan(uint16_t frame, lidar::ScanFrame &scan)
+{
+  constexpr uint16_t kPoints = 452;
+  constexpr double kStepDeg = 360.0 / kPoints;
+  uint32_t seed = 777u + frame;
+  const double start_deg = std::fmod(frame * 0.37, kStepDeg);
+
+  scan.point_count = kPoints;
+  scan.valid_point_count = 0;
+  for (uint16_t i = 0; i < kPoints; ++i)
+  {
+    lidar::ScanPoint &point = scan.points[i];
+    const double angle_deg = start_deg + i * kStepDeg;
+    const double noise_mm = static_cast<double>(next_random(seed) % 13) - 6.0;
+    point.angle_deg = static_cast<float>(angle_deg);
+    point.distance_mm = static_cast<uint16_t>(std::lround(ray_range_mm(angle_deg * kPi / 180.0) + noise_mm));
+    point.intensity = 200;
+    point.valid = next_random(seed) % 100 >= 3;
+    scan.valid_point_count += point.valid ? 1 : 0;
+  }
+}
+
+struct Reconstruction
+{
+  double payload_bytes = 0.0;  // mean per scan
+  double rms_mm = 0.0;
+  double max_mm = 0.0;
+  double coverage = 0.0;       // share of fine bins some point spans
+};
+
+// Encodes kFrames scans of the room, decodes them as the controller does
+// and draws each point at the centre of the bins it spans. force_stride 0
+// lets encode_scan() pick the strides for budget_bytes.
+Reconstruction reconstruct_room(uint16_t budget_bytes, uint8_t target_chunks, uint8_t force_stride)
+{
+  using namespace bot::scan_codec;
+  constexpr uint16_t kFrames = 30;  // every stride phase
+  static lidar::ScanFrame scan;
+  static ScanEncoder encoder;
+
+  Reconstruction result;
+  double sum_sq = 0.0;
+  size_t points = 0;
+  size_t covered = 0;
+  for (uint16_t frame = 0; frame < kFrames; ++frame)
+  {
+    room_scan(frame, scan);
+    if (force_stride == 0)
+    {
+      encode_scan(scan, frame, budget_bytes, target_chunks, encoder);
+    }
+    else
+    {
+      build_grid(scan, encoder.grid);
+      for (uint8_t &level : encoder.plan.level)
+      {
+        level = 0;
+        while (kStrideLevels[level] != force_stride)
+        {
+          ++level;
+        }
+      }
+      encode_grid(encoder.grid, encoder.plan, frame, encoder.set);
+    }
+
+    for (uint8_t i = 0; i < encoder.set.count; ++i)
+    {
+      result.payload_bytes += encoder.set.lengths[i] - sizeof(bot::ScanChunkHeader);
+    }
+
+    std::vector<Point> decoded;
+    CHECK(decode_set(encoder.set, frame, decoded));
+    for (const Point &point : decoded)
+    {
+      const double angle_rad = (point.bin + point.stride / 2) * (2.0 * kPi / bot::kTelemetryAngleBins);
+      const double dist_mm = point.dist_q * static_cast<double>(bot::kTelemetryDistQuantumMm);
+      const double error = wall_distance_mm(dist_mm * std::cos(angle_rad), dist_mm * std::sin(angle_rad));
+      sum_sq += error * error;
+      result.max_mm = std::max(result.max_mm, error);
+      covered += point.stride;
+      ++points;
+    }
+  }
+
+  result.payload_bytes /= kFrames;
+  result.rms_mm = points > 0 ? std::sqrt(sum_sq / points) : 1e9;
+  result.coverage = static_cast<double>(covered) / (kFrames * bot::kTelemetryAngleBins);
+  return result;
+}
+
+// Map error against bytes sent: fixed strides, then the byte budgets the
+// bot uses (four chunks, a clean link, while driving, the floor).
+void check_scan_reconstruction()
+{
+  constexpr uint16_t kChunkPayload = bot::kTelemetryMaxPacketBytes - sizeof(bot::ScanChunkHeader);
+
+  double previous_rms = 0.0;
+  double previous_bytes = 1e9;
+  for (uint8_t stride : bot::scan_codec::kStrideLevels)
+  {
+    const Reconstruction r = reconstruct_room(0, bot::kTelemetryMaxChunks, stride);
+    std::printf("  stride %u: %6.1f bytes, rms %5.1f mm, max %5.1f mm, coverage %.2f\n",
+                stride, r.payload_bytes, r.rms_mm, r.max_mm, r.coverage);
+    CHECK(r.payload_bytes < previous_bytes);
+    CHECK(r.rms_mm >= previous_rms - 0.5);
+    previous_rms = r.rms_mm;
+    previous_bytes = r.payload_bytes;
+    if (stride == 1)
+    {
+      // Range noise, the 8 mm quantum and resampling only.
+      CHECK(r.rms_mm < 6.0);
+      CHECK(r.coverage > 0.95);
+    }
+    // The phase skip leaves up to stride - 1 bins of each sector uncovered.
+    CHECK(r.coverage > 0.8);
+    CHECK(r.rms_mm < 30.0);
+  }
+
+  const struct
+  {
+    uint16_t budget;
+    uint8_t chunks;
+  } budgets[] = {
+      {bot::kTelemetryMaxChunks * kChunkPayload, bot::kTelemetryMaxChunks},
+      {bot::kTelemetryTargetChunks * kChunkPayload, bot::kTelemetryTargetChunks},
+      {kChunkPayload, 1},
+      {bot::kTelemetryMinScanBytes, 1},
+  };
+  previous_rms = 0.0;
+  for (const auto &b : budgets)
+  {
+    const Reconstruction r = reconstruct_room(b.budget, b.chunks, 0);
+    std::printf("  budget %3u: %6.1f bytes, rms %5.1f mm, max %5.1f mm, coverage %.2f\n",
+                b.budget, r.payload_bytes, r.rms_mm, r.max_mm, r.coverage);
+    CHECK(r.payload_bytes <= b.budget);
+    CHECK(r.rms_mm >= previous_rms - 0.5);
+    CHECK(r.rms_mm < 30.0);
+    CHECK(r.coverage > 0.8);
+    previous_rms = r.rms_mm;
+  }
+}
+
+void check_cli_parser()
+{
+  struct Case
+  {
+    const char *text;
+    bool ok;
+    const char *name;
+    bool has_value;
+    long value;
+  };
+  const Case cases[] = {
+      {"lp", true, "lp", false, 0},
+      {"l?", true, "l?", false, 0},
+      {"lt -90", true, "lt", true, -90},
+      {"lt +7", true, "lt", true, 7},
+      {"lt\t-3 ", true, "lt", true, -3},
+      {"Lf200", true, "Lf", true, 200},
+      {"lw  150  ", true, "lw", true, 150},
+      {"lf 9999999", true, "lf", true, bot::kCliValueLimit},
+      {"lt -99999999", true, "lt", true, -bot::kCliValueLimit},
+      {"", false, "", false, 0},
+      {"12", false, "", false, 0},
+      {"lpxx", false, "", false, 0},
+      {"lt -", false, "", false, 0},
+      {"lt - 3", false, "", false, 0},
+      {"lt 5x", false, "", false, 0},
+      {"lt 5 6", false, "", false, 0},
+  };
+
+  for (const Case &c : cases)
+  {
+    bot::CliLine line;
+    const bool ok = bot::tokenize_cli_line(c.text, static_cast<uint8_t>(strlen(c.text)), line);
+    if (ok != c.ok ||
+        (ok && (strcmp(line.name, c.name) != 0 || line.has_value != c.has_value || line.value != c.value)))
+    {
+      std::printf("  tokenize \"%s\"\n", c.text);
+      ++failures;
+    }
+  }
+}
+
+// A byte stream skewed towards what the CLI cares about: line starts, digits,
+// signs, spaces, NULs and CR/LF runs.
+char random_cli_byte(uint32_t &seed)
+{
+  static const char kInteresting[] = "lLRlt?fbsx -+0123456789\t\r\n\n";
+  const uint32_t pick = next_random(seed) % 8;
+  if (pick == 0)
+  {
+    return '\0';
+  }
+  if (pick <= 5)
+  {
+    return kInteresting[next_random(seed) % (sizeof(kInteresting) - 1)];
+  }
+  return static_cast<char>(next_random(seed) & 0xFF);
+}
+
+void fuzz_cli_parser()
+{
+  uint32_t seed = 777;
+
+  // Line assembly: guards around the buffer must survive, and every line the
+  // reference model sees must come out as a line or a too-long line.
+  struct Guarded
+  {
+    uint8_t before[8];
+    bot::CliLineBuffer buffer;
+    uint8_t after[8];
+  } guarded;
+  memset(guarded.before, 0xA5, sizeof(guarded.before));
+  memset(guarded.after, 0xA5, sizeof(guarded.after));
+
+  bool open = false;
+  std::string expected_line;
+  uint32_t lines = 0;
+  uint32_t accepted = 0;
+  uint32_t errors = 0;
+  uint32_t keys = 0;
+  uint32_t expected_keys = 0;
+  for (int i = 0; i < 200000; ++i)
+  {
+    // Every so often, a burst of one byte to force long lines and CR/LF runs.
+    const int run = next_random(seed) % 50 == 0 ? 1 + next_random(seed) % 40 : 1;
+    const char k = random_cli_byte(seed);
+    for (int r = 0; r < run; ++r)
+    {
+      bool model_line = false;
+      if (k == '\n')
+      {
+        model_line = open;
+        open = false;
+      }
+      else if (k == '\r')
+      {
+        // Ignored, inside a line or not.
+      }
+      else if (open)
+      {
+        expected_line.push_back(k);
+      }
+      else if (k == 'L' || k == 'R' || k == 'l')
+      {
+        open = true;
+        expected_line.assign(1, k);
+      }
+      else
+      {
+        ++expected_keys;
+      }
+
+      const bot::CliInput input = bot::feed_cli_byte(guarded.buffer, k);
+      CHECK(guarded.buffer.len <= bot::kCliLineMaxChars);
+      keys += input == bot::kCliKey ? 1 : 0;
+      if (input != bot::kCliLine && input != bot::kCliLineTooLong)
+      {
+        CHECK(!model_line);
+        continue;
+      }
+
+      CHECK(model_line);
+      ++lines;
+      const bool too_long = expected_line.size() > bot::kCliLineMaxChars;
+      CHECK((input == bot::kCliLineTooLong) == too_long);
+      if (input == bot::kCliLine)
+      {
+        CHECK(std::string(guarded.buffer.line, guarded.buffer.len) == expected_line);
+      }
+
+      bot::CliLine line;
+      if (input == bot::kCliLine && bot::tokenize_cli_line(guarded.buffer.line, guarded.buffer.len, line))
+      {
+        ++accepted;
+      }
+      else
+      {
+        ++errors;
+      }
+    }
+  }
+  for (uint8_t i = 0; i < sizeof(guarded.before); ++i)
+  {
+    CHECK(guarded.before[i] == 0xA5 && guarded.after[i] == 0xA5);
+  }
+  CHECK(keys == expected_keys);
+  CHECK(lines > 1000 && accepted > 0 && errors > 0);
+  CHECK(accepted + errors == lines);
+
+  // Tokenizer on its own: exactly sized heap copies, so a sanitizer build
+  // catches any read past len. Whatever it accepts must be well formed.
+  for (int i = 0; i < 200000; ++i)
+  {
+    const uint8_t len = static_cast<uint8_t>(next_random(seed) % (bot::kCliLineMaxChars + 1));
+    std::vector<char> text(len);
+    for (char &c : text)
+    {
+      c = random_cli_byte(seed);
+    }
+    if (len > 0 && next_random(seed) % 2 == 0)
+    {
+      text[0] = "lLR"[next_random(seed) % 3];
+    }
+
+    bot::CliLine line;
+    memset(&line, 0x5A, sizeof(line));
+    if (!bot::tokenize_cli_line(text.data(), len, line))
+    {
+      continue;
+    }
+    const size_t name_len = strnlen(line.name, sizeof(line.name));
+    CHECK(name_len >= 1 && name_len <= bot::kCliNameMaxChars);
+    for (size_t n = 0; n < name_len; ++n)
+    {
+      CHECK(bot::is_cli_name_char(line.name[n]));
+    }
+    CHECK(line.value >= -bot::kCliValueLimit && line.value <= bot::kCliValueLimit);
+    CHECK(line.has_value || line.value == 0);
+  }
+}
+
+} // namespace
+
+int main()
+{
+  const struct
+  {
+    const char *name;
+    void (*run)();
+  } groups[] = {
+      {"fusion", check_fusion},
+      {"wheel pid", check_wheel_pid},
+      {"scan codec", check_scan_codec},
+      {"scan reconstruction", check_scan_reconstruction},
+      {"cli parser", check_cli_parser},
+      {"cli fuzz", fuzz_cli_parser},
+  };
+
+  int failed_groups = 0;
+  for (const auto &group : groups)
+  {
+    const int before = failures;
+    group.run();
+    const bool ok = failures == before;
+    std::printf("%s: %s\n", group.name, ok ? "ok" : "FAILED");
+    failed_groups += ok ? 0 : 1;
+  }
+  return failed_groups == 0 ? 0 : 1;
+}
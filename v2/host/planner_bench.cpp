@@ -0,0 +1,278 @@
+// Replays LD06 scans through the bot's dynamic-window planner (bot_dwa.h) and
+// prints, per scan, the arc it picks and the time per call on this machine.
+// The bytes go through the firmware's own LD06 reader, so a capture of the
+// sensor's UART replays exactly as the bot would see it:
+//
+//   g++ -std=c++17 -O2 -Iv2/host/arduino v2/host/planner_bench.cpp v2/Bot/lidar_reader.cpp -o planner_bench
+//   stty -F /dev/ttyUSB0 230400 raw -echo && cat /dev/ttyUSB0 > room.ld06
+//   ./planner_bench room.ld06
+//
+// With no argument it synthesises LD06 packets for a few poses in a 4 x 3 m
+// room with a box in it. Each chosen arc is fed back as the next current
+// command, as the bot's motion profile would after one planner tick. Times
+// are host times; `ld` on the bot reports the same call on the C3.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "../Bot/bot_dwa.h"
+#include "../Bot/lidar_reader.h"
+
+namespace {
+
+constexpr int kRepeats = 200;  // calls timed per scan
+
+struct Wall
+{
+  double x0, y0, x1, y1;
+};
+
+constexpr Wall kRoom[] = {
+    {-1500, -1200, 2500, -1200}, {2500, -1200, 2500, 1800},
+    {2500, 1800, -1500, 1800},   {-1500, 1800, -1500, -1200},
+    {600, 300, 1000, 300},       {1000, 300, 1000, 700},
+    {1000, 700, 600, 700},       {600, 700, 600, 300},
+};
+constexpr double kPi = 3.14159265358979323846;
+
+struct Pose
+{
+  const char *name;
+  double x_mm;
+  double y_mm;
+  double heading_deg;
+};
+
+constexpr Pose kPoses[] = {
+    {"open room", -1000, -500, 0},
+    {"box 450 mm ahead", 150, 500, 0},
+    {"box 220 mm ahead", 380, 450, 0},
+    {"wall 500 mm ahead", 2000, -300, 0},
+    {"corner ahead", 2150, 1450, 45},
+    {"wall 200 mm right", 0, -1000, 0},
+};
+constexpr int kRevolutionsPerPose = 3;
+
+double ray_range_mm(double x, double y, double angle_rad)
+{
+  const double dx = std::cos(angle_rad);
+  const double dy = std::sin(angle_rad);
+  double best = 1e9;
+  for (const Wall &wall : kRoom)
+  {
+    const double ex = wall.x1 - wall.x0;
+    const double ey = wall.y1 - wall.y0;
+    const double denom = dx * ey - dy * ex;
+    if (std::abs(denom) < 1e-9)
+    {
+      continue;
+    }
+    const double t = ((wall.x0 - x) * ey - (wall.y0 - y) * ex) / denom;
+    const double u = ((wall.x0 - x) * dy - (wall.y0 - y) * dx) / denom;
+    if (t > 0.0 && u >= 0.0 && u <= 1.0)
+    {
+      best = std::min(best, t);
+    }
+  }
+  return best;
+}
+
+uint8_t ld06_crc(const uint8_t *data, size_t len)
+{
+  uint8_t crc = 0;
+  for (size_t i = 0; i < len; ++i)
+  {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; ++bit)
+    {
+      crc = (crc & 0x80) ? static_cast<uint8_t>((crc << 1) ^ 0x4D) : static_cast<uint8_t>(crc << 1);
+    }
+  }
+  return crc;
+}
+
+void put_le_u16(std::vector<uint8_t> &out, uint16_t value)
+{
+  out.push_back(static_cast<uint8_t>(value & 0xFF));
+  out.push_back(static_cast<uint8_t>(value >> 8));
+}
+
+// 38 packets of 12 returns per revolution at 10 Hz, a few mm of noise and
+// about 2% dropouts. The reader publishes a revolution when the next one
+// starts, so a lead-in revolution and one trailing packet frame the poses.
+std::vector<uint8_t> synthesise_capture(std::vector<std::string> &labels)
+{
+  constexpr int kPacketsPerRev = 38;
+  constexpr double kStepDeg = 360.0 / (kPacketsPerRev * lidar::kPointsPerPacket);
+  std::vector<uint8_t> out;
+  uint32_t seed = 1;
+  uint16_t timestamp_ms = 0;
+
+  std::vector<const Pose *> revolutions;
+  revolutions.push_back(&kPoses[0]);
+  for (const Pose &pose : kPoses)
+  {
+    for (int i = 0; i < kRevolutionsPerPose; ++i)
+    {
+      revolutions.push_back(&pose);
+      labels.push_back(pose.name);
+    }
+  }
+
+  for (size_t rev = 0; rev <= revolutions.size(); ++rev)
+  {
+    const Pose &pose = *revolutions[rev < revolutions.size() ? rev : revolutions.size() - 1];
+    const double phase_deg = std::fmod(rev * 0.29, kStepDeg);
+    const int packets = rev < revolutions.size() ? kPacketsPerRev : 1;
+    for (int packet = 0; packet < packets; ++packet)
+    {
+      const double start_deg = phase_deg + packet * lidar::kPointsPerPacket * kStepDeg;
+      const size_t begin = out.size();
+      out.push_back(lidar::kPacketHeader);
+      out.push_back(lidar::kPacketLength);
+      put_le_u16(out, 3600);
+      put_le_u16(out, static_cast<uint16_t>(std::lround(start_deg * 100.0)) % 36000);
+      for (size_t i = 0; i < lidar::kPointsPerPacket; ++i)
+      {
+        // The reader mirrors the physical angle into the bot frame.
+        const double physical_deg = start_deg + (i + 0.5) * kStepDeg;
+        const double ray_rad = (pose.heading_deg + 360.0 - physical_deg) * kPi / 180.0;
+        seed = seed * 1103515245u + 12345u;
+        const double noise_mm = static_cast<double>((seed >> 16) % 13) - 6.0;
+        const double range_mm = ray_range_mm(pose.x_mm, pose.y_mm, ray_rad) + noise_mm;
+        const bool dropped = (seed >> 8) % 50 == 0 || range_mm > 12000.0;
+        put_le_u16(out, dropped ? 0 : static_cast<uint16_t>(std::lround(range_mm)));
+        out.push_back(200);
+      }
+      const double end_deg = start_deg + lidar::kPointsPerPacket * kStepDeg;
+      put_le_u16(out, static_cast<uint16_t>(std::lround(end_deg * 100.0)) % 36000);
+      put_le_u16(out, timestamp_ms);
+      timestamp_ms = static_cast<uint16_t>(timestamp_ms + 3);
+      out.push_back(ld06_crc(out.data() + begin, lidar::kPacketSize - 1));
+    }
+  }
+  return out;
+}
+
+bool read_capture(const char *path, std::vector<uint8_t> &out)
+{
+  FILE *file = std::fopen(path, "rb");
+  if (file == nullptr)
+  {
+    return false;
+  }
+  uint8_t buffer[4096];
+  size_t got = 0;
+  while ((got = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+  {
+    out.insert(out.end(), buffer, buffer + got);
+  }
+  std::fclose(file);
+  return true;
+}
+
+// Signed turn radius in mm, positive to the left.
+std::string describe_arc(int left, int right)
+{
+  if (left == right)
+  {
+    return "straight";
+  }
+  if (left + right == 0)
+  {
+    return right > left ? "spin left" : "spin right";
+  }
+  const long radius = std::lround(bot::kWheelbaseMm / 2.0 * (left + right) / (right - left));
+  return "r " + std::to_string(radius) + " mm";
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  using bot::dwa::plan_dynamic_window;
+
+  std::vector<uint8_t> capture;
+  std::vector<std::string> labels;
+  if (argc > 1)
+  {
+    if (!read_capture(argv[1], capture))
+    {
+      std::fprintf(stderr, "cannot read %s\n", argv[1]);
+      return 1;
+    }
+  }
+  else
+  {
+    capture = synthesise_capture(labels);
+  }
+
+  static HardwareSerial serial;
+  static lidar::Reader reader(serial);
+  static bot::PlannerSectors sectors;
+  bot::dwa::Obstacle obstacles[bot::kPlannerBins];
+
+  int current_left = 0;
+  int current_right = 0;
+  size_t scans = 0;
+  size_t blocked = 0;
+  double total_us = 0.0;
+  double max_us = 0.0;
+
+  std::printf("%4s  %-20s %6s %5s  %-9s %-13s %8s\n",
+              "scan", "pose", "points", "obst", "pwm l,r", "arc", "us/call");
+  for (size_t pos = 0; pos < capture.size(); pos += lidar::kPacketSize)
+  {
+    serial.feed(capture.data() + pos, std::min(lidar::kPacketSize, capture.size() - pos));
+    if (!reader.read_scan())
+    {
+      continue;
+    }
+
+    const lidar::ScanFrame &scan = reader.latest_scan();
+    bot::dwa::build_sectors(scan, sectors);
+    const uint8_t obstacle_count = bot::dwa::collect_obstacles(sectors, obstacles);
+
+    int left = 0;
+    int right = 0;
+    bool planned = false;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kRepeats; ++i)
+    {
+      planned = plan_dynamic_window(sectors, current_left, current_right, left, right);
+    }
+    const double us = std::chrono::duration<double, std::micro>(
+                          std::chrono::steady_clock::now() - start).count() / kRepeats;
+    total_us += us;
+    max_us = std::max(max_us, us);
+
+    char pwm[16];
+    std::snprintf(pwm, sizeof(pwm), "%d,%d", left, right);
+    std::printf("%4zu  %-20s %6u %5u  %-9s %-13s %8.2f\n",
+                scans,
+                scans < labels.size() ? labels[scans].c_str() : "-",
+                static_cast<unsigned>(scan.valid_point_count),
+                static_cast<unsigned>(obstacle_count),
+                planned ? pwm : "-",
+                planned ? describe_arc(left, right).c_str() : "blocked",
+                us);
+
+    // A blocked plan hands over to the escape manoeuvre, which stops first.
+    current_left = planned ? left : 0;
+    current_right = planned ? right : 0;
+    blocked += planned ? 0 : 1;
+    ++scans;
+  }
+
+  if (scans == 0)
+  {
+    std::fprintf(stderr, "no complete scans in the capture\n");
+    return 1;
+  }
+  std::printf("%zu scans, %zu blocked, %.2f us/call mean, %.2f us max\n",
+              scans, blocked, total_us / scans, max_us);
+  return 0;
+}
@@ -0,0 +1,191 @@
+// Switches the controller to binary USB mode and prints each record as the
+// JSON line the text mode would have produced, so the Python tools can read
+// it from a pipe. Configure the port first, e.g.
+//
+//   stty -F /dev/ttyACM0 460800 raw -echo
+//   ./usb_dump /dev/ttyACM0
+//
+// With no argument, reads a captured stream from stdin.
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <vector>
+
+#include "usb_frames.h"
+
+namespace {
+
+void print_record(const usb_frames::Record &record)
+{
+  using namespace usb_frames;
+
+  switch (record.type)
+  {
+    case kRecordScan:
+    {
+      Scan scan;
+      if (!parse_scan(record, scan))
+      {
+        return;
+      }
+      const std::vector<ScanPoint> &points = scan.points;
+      std::printf("{\"t\":\"scan\",\"bot\":%u,\"frame\":%u,\"chunks\":%u,\"mask\":%u,\"x\":[",
+                  static_cast<unsigned>(record.bot),
+                  static_cast<unsigned>(record.frame_id),
+                  static_cast<unsigned>(scan.chunk_count),
+                  static_cast<unsigned>(scan.chunk_mask));
+      for (size_t i = 0; i < points.size(); ++i)
+      {
+        std::printf(i == 0 ? "%d" : ",%d", points[i].x_mm);
+      }
+      std::printf("],\"y\":[");
+      for (size_t i = 0; i < points.size(); ++i)
+      {
+        std::printf(i == 0 ? "%d" : ",%d", points[i].y_mm);
+      }
+      std::printf("],\"i\":[");
+      for (size_t i = 0; i < points.size(); ++i)
+      {
+        std::printf(i == 0 ? "%u" : ",%u", points[i].intensity);
+      }
+      std::printf("]}\n");
+      break;
+    }
+
+    case kRecordMotion:
+    {
+      Motion motion;
+      if (parse_motion(record, motion))
+      {
+        std::printf("{\"t\":\"motion\",\"bot\":%u,\"mode\":\"%c\",\"dir\":\"%c\",\"dodging\":%s,\"wall_side\":\"%s\"}\n",
+                    static_cast<unsigned>(record.bot),
+                    motion.mode,
+                    motion.direction,
+                    motion.dodging ? "true" : "false",
+                    motion.wall_follow_left ? "left" : "right");
+      }
+      break;
+    }
+
+    case kRecordPose:
+    {
+      Pose pose;
+      if (parse_pose(record, pose))
+      {
+        std::printf("{\"t\":\"pose\",\"bot\":%u,\"x\":%.3f,\"y\":%.3f,\"th\":%.3f,\"sx\":%.3f,\"sy\":%.3f,\"sth\":%.3f}\n",
+                    static_cast<unsigned>(record.bot),
+                    pose.x_mm / 1000.0,
+                    pose.y_mm / 1000.0,
+                    pose.theta_mrad / 1000.0,
+                    pose.sigma_x_mm / 1000.0,
+                    pose.sigma_y_mm / 1000.0,
+                    pose.sigma_theta_mrad / 1000.0);
+      }
+      break;
+    }
+
+    case kRecordAttitude:
+    {
+      Attitude attitude;
+      if (parse_attitude(record, attitude))
+      {
+        std::printf("{\"t\":\"attitude\",\"bot\":%u,\"q\":[%.4f,%.4f,%.4f,%.4f],\"yaw\":%.2f,\"rate\":%.2f}\n",
+                    static_cast<unsigned>(record.bot),
+                    attitude.quat_q14[0] / 16384.0,
+                    attitude.quat_q14[1] / 16384.0,
+                    attitude.quat_q14[2] / 16384.0,
+                    attitude.quat_q14[3] / 16384.0,
+                    attitude.yaw_cdeg / 100.0,
+                    attitude.yaw_rate_cdps / 100.0);
+      }
+      break;
+    }
+
+    case kRecordLink:
+    {
+      Link link;
+      if (parse_link(record, link))
+      {
+        std::printf("{\"t\":\"link\",\"bot\":%u,\"n\":%u,\"p50_us\":%u,\"p90_us\":%u,\"p99_us\":%u,\"max_us\":%u,"
+                    "\"loss\":%.3f,\"pings\":%u,\"lost\":%u,\"rssi\":%d,\"bot_rssi\":%d}\n",
+                    static_cast<unsigned>(record.bot),
+                    static_cast<unsigned>(link.samples),
+                    static_cast<unsigned>(link.p50_us),
+                    static_cast<unsigned>(link.p90_us),
+                    static_cast<unsigned>(link.p99_us),
+                    static_cast<unsigned>(link.max_us),
+                    link.loss_permille / 1000.0,
+                    static_cast<unsigned>(link.pings),
+                    static_cast<unsigned>(link.lost),
+                    link.rssi,
+                    link.bot_rssi);
+      }
+      break;
+    }
+
+    case kRecordScanStats:
+    {
+      ScanStats stats;
+      if (parse_scan_stats(record, stats))
+      {
+        std::printf("{\"t\":\"scans\",\"bot\":%u,\"complete\":%u,\"partial\":%u,\"dropped\":%u,\"late\":%u,\"overwritten\":%u,"
+                    "\"usb_scans_dropped\":%u,\"usb_other_dropped\":%u}\n",
+                    static_cast<unsigned>(record.bot),
+                    static_cast<unsigned>(stats.complete),
+                    static_cast<unsigned>(stats.partial),
+                    static_cast<unsigned>(stats.dropped),
+                    static_cast<unsigned>(stats.late),
+                    static_cast<unsigned>(stats.overwritten),
+                    static_cast<unsigned>(stats.usb_scans_dropped),
+                    static_cast<unsigned>(stats.usb_other_dropped));
+      }
+      break;
+    }
+
+    default:
+      break;
+  }
+  std::fflush(stdout);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  int fd = STDIN_FILENO;
+  if (argc > 1)
+  {
+    fd = open(argv[1], O_RDWR | O_NOCTTY);
+    if (fd < 0)
+    {
+      std::perror(argv[1]);
+      return 1;
+    }
+    const char enable = 'B';
+    if (write(fd, &enable, 1) != 1)
+    {
+      std::perror("write");
+      return 1;
+    }
+  }
+
+  usb_frames::FrameDecoder decoder(print_record);
+  uint8_t buf[4096];
+  for (;;)
+  {
+    const ssize_t n = read(fd, buf, sizeof(buf));
+    if (n <= 0)
+    {
+      break;
+    }
+    decoder.feed(buf, static_cast<size_t>(n));
+  }
+
+  std::fprintf(stderr,
+               "records=%llu bad_frames=%llu\n",
+               static_cast<unsigned long long>(decoder.records()),
+               static_cast<unsigned long long>(decoder.bad_frames()));
+  return 0;
+}
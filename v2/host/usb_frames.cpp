@@ -0,0 +1,283 @@
+#include "usb_frames.h"
+
+#include <cstring>
+
+namespace usb_frames {
+namespace {
+
+// Largest record the controller sends: a full 450-point scan.
+constexpr size_t kMaxFrameBytes = 4096;
+
+uint16_t get_u16(const uint8_t *p)
+{
+  return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t get_u32(const uint8_t *p)
+{
+  return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+         (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+int16_t get_i16(const uint8_t *p)
+{
+  return static_cast<int16_t>(get_u16(p));
+}
+
+void put_u16(std::vector<uint8_t> &out, uint16_t value)
+{
+  out.push_back(static_cast<uint8_t>(value));
+  out.push_back(static_cast<uint8_t>(value >> 8));
+}
+
+} // namespace
+
+uint16_t crc16_ccitt(const uint8_t *data, size_t len)
+{
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < len; ++i)
+  {
+    crc ^= static_cast<uint16_t>(data[i]) << 8;
+    for (int bit = 0; bit < 8; ++bit)
+    {
+      crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x1021) : static_cast<uint16_t>(crc << 1);
+    }
+  }
+  return crc;
+}
+
+bool cobs_decode(const uint8_t *src, size_t len, std::vector<uint8_t> &out)
+{
+  out.clear();
+  size_t pos = 0;
+  while (pos < len)
+  {
+    const uint8_t code = src[pos++];
+    if (code == 0 || pos + code - 1 > len)
+    {
+      return false;
+    }
+    out.insert(out.end(), src + pos, src + pos + code - 1);
+    pos += code - 1;
+    if (code != 0xFF && pos < len)
+    {
+      out.push_back(0);
+    }
+  }
+  return true;
+}
+
+void cobs_encode(const uint8_t *src, size_t len, std::vector<uint8_t> &out)
+{
+  out.clear();
+  size_t code_pos = 0;
+  uint8_t code = 1;
+  out.push_back(0);
+  for (size_t i = 0; i < len; ++i)
+  {
+    if (src[i] != 0)
+    {
+      out.push_back(src[i]);
+      ++code;
+    }
+    if (src[i] == 0 || code == 0xFF)
+    {
+      out[code_pos] = code;
+      code_pos = out.size();
+      code = 1;
+      out.push_back(0);
+    }
+  }
+  out[code_pos] = code;
+}
+
+std::vector<uint8_t> encode_record(uint8_t type, uint8_t bot, uint16_t frame_id, const uint8_t *payload,
+                                   size_t len)
+{
+  std::vector<uint8_t> body;
+  body.reserve(len + 6);
+  body.push_back(type);
+  body.push_back(bot);
+  put_u16(body, frame_id);
+  body.insert(body.end(), payload, payload + len);
+  put_u16(body, crc16_ccitt(body.data(), body.size()));
+
+  std::vector<uint8_t> encoded;
+  cobs_encode(body.data(), body.size(), encoded);
+  std::vector<uint8_t> frame;
+  frame.reserve(encoded.size() + 2);
+  frame.push_back(0);
+  frame.insert(frame.end(), encoded.begin(), encoded.end());
+  frame.push_back(0);
+  return frame;
+}
+
+std::vector<uint8_t> encode_drive(uint8_t bot, uint16_t seq, int16_t left, int16_t right, uint16_t ttl_ms)
+{
+  std::vector<uint8_t> payload;
+  put_u16(payload, static_cast<uint16_t>(left));
+  put_u16(payload, static_cast<uint16_t>(right));
+  put_u16(payload, ttl_ms);
+  return encode_record(kCommandDrive, bot, seq, payload.data(), payload.size());
+}
+
+FrameDecoder::FrameDecoder(Callback on_record) : on_record_(std::move(on_record))
+{
+  frame_.reserve(kMaxFrameBytes);
+  decoded_.reserve(kMaxFrameBytes);
+}
+
+void FrameDecoder::feed(const uint8_t *data, size_t len)
+{
+  for (size_t i = 0; i < len; ++i)
+  {
+    if (data[i] == 0)
+    {
+      finish_frame();
+      continue;
+    }
+    if (frame_.size() < kMaxFrameBytes)
+    {
+      frame_.push_back(data[i]);
+    }
+    else
+    {
+      overflow_ = true;
+    }
+  }
+}
+
+void FrameDecoder::finish_frame()
+{
+  // Back-to-back delimiters are normal: every record starts and ends with one.
+  if (frame_.empty() && !overflow_)
+  {
+    return;
+  }
+
+  const bool ok = !overflow_ && cobs_decode(frame_.data(), frame_.size(), decoded_) &&
+                  decoded_.size() >= 6 &&
+                  crc16_ccitt(decoded_.data(), decoded_.size() - 2) ==
+                      get_u16(&decoded_[decoded_.size() - 2]);
+  frame_.clear();
+  overflow_ = false;
+  if (!ok)
+  {
+    ++bad_frames_;
+    return;
+  }
+
+  record_.type = decoded_[0];
+  record_.bot = decoded_[1];
+  record_.frame_id = get_u16(&decoded_[2]);
+  record_.payload.assign(decoded_.begin() + 4, decoded_.end() - 2);
+  ++records_;
+  on_record_(record_);
+}
+
+bool parse_scan(const Record &record, Scan &scan)
+{
+  const std::vector<uint8_t> &p = record.payload;
+  if (record.type != kRecordScan || p.size() < 4)
+  {
+    return false;
+  }
+  const uint16_t count = get_u16(p.data());
+  if (p.size() != 4 + static_cast<size_t>(count) * 5 || p[2] == 0 || p[2] > 8)
+  {
+    return false;
+  }
+
+  scan.chunk_count = p[2];
+  scan.chunk_mask = p[3];
+  scan.points.resize(count);
+  for (uint16_t i = 0; i < count; ++i)
+  {
+    const uint8_t *q = &p[4 + i * 5];
+    scan.points[i] = ScanPoint{get_i16(q), get_i16(q + 2), q[4]};
+  }
+  return true;
+}
+
+bool parse_motion(const Record &record, Motion &motion)
+{
+  const std::vector<uint8_t> &p = record.payload;
+  if (record.type != kRecordMotion || p.size() != 3)
+  {
+    return false;
+  }
+  motion = Motion{static_cast<char>(p[0]), static_cast<char>(p[1]), (p[2] & 0x01) != 0,
+                  (p[2] & 0x02) != 0};
+  return true;
+}
+
+bool parse_pose(const Record &record, Pose &pose)
+{
+  const std::vector<uint8_t> &p = record.payload;
+  if (record.type != kRecordPose || p.size() != 16)
+  {
+    return false;
+  }
+  pose = Pose{static_cast<int32_t>(get_u32(&p[0])),
+              static_cast<int32_t>(get_u32(&p[4])),
+              get_i16(&p[8]),
+              get_u16(&p[10]),
+              get_u16(&p[12]),
+              get_u16(&p[14])};
+  return true;
+}
+
+bool parse_attitude(const Record &record, Attitude &attitude)
+{
+  const std::vector<uint8_t> &p = record.payload;
+  if (record.type != kRecordAttitude || p.size() != 12)
+  {
+    return false;
+  }
+  for (int i = 0; i < 4; ++i)
+  {
+    attitude.quat_q14[i] = get_i16(&p[i * 2]);
+  }
+  attitude.yaw_cdeg = get_i16(&p[8]);
+  attitude.yaw_rate_cdps = get_i16(&p[10]);
+  return true;
+}
+
+bool parse_link(const Record &record, Link &link)
+{
+  const std::vector<uint8_t> &p = record.payload;
+  if (record.type != kRecordLink || p.size() != 29)
+  {
+    return false;
+  }
+  link.samples = p[0];
+  link.p50_us = get_u32(&p[1]);
+  link.p90_us = get_u32(&p[5]);
+  link.p99_us = get_u32(&p[9]);
+  link.max_us = get_u32(&p[13]);
+  link.loss_permille = get_u16(&p[17]);
+  link.pings = get_u32(&p[19]);
+  link.lost = get_u32(&p[23]);
+  link.rssi = static_cast<int8_t>(p[27]);
+  link.bot_rssi = static_cast<int8_t>(p[28]);
+  return true;
+}
+
+bool parse_scan_stats(const Record &record, ScanStats &stats)
+{
+  const std::vector<uint8_t> &p = record.payload;
+  if (record.type != kRecordScanStats || p.size() != 28)
+  {
+    return false;
+  }
+  stats = ScanStats{get_u32(&p[0]),
+                    get_u32(&p[4]),
+                    get_u32(&p[8]),
+                    get_u32(&p[12]),
+                    get_u32(&p[16]),
+                    get_u32(&p[20]),
+                    get_u32(&p[24])};
+  return true;
+}
+
+} // namespace usb_frames
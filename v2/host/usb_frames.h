@@ -0,0 +1,170 @@
+#pragma once
+
+// Decoder for the controller's binary USB mode (send 'B' to enable, 'J' to
+// return to JSON lines).
+//
+// Each record is COBS-encoded and framed by a 0x00 byte on both sides, so a
+// text line printed between records only ever costs one bad frame. Decoded:
+//
+//   u8 type | u8 bot | u16 frame_id | payload ... | u16 crc
+//
+// All fields are little-endian. The CRC is CRC-16/CCITT-FALSE over everything
+// before it. bot is the bot's index in the controller's fleet table. frame_id
+// is the bot's scan frame id for scan records and 0 for the others.
+//
+// Commands to the controller use the same framing: bot picks the bot to drive
+// and the frame_id field carries a sequence number. Text keys can still be
+// sent in between.
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace usb_frames {
+
+enum RecordType : uint8_t
+{
+  kRecordScan = 1,      // u16 count, u8 chunk count, u8 chunk mask (bit set = received),
+                        // then count x {i16 x_mm, i16 y_mm, u8 intensity}
+  kRecordMotion = 2,    // char mode, char dir, u8 flags (1 = dodging, 2 = wall on left)
+  kRecordPose = 3,      // i32 x_mm, i32 y_mm, i16 theta_mrad, u16 sigma x/y mm, u16 sigma theta mrad
+  kRecordAttitude = 4,  // i16 quat_q14[4] (w x y z), i16 yaw_cdeg, i16 yaw_rate_cdps
+  kRecordLink = 5,      // u8 n, u32 p50/p90/p99/max us, u16 loss permille,
+                        // u32 pings, u32 lost, i8 rssi, i8 bot_rssi
+  kRecordScanStats = 6, // u32 complete, partial, dropped, late, overwritten,
+                        // usb_scans_dropped, usb_other_dropped (totals)
+};
+
+enum CommandType : uint8_t
+{
+  kCommandDrive = 1,  // i16 left, i16 right (PWM, -255..255), u16 ttl_ms
+};
+
+struct Record
+{
+  uint8_t type = 0;
+  uint8_t bot = 0;
+  uint16_t frame_id = 0;
+  std::vector<uint8_t> payload;
+};
+
+struct ScanPoint
+{
+  int16_t x_mm;
+  int16_t y_mm;
+  uint8_t intensity;
+};
+
+// A scan with chunks missing is still sent once it times out; only the
+// received parts of the sweep are present.
+struct Scan
+{
+  uint8_t chunk_count = 0;
+  uint8_t chunk_mask = 0;
+  std::vector<ScanPoint> points;
+
+  bool complete() const { return chunk_mask == (1U << chunk_count) - 1; }
+};
+
+struct Motion
+{
+  char mode;
+  char direction;
+  bool dodging;
+  bool wall_follow_left;
+};
+
+struct Pose
+{
+  int32_t x_mm;
+  int32_t y_mm;
+  int16_t theta_mrad;
+  uint16_t sigma_x_mm;
+  uint16_t sigma_y_mm;
+  uint16_t sigma_theta_mrad;
+};
+
+struct Attitude
+{
+  int16_t quat_q14[4];
+  int16_t yaw_cdeg;
+  int16_t yaw_rate_cdps;
+};
+
+struct Link
+{
+  uint8_t samples;
+  uint32_t p50_us;
+  uint32_t p90_us;
+  uint32_t p99_us;
+  uint32_t max_us;
+  uint16_t loss_permille;
+  uint32_t pings;
+  uint32_t lost;
+  int8_t rssi;
+  int8_t bot_rssi;
+};
+
+struct ScanStats
+{
+  uint32_t complete;
+  uint32_t partial;
+  uint32_t dropped;
+  uint32_t late;
+  uint32_t overwritten;
+  uint32_t usb_scans_dropped;  // queued for USB, then superseded or out of room
+  uint32_t usb_other_dropped;
+};
+
+uint16_t crc16_ccitt(const uint8_t *data, size_t len);
+
+// Decodes one COBS frame (without delimiters). Returns false if malformed.
+bool cobs_decode(const uint8_t *src, size_t len, std::vector<uint8_t> &out);
+
+// COBS-encodes src (without delimiters).
+void cobs_encode(const uint8_t *src, size_t len, std::vector<uint8_t> &out);
+
+// Builds a complete frame, delimiters included, ready to write to the port.
+std::vector<uint8_t> encode_record(uint8_t type, uint8_t bot, uint16_t frame_id, const uint8_t *payload,
+                                   size_t len);
+
+// Both wheels at once. The bot stops if no newer command arrives within ttl_ms.
+std::vector<uint8_t> encode_drive(uint8_t bot, uint16_t seq, int16_t left, int16_t right, uint16_t ttl_ms);
+
+// Splits a byte stream into records. Feed it whatever the port returns.
+class FrameDecoder
+{
+ public:
+  using Callback = std::function<void(const Record &)>;
+
+  explicit FrameDecoder(Callback on_record);
+
+  void feed(const uint8_t *data, size_t len);
+
+  uint64_t records() const { return records_; }
+  // Frames that failed COBS or the CRC: text lines, or bytes lost on USB.
+  uint64_t bad_frames() const { return bad_frames_; }
+
+ private:
+  void finish_frame();
+
+  Callback on_record_;
+  std::vector<uint8_t> frame_;
+  std::vector<uint8_t> decoded_;
+  Record record_;
+  bool overflow_ = false;
+  uint64_t records_ = 0;
+  uint64_t bad_frames_ = 0;
+};
+
+// Typed views of a record's payload. Each returns false on a type or length
+// mismatch.
+bool parse_scan(const Record &record, Scan &scan);
+bool parse_motion(const Record &record, Motion &motion);
+bool parse_pose(const Record &record, Pose &pose);
+bool parse_attitude(const Record &record, Attitude &attitude);
+bool parse_link(const Record &record, Link &link);
+bool parse_scan_stats(const Record &record, ScanStats &stats);
+
+} // namespace usb_frames
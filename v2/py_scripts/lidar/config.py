@@ -9,6 +9,8 @@ SERIAL_TIMEOUT_S = 1.0
 SCAN_TIMEOUT_S = 2.0
 
 IMU_TIMEOUT_S = 1.0
+POSE_TIMEOUT_S = 1.0
+LINK_TIMEOUT_S = 3.0
 MADGWICK_BETA = 0.08
 DEFAULT_IMU_DT_S = 0.01
 
@@ -1,4 +1,8 @@
-"""Madgwick filter for optional MPU6050 IMU orientation fusion."""
+"""Madgwick filter for raw MPU6050 JSON streams.
+
+The v2 bot fuses on-board (bot_fusion.h) and sends `"t":"attitude"` packets,
+which bypass this filter; it is kept for raw `"t":"imu"` sources.
+"""
 
 from __future__ import annotations
 
@@ -34,12 +34,24 @@ class ScanSnapshot:
     motion_dir: str
     dodging: bool
     wall_side: str
+    pose_connected: bool
+    pose_x_m: float
+    pose_y_m: float
+    pose_theta_rad: float
+    link_connected: bool
+    link_rtt_p50_ms: float
+    link_rtt_p99_ms: float
+    link_loss: float
+    link_rssi_dbm: int
+    scan_partial_frac: float
+    scan_dropped_frac: float
 
 
 class SerialReader:
-    def __init__(self, port: str, baud: int = config.BAUD_RATE) -> None:
+    def __init__(self, port: str, baud: int = config.BAUD_RATE, bot: int = 0) -> None:
         self.port = port
         self.baud = baud
+        self.bot = bot  # other bots in the controller's fleet are ignored
         self.serial: serial.Serial | None = None
         self.running = False
         self._thread: threading.Thread | None = None
@@ -60,6 +72,12 @@ class SerialReader:
         self._last_scan_wall = 0.0
         self._last_imu_wall = 0.0
         self._last_imu_ts_us: int | None = None
+        self._pose = (0.0, 0.0, 0.0)
+        self._last_pose_wall = 0.0
+        self._link = (0.0, 0.0, 0.0, 0)
+        self._last_link_wall = 0.0
+        self._scan_totals: tuple[int, int, int, int] | None = None
+        self._scan_loss = (0.0, 0.0)
 
         self._scan_frame_count = 0
         self._scan_fps = 0.0
@@ -98,6 +116,8 @@ class SerialReader:
             now = time.time()
             connected = (now - self._last_scan_wall) < config.SCAN_TIMEOUT_S
             imu_connected = (now - self._last_imu_wall) < config.IMU_TIMEOUT_S
+            pose_connected = (now - self._last_pose_wall) < config.POSE_TIMEOUT_S
+            link_connected = (now - self._last_link_wall) < config.LINK_TIMEOUT_S
             quaternion = self._quaternion.copy() if imu_connected else np.array(
                 [1.0, 0.0, 0.0, 0.0], dtype=np.float32
             )
@@ -117,6 +137,17 @@ class SerialReader:
                 motion_dir=self._motion_dir,
                 dodging=self._dodging,
                 wall_side=self._wall_side,
+                pose_connected=pose_connected,
+                pose_x_m=self._pose[0],
+                pose_y_m=self._pose[1],
+                pose_theta_rad=self._pose[2],
+                link_connected=link_connected,
+                link_rtt_p50_ms=self._link[0],
+                link_rtt_p99_ms=self._link[1],
+                link_loss=self._link[2],
+                link_rssi_dbm=self._link[3],
+                scan_partial_frac=self._scan_loss[0],
+                scan_dropped_frac=self._scan_loss[1],
             )
 
     def _reset_runtime_state(self) -> None:
@@ -131,6 +162,10 @@ class SerialReader:
             self._motion_dir = "x"
             self._dodging = False
             self._wall_side = "left"
+            self._last_pose_wall = 0.0
+            self._last_link_wall = 0.0
+            self._scan_totals = None
+            self._scan_loss = (0.0, 0.0)
 
     def _reconnect(self) -> bool:
         self._reset_runtime_state()
@@ -217,6 +252,25 @@ class SerialReader:
 
         self._update_fps("imu")
 
+    def _handle_attitude(self, data: dict) -> None:
+        # Fused on the bot (Mahony, fixed point); no host-side filtering needed.
+        q_raw = data.get("q")
+        if not (isinstance(q_raw, list) and len(q_raw) == 4):
+            return
+        try:
+            quat = np.asarray(q_raw, dtype=np.float32)
+        except (TypeError, ValueError):
+            return
+        norm = float(np.linalg.norm(quat))
+        if norm <= 1.0e-6:
+            return
+
+        with self._lock:
+            self._quaternion = quat / norm
+            self._last_imu_wall = time.time()
+
+        self._update_fps("imu")
+
     def _handle_status(self, data: dict) -> None:
         stage = str(data.get("stage", ""))
         detail = str(data.get("detail", ""))
@@ -233,16 +287,77 @@ class SerialReader:
             self._dodging = bool(data.get("dodging", False))
             self._wall_side = wall_side if wall_side in {"left", "right"} else "left"
 
+    def _handle_pose(self, data: dict) -> None:
+        try:
+            pose = (float(data["x"]), float(data["y"]), float(data["th"]))
+        except (KeyError, TypeError, ValueError):
+            return
+        with self._lock:
+            self._pose = pose
+            self._last_pose_wall = time.time()
+
+    def _handle_link(self, data: dict) -> None:
+        # Emitted once a second by the controller from its ping/pong probe.
+        try:
+            link = (
+                float(data["p50_us"]) / 1000.0,
+                float(data["p99_us"]) / 1000.0,
+                float(data["loss"]),
+                int(data["rssi"]),
+            )
+        except (KeyError, TypeError, ValueError):
+            return
+        with self._lock:
+            self._link = link
+            self._last_link_wall = time.time()
+
+    def _handle_scan_stats(self, data: dict) -> None:
+        # Running totals from the controller, once a second. Partial scans are
+        # drawn as they are; dropped ones never reach the viewer, whether lost
+        # on the radio or discarded because this reader fell behind on USB.
+        try:
+            totals = (
+                int(data["complete"]),
+                int(data["partial"]),
+                int(data["dropped"]),
+                int(data.get("usb_scans_dropped", 0)),
+            )
+        except (KeyError, TypeError, ValueError):
+            return
+        with self._lock:
+            previous = self._scan_totals
+            self._scan_totals = totals
+            if previous is None:
+                return
+            complete, partial, dropped, usb_dropped = (
+                max(0, now - before) for now, before in zip(totals, previous)
+            )
+            # Scans dropped on USB were first counted as complete or partial.
+            frames = complete + partial + dropped
+            self._scan_loss = (
+                (partial / frames, min(1.0, (dropped + usb_dropped) / frames)) if frames > 0 else (0.0, 0.0)
+            )
+
     def _handle_packet(self, data: dict) -> None:
+        if data.get("bot", self.bot) != self.bot:
+            return
         t = data.get("t")
         if t == "scan":
             self._handle_scan(data)
+        elif t == "attitude":
+            self._handle_attitude(data)
         elif t == "imu":
             self._handle_imu(data)
         elif t == "status":
             self._handle_status(data)
         elif t == "motion":
             self._handle_motion(data)
+        elif t == "pose":
+            self._handle_pose(data)
+        elif t == "link":
+            self._handle_link(data)
+        elif t == "scans":
+            self._handle_scan_stats(data)
 
     def _read_loop(self) -> None:
         while self.running:
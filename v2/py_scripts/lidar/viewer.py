@@ -60,8 +60,8 @@ def _rotate_scan_to_robot_axes(x: np.ndarray, y: np.ndarray) -> tuple[np.ndarray
 
 
 class LidarViewer:
-    def __init__(self, port: str, baud: int = config.BAUD_RATE) -> None:
-        self.serial_reader = SerialReader(port, baud)
+    def __init__(self, port: str, baud: int = config.BAUD_RATE, bot: int = 0) -> None:
+        self.serial_reader = SerialReader(port, baud, bot)
         self.scene = None
         self._avoidance = AvoidanceTracker()
         self._robot_x = 0.0
@@ -76,6 +76,7 @@ class LidarViewer:
             self.motion_text = server.gui.add_text("Motion", initial_value="stopped")
             self.avoidance_text = server.gui.add_text("Avoidance", initial_value="Clear")
             self.scan_fps_text = server.gui.add_text("Scan FPS",  initial_value="0.0")
+            self.link_text     = server.gui.add_text("Link",      initial_value="--")
             self.imu_text      = server.gui.add_text("IMU",       initial_value="Not detected")
             self.imu_fps_text  = server.gui.add_text("IMU FPS",   initial_value="0.0")
             self.points_text   = server.gui.add_text("Points",    initial_value="0")
@@ -116,6 +117,15 @@ class LidarViewer:
                 self._map.clear()
                 server.scene.remove_by_name("/map/points")
 
+    def _update_pose(self, snapshot: ScanSnapshot) -> None:
+        if not snapshot.pose_connected:
+            return
+        # Bot odometry is +x forward / +y left; map it into the same viewer
+        # axes the scan points are rotated into.
+        self._robot_x = snapshot.pose_y_m
+        self._robot_y = -snapshot.pose_x_m
+        self._robot_theta = snapshot.pose_theta_rad
+
     def _maybe_accumulate(self, snapshot: ScanSnapshot) -> None:
         if not self.accumulate_checkbox.value or snapshot.scan_count == self._last_scan_count:
             return
@@ -161,11 +171,21 @@ class LidarViewer:
 
         self.status_text.value   = "Connected" if snapshot.connected else "Disconnected"
         self.motion_text.value = motion_desc
-        self.scan_fps_text.value = f"{snapshot.scan_fps:.1f}"
+        self.scan_fps_text.value = f"{snapshot.scan_fps:.1f}" + (
+            f" ({snapshot.scan_partial_frac * 100:.0f}% partial, "
+            f"{snapshot.scan_dropped_frac * 100:.0f}% dropped)"
+            if snapshot.scan_partial_frac > 0 or snapshot.scan_dropped_frac > 0 else ""
+        )
+        self.link_text.value     = (
+            f"{snapshot.link_rtt_p50_ms:.1f}/{snapshot.link_rtt_p99_ms:.1f} ms, "
+            f"{snapshot.link_loss * 100:.0f}% loss, {snapshot.link_rssi_dbm} dBm"
+            if snapshot.link_connected else "--"
+        )
         self.imu_text.value      = "Connected" if snapshot.imu_connected else "Not detected"
         self.imu_fps_text.value  = f"{snapshot.imu_fps:.1f}"
         self.points_text.value   = str(snapshot.x_m.size)
 
+        self._update_pose(snapshot)
         self.scene.robot.position = (self._robot_x, self._robot_y, 0.0)
         if self.apply_imu_checkbox.value and snapshot.imu_connected:
             self.scene.robot.wxyz = tuple(snapshot.quaternion)
@@ -275,6 +295,7 @@ def main() -> None:
     parser.add_argument("--baud",  "-b", type=int, default=config.BAUD_RATE)
     parser.add_argument("--host",        default="0.0.0.0")
     parser.add_argument("--web-port",    type=int, default=8080)
+    parser.add_argument("--bot",         type=int, default=0, help="Bot id in the controller's fleet table")
     parser.add_argument("--debug",       action="store_true")
     args = parser.parse_args()
 
@@ -283,4 +304,4 @@ def main() -> None:
         format="%(asctime)s %(levelname)s %(name)s: %(message)s",
     )
 
-    LidarViewer(port=args.port, baud=args.baud).run(host=args.host, port=args.web_port)
+    LidarViewer(port=args.port, baud=args.baud, bot=args.bot).run(host=args.host, port=args.web_port)
@@ -6,6 +6,7 @@ import argparse
 import json
 import os
 import queue
+import struct
 import sys
 import threading
 import time
@@ -30,6 +31,8 @@ SPIN_STEP_PWM = 36
 RAMP_STEP_PWM = 10
 MAX_PWM = 220
 SEND_INTERVAL_S = 0.08
+DRIVE_TTL_MS = 300
+USB_COMMAND_DRIVE = 1
 PANEL_REFRESH_S = 0.1
 LOOP_SLEEP_S = 0.02
 PANEL_HEARTBEAT_S = 1.0
@@ -87,9 +90,12 @@ class ScanSnapshot:
 class ControllerBridge:
     """Reads scan JSON from the controller and sends drive commands back."""
 
-    def __init__(self, port: str, baud: int = 460800) -> None:
+    def __init__(self, port: str, baud: int = 460800, binary_drive: bool = True, bot: int = 0) -> None:
         self.port = port
         self.baud = baud
+        self.binary_drive = binary_drive
+        self.bot = bot
+        self._drive_seq = 0
         self.serial: serial.Serial | None = None
         self.running = False
         self._reader_thread: threading.Thread | None = None
@@ -109,6 +115,8 @@ class ControllerBridge:
         self.serial = serial.Serial(self.port, self.baud, timeout=0.1)
         time.sleep(2.0)
         self.serial.reset_input_buffer()
+        # Text keys go to the controller's selected bot; drive frames carry the id.
+        self.send_line(f"@{self.bot}")
 
     def start(self) -> None:
         if self.serial is None:
@@ -207,12 +215,23 @@ class ControllerBridge:
         now = time.time()
         if not force and (now - self.drive.last_send_wall) < SEND_INTERVAL_S:
             return
-        self.send_line(_format_motor_cmd("L", self.drive.current_left)  + "\n")
-        self.send_line(_format_motor_cmd("R", self.drive.current_right) + "\n")
+        if self.binary_drive:
+            self._send_drive_frame(self.drive.current_left, self.drive.current_right)
+        else:
+            self.send_line(_format_motor_cmd("L", self.drive.current_left)  + "\n")
+            self.send_line(_format_motor_cmd("R", self.drive.current_right) + "\n")
         self.drive.last_sent_left  = self.drive.current_left
         self.drive.last_sent_right = self.drive.current_right
         self.drive.last_send_wall  = now
 
+    def _send_drive_frame(self, left: int, right: int) -> None:
+        if self.serial is None:
+            raise RuntimeError("Not connected")
+        self._drive_seq = (self._drive_seq + 1) & 0xFFFF
+        payload = struct.pack("<hhH", left, right, DRIVE_TTL_MS)
+        self.serial.write(_encode_usb_command(USB_COMMAND_DRIVE, self.bot, self._drive_seq, payload))
+        self.serial.flush()
+
     def _is_fully_stopped(self) -> bool:
         d = self.drive
         return d.target_left == 0 and d.target_right == 0 and d.current_left == 0 and d.current_right == 0
@@ -302,7 +321,7 @@ class ControllerBridge:
                     packet = json.loads(line)
                 except json.JSONDecodeError:
                     continue
-                if not isinstance(packet, dict):
+                if not isinstance(packet, dict) or packet.get("bot", self.bot) != self.bot:
                     continue
                 t = packet.get("t")
                 if t == "scan":   self._handle_scan(packet)
@@ -558,6 +577,41 @@ def _format_motor_cmd(motor: str, value: int) -> str:
     return f"{motor}s"
 
 
+def _crc16_ccitt(data: bytes) -> int:
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) & 0xFFFF if crc & 0x8000 else (crc << 1) & 0xFFFF
+    return crc
+
+
+def _cobs_encode(data: bytes) -> bytes:
+    out = bytearray([0])
+    code_pos, code = 0, 1
+    for byte in data:
+        if byte == 0:
+            out[code_pos] = code
+            code_pos, code = len(out), 1
+            out.append(0)
+            continue
+        out.append(byte)
+        code += 1
+        if code == 0xFF:
+            out[code_pos] = code
+            code_pos, code = len(out), 1
+            out.append(0)
+    out[code_pos] = code
+    return bytes(out)
+
+
+def _encode_usb_command(kind: int, bot: int, seq: int, payload: bytes) -> bytes:
+    """Frames a binary command the way the controller frames its records."""
+    body = struct.pack("<BBH", kind, bot, seq) + payload
+    body += struct.pack("<H", _crc16_ccitt(body))
+    return b"\x00" + _cobs_encode(body) + b"\x00"
+
+
 # ── main loop ─────────────────────────────────────────────────────────────────
 
 def _run_loop(bridge: ControllerBridge, viewer: WebViewer) -> None:
@@ -633,9 +687,11 @@ def main() -> None:
     parser.add_argument("--baud",     "-b", type=int, default=460800)
     parser.add_argument("--host",           default="0.0.0.0",    help="Web viewer bind host")
     parser.add_argument("--web-port",       type=int, default=8080)
+    parser.add_argument("--text-drive",     action="store_true",  help="Send Lf/Rb text lines (bots without drive packets)")
+    parser.add_argument("--bot",            type=int, default=0,  help="Bot id in the controller's fleet table")
     args = parser.parse_args()
 
-    bridge = ControllerBridge(port=args.port, baud=args.baud)
+    bridge = ControllerBridge(port=args.port, baud=args.baud, binary_drive=not args.text_drive, bot=args.bot)
     viewer = WebViewer(host=args.host, port=args.web_port)
 
     try: